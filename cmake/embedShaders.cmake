@@ -0,0 +1,42 @@
+# Script mode, run at build time once the shaders are compiled:
+#   cmake -DOUTPUT=<file.cpp> -DFILES=<file;file> -P embedShaders.cmake
+# Writes a translation unit holding every file in FILES as a constexpr byte
+# array, registered with gl::EmbeddedShaders under its file name.
+
+set(DEFINITIONS "")
+set(ENTRIES "")
+set(INDEX 0)
+
+foreach(file ${FILES})
+  get_filename_component(NAME ${file} NAME)
+  file(READ ${file} HEX HEX)
+  string(LENGTH "${HEX}" HEX_LENGTH)
+  math(EXPR SIZE "${HEX_LENGTH} / 2")
+  # 16 bytes per line, keeps the generated file readable in a diff
+  string(REGEX REPLACE "(................................)" "\\1\n      " HEX "${HEX}")
+  string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+
+  # Null terminated, so the sources can be handed to glShaderSource as is
+  string(APPEND DEFINITIONS "  constexpr unsigned char SHADER_${INDEX}[] = {\n      ${BYTES}0x00};\n\n")
+  string(APPEND ENTRIES "      {\"${NAME}\", SHADER_${INDEX}, ${SIZE}},\n")
+  math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+
+set(CONTENT "// Generated by cmake/embedShaders.cmake, do not edit
+#include <gl/embeddedShaders.hpp>
+
+namespace {
+${DEFINITIONS}  constexpr gl::EmbeddedShader SHADERS[] = {
+${ENTRIES}  };
+
+  [[maybe_unused]] const bool registered = gl::EmbeddedShaders::add(SHADERS);
+} // namespace
+")
+
+# Only touch the file when it changed, so unchanged shaders don't relink
+if(EXISTS ${OUTPUT})
+  file(READ ${OUTPUT} OLD_CONTENT)
+endif()
+if(NOT "${OLD_CONTENT}" STREQUAL "${CONTENT}")
+  file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
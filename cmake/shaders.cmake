@@ -9,7 +9,7 @@ endif()
 
 function(_compile_slang_file)
   set(SINGLEVALUE SOURCE OUT TARGET)
-  set(MULTIVALUES ENTRIES)
+  set(MULTIVALUES ENTRIES DEFINES)
   cmake_parse_arguments(PARSE_ARGV 0 arg "" "${SINGLEVALUE}" "${MULTIVALUES}")
   message(STATUS "Compiling shader source file: ${arg_SOURCE} to ${arg_OUT} for entries \"${arg_ENTRIES}\"")
 
@@ -24,10 +24,15 @@ function(_compile_slang_file)
   foreach(entry ${arg_ENTRIES})
     set(ENTRIES ${ENTRIES} -entry ${entry})
   endforeach()
+
+  set(DEFINES)
+  foreach(define ${arg_DEFINES})
+    set(DEFINES ${DEFINES} -D${define})
+  endforeach()
   add_custom_command(
     OUTPUT ${OUT_FILE}
     DEPENDS ${source}.slang ${INCLUDED_FILES}
-    COMMAND ${SLANGC_EXECUTABLE} ${arg_SOURCE} ${COMMAND_TARGET} -fvk-use-entrypoint-name ${ENTRIES} -o ${arg_OUT}
+    COMMAND ${SLANGC_EXECUTABLE} ${arg_SOURCE} ${COMMAND_TARGET} -fvk-use-entrypoint-name ${ENTRIES} ${DEFINES} -o ${arg_OUT}
     COMMENT "Compiling shader ${source} to ${arg_TARGET} (${arg_OUT})"
     VERBATIM
   )
@@ -35,7 +40,7 @@ endfunction()
 
 
 function(compile_shader target shader_target link_target)
-  set(MULTIVALUE SOURCES INCLUDES)
+  set(MULTIVALUE SOURCES COMPUTE_SOURCES SPECIALIZED_SOURCES VARIANT_SOURCES VARIANT_RAY_COUNTS VARIANT_MAX_STEPS INCLUDES)
   cmake_parse_arguments(PARSE_ARGV 0 arg "" "" "${MULTIVALUE}")
 
   set(VALID_OUTPUT_TARGETS GLSL SPIRV)
@@ -73,6 +78,44 @@ function(compile_shader target shader_target link_target)
     endif()
   endforeach()
 
+  # Compute shaders have a single comp entry point
+  foreach(source ${arg_COMPUTE_SOURCES})
+    set(SOURCE_FILE ${CMAKE_CURRENT_SOURCE_DIR}/${source}.slang)
+    message(STATUS "Processing compute shader source: ${SOURCE_FILE}")
+
+    if(${shader_target} STREQUAL SPIRV)
+      set(OUT_FILE ${CMAKE_BINARY_DIR}/shaders/${source}.spv)
+    else()
+      set(OUT_FILE ${CMAKE_BINARY_DIR}/shaders/${source}_comp.glsl)
+    endif()
+    _compile_slang_file(SOURCE ${SOURCE_FILE} TARGET ${shader_target} ENTRIES comp OUT ${OUT_FILE})
+    set(OUTPUTS ${OUTPUTS} ${OUT_FILE})
+  endforeach()
+
+  # Also built as SPIR-V with SPECIALIZED defined, for loading through
+  # gl::SpecializedPrograms with the constants set by glSpecializeShader
+  foreach(source ${arg_SPECIALIZED_SOURCES})
+    set(SOURCE_FILE ${CMAKE_CURRENT_SOURCE_DIR}/${source}.slang)
+    set(OUT_FILE ${CMAKE_BINARY_DIR}/shaders/${source}_specialized.spv)
+    _compile_slang_file(SOURCE ${SOURCE_FILE} TARGET SPIRV ENTRIES vert frag DEFINES SPECIALIZED OUT ${OUT_FILE})
+    set(OUTPUTS ${OUTPUTS} ${OUT_FILE})
+  endforeach()
+
+  # Also built once per ray count and step budget with the two defined, so
+  # the compiler can unroll the loops. Named <source>_r<rays>_s<steps>
+  foreach(source ${arg_VARIANT_SOURCES})
+    set(SOURCE_FILE ${CMAKE_CURRENT_SOURCE_DIR}/${source}.slang)
+    foreach(rays ${arg_VARIANT_RAY_COUNTS})
+      foreach(steps ${arg_VARIANT_MAX_STEPS})
+        foreach(stage vert frag)
+          set(OUT_FILE ${CMAKE_BINARY_DIR}/shaders/${source}_r${rays}_s${steps}_${stage}.glsl)
+          _compile_slang_file(SOURCE ${SOURCE_FILE} TARGET ${shader_target} ENTRIES "${stage}" DEFINES VARIANT_RAY_COUNT=${rays} VARIANT_MAX_STEPS=${steps} OUT ${OUT_FILE})
+          set(OUTPUTS ${OUTPUTS} ${OUT_FILE})
+        endforeach()
+      endforeach()
+    endforeach()
+  endforeach()
+
   message(STATUS "Shader compilation outputs: ${OUTPUTS}")
 
   add_custom_target(${target} ALL
@@ -81,9 +124,36 @@ function(compile_shader target shader_target link_target)
   )
 
   add_dependencies(${link_target} ${target})
+
+  # The outputs are compiled into an object library, its static initializer
+  # registers them with gl::EmbeddedShaders
+  if(EMBED_SHADERS)
+    set(EMBED_FILE ${CMAKE_CURRENT_BINARY_DIR}/${target}_embedded.cpp)
+    add_custom_command(
+      OUTPUT ${EMBED_FILE}
+      DEPENDS ${OUTPUTS} ${CMAKE_SOURCE_DIR}/cmake/embedShaders.cmake
+      COMMAND ${CMAKE_COMMAND} -DOUTPUT=${EMBED_FILE} "-DFILES=${OUTPUTS}" -P ${CMAKE_SOURCE_DIR}/cmake/embedShaders.cmake
+      COMMENT "Embedding shaders for target ${target}"
+      VERBATIM
+    )
+    add_library(${target}_embedded OBJECT ${EMBED_FILE})
+    target_link_libraries(${target}_embedded PRIVATE gl::gl)
+    target_link_libraries(${link_target} PRIVATE ${target}_embedded)
+  endif()
+endfunction()
+
+# Links the shaders embedded by compile_shader(), for other executables
+function(link_embedded_shaders target link_target)
+  if(EMBED_SHADERS)
+    target_link_libraries(${link_target} PRIVATE ${target}_embedded)
+  endif()
 endfunction()
 
 function(copy_shaders target)
+  # Embedded shaders are never read from disk
+  if(EMBED_SHADERS)
+    return()
+  endif()
   add_custom_command(
     TARGET ${target}
     POST_BUILD
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <span>
+#include <string_view>
+
+namespace cpu {
+  /// <summary>
+  /// Difference between two RGBA images, over the rgb channels only.
+  /// </summary>
+  struct ImageDiff {
+    double rmse = 0.0;
+    double maxAbs = 0.0;
+    // Peak signal to noise ratio in dB for a peak of 1, infinite if equal
+    double psnr = 0.0;
+
+    static ImageDiff compute(std::span<const glm::vec4> a,
+                             std::span<const glm::vec4> b);
+  };
+
+  /// <summary>
+  /// Writes a little-endian RGB PFM. PFM rows go bottom to top, the same as
+  /// the GL textures, so GPU readbacks can be written as they are.
+  /// </summary>
+  bool writePfm(std::string_view path, int width, int height,
+                std::span<const glm::vec4> pixels);
+} // namespace cpu
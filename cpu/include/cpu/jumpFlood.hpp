@@ -0,0 +1,78 @@
+#pragma once
+
+#include "threadPool.hpp"
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+namespace cpu {
+  /// <summary>
+  /// CPU version of the jump flood and distance passes, following the
+  /// <c>toUv</c>, <c>jumpflood</c> and <c>distance</c> shaders texel for texel.
+  /// Seeds are kept as separate x and y planes so the per row loops vectorize,
+  /// and rows are split between the threads of a <c>ThreadPool</c>.
+  ///
+  /// Every image is stored with rows bottom to top like the GL textures, so
+  /// the scene can come straight from <c>glGetTextureImage</c> and the
+  /// distance field can be uploaded in place of the GPU result.
+  /// </summary>
+  class JumpFlood {
+    ThreadPool& m_pool;
+
+    int m_width = 0;
+    int m_height = 0;
+
+    // Ping-pong seed planes, in uv. (0, 0) is empty and (-2, -2) marks a
+    // texel that found no seed, exactly like the shaders
+    std::array<std::vector<float>, 2> m_seedX{};
+    std::array<std::vector<float>, 2> m_seedY{};
+    size_t m_current = 0;
+
+    // Texel centres in uv, shared by every row / column
+    std::vector<float> m_uvX{};
+    std::vector<float> m_uvY{};
+
+    void resize(int width, int height);
+    void floodPass(int offset);
+
+  public:
+    explicit JumpFlood(ThreadPool& pool) : m_pool(pool) {}
+
+    int width() const { return m_width; }
+    int height() const { return m_height; }
+
+    /// Same pass count <c>Jfa</c> uses by default
+    static uint32_t maxPasses(int width, int height);
+
+    /// <summary>
+    /// Seeds every texel with its uv scaled by the scene alpha.
+    /// </summary>
+    /// <param name="rgba">RGBA32F scene, 4 floats per texel</param>
+    void seed(std::span<const float> rgba, int width, int height);
+
+    /// <summary>
+    /// Runs <paramref name="passes"/> jump flood passes, halving the offset
+    /// each time and ending at 1 texel, like <c>Jfa::draw</c>.
+    /// </summary>
+    void flood(uint32_t passes);
+
+    /// <summary>
+    /// Writes the clamped uv distance to the nearest seed, one float per
+    /// texel, in the layout of <c>Jfa::distanceResult()</c>.
+    /// </summary>
+    void distance(std::span<float> out);
+
+    /// <summary>
+    /// Writes the nearest seeds interleaved as RG pairs, in the layout of
+    /// <c>Jfa::result()</c>.
+    /// </summary>
+    void seeds(std::span<float> out) const;
+
+    /// <summary>
+    /// Seed, flood and distance in one call.
+    /// </summary>
+    std::vector<float> run(std::span<const float> rgba, int width, int height,
+                           uint32_t passes);
+  };
+} // namespace cpu
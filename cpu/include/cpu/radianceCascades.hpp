@@ -0,0 +1,67 @@
+#pragma once
+
+#include "threadPool.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace cpu {
+  // Constant between iterations
+  struct FlatlandRcConstants {
+    glm::vec2 resolution;
+    uint32_t baseRayCount;
+    uint32_t maxSteps;
+    uint32_t maxCascades;
+  };
+
+  // Per iteration
+  struct FlatlandRcParams {
+    uint32_t currentCascade;
+  };
+
+  /// <summary>
+  /// Reference implementation of <c>flatland_rc.slang</c>: same cascade
+  /// layout, intervals and merge, evaluated per texel on the CPU. Textures
+  /// are sampled bilinearly with repeat wrapping like the GL defaults, so
+  /// results match the GPU up to filtering precision.
+  ///
+  /// Images are RGBA, rows bottom to top like the GL textures. Tiles of
+  /// texels are split between the threads of a <c>ThreadPool</c>.
+  /// </summary>
+  class RadianceCascades {
+    ThreadPool& m_pool;
+
+    // Cascade being written and the one above it, which it merges from
+    std::vector<glm::vec4> m_current{};
+    std::vector<glm::vec4> m_upper{};
+
+  public:
+    explicit RadianceCascades(ThreadPool& pool) : m_pool(pool) {}
+
+    /// <summary>
+    /// Renders one cascade into <paramref name="out"/>.
+    /// </summary>
+    /// <param name="scene">Scene colour, alpha > 0 on emitters and
+    /// occluders</param>
+    /// <param name="distance">Distance field, one float per texel</param>
+    /// <param name="upper">Cascade <c>currentCascade + 1</c>, unused for the
+    /// top cascade</param>
+    void renderCascade(std::span<const glm::vec4> scene,
+                       std::span<const float> distance,
+                       std::span<const glm::vec4> upper,
+                       const FlatlandRcConstants& constants,
+                       const FlatlandRcParams& params,
+                       std::span<glm::vec4> out);
+
+    /// <summary>
+    /// Renders every cascade from the top down, like <c>FlatlandRc::draw</c>,
+    /// and returns cascade <paramref name="stopCascade"/>. Cascade 0 has the
+    /// sRGB curve applied.
+    /// </summary>
+    std::vector<glm::vec4> render(std::span<const glm::vec4> scene,
+                                  std::span<const float> distance,
+                                  const FlatlandRcConstants& constants,
+                                  uint32_t stopCascade = 0);
+  };
+} // namespace cpu
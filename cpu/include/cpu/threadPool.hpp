@@ -0,0 +1,78 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cpu {
+  /// <summary>
+  /// Fixed set of worker threads that split index ranges between them. The
+  /// calling thread works on the range too, so a pool of N threads uses N + 1
+  /// cores while a dispatch is running.
+  /// </summary>
+  class ThreadPool {
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+
+    /// <summary>
+    /// A dispatch, living on the dispatcher's stack. Each has its own
+    /// counter, so a worker waking late can't take indices of the next one.
+    /// </summary>
+    struct Job {
+      const std::function<void(size_t)>& run;
+      size_t size;
+      std::atomic<size_t> next{0};
+    };
+
+    // Null once the dispatch is done
+    Job* m_job = nullptr;
+    size_t m_busy = 0;
+    uint64_t m_generation = 0;
+    bool m_stop = false;
+
+    void workerLoop();
+    static void drain(Job& job);
+
+  public:
+    /// <param name="threads">Worker threads besides the caller. Defaults to
+    /// one less than the hardware concurrency</param>
+    explicit ThreadPool(size_t threads = defaultThreads());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    static size_t defaultThreads() {
+      return std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1;
+    }
+
+    /// Threads taking part in a dispatch, including the caller
+    size_t concurrency() const { return m_workers.size() + 1; }
+
+    /// <summary>
+    /// Calls job(i) for every i in [0, tasks) and returns once all are done.
+    /// </summary>
+    void dispatch(size_t tasks, const std::function<void(size_t)>& job);
+
+    /// <summary>
+    /// Splits [0, count) into chunks of <paramref name="grain"/> and calls
+    /// f(begin, end) for each of them in parallel.
+    /// </summary>
+    template <typename F> void parallelFor(size_t count, size_t grain, F&& f) {
+      grain = std::max<size_t>(grain, 1);
+      size_t chunks = (count + grain - 1) / grain;
+      dispatch(chunks, [&](size_t chunk) {
+        size_t begin = chunk * grain;
+        f(begin, std::min(begin + grain, count));
+      });
+    }
+  };
+} // namespace cpu
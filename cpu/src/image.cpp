@@ -0,0 +1,56 @@
+#include "cpu/image.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace cpu {
+  ImageDiff ImageDiff::compute(std::span<const glm::vec4> a,
+                               std::span<const glm::vec4> b) {
+    size_t count = std::min(a.size(), b.size());
+    if (count == 0) {
+      return {};
+    }
+
+    ImageDiff diff{};
+    double sumSq = 0.0;
+    for (size_t i = 0; i < count; i++) {
+      for (int c = 0; c < 3; c++) {
+        double error = static_cast<double>(a[i][c]) -
+                       static_cast<double>(b[i][c]);
+        sumSq += error * error;
+        diff.maxAbs = std::max(diff.maxAbs, std::abs(error));
+      }
+    }
+
+    double mse = sumSq / (static_cast<double>(count) * 3.0);
+    diff.rmse = std::sqrt(mse);
+    diff.psnr = mse == 0.0 ? std::numeric_limits<double>::infinity()
+                           : 10.0 * std::log10(1.0 / mse);
+    return diff;
+  }
+
+  bool writePfm(std::string_view path, int width, int height,
+                std::span<const glm::vec4> pixels) {
+    std::ofstream file{std::string(path), std::ios::binary};
+    if (!file.is_open()) {
+      return false;
+    }
+
+    // A negative scale marks little-endian data
+    file << "PF\n" << width << " " << height << "\n-1.0\n";
+
+    std::vector<float> rgb(pixels.size() * 3);
+    for (size_t i = 0; i < pixels.size(); i++) {
+      rgb[i * 3] = pixels[i].r;
+      rgb[i * 3 + 1] = pixels[i].g;
+      rgb[i * 3 + 2] = pixels[i].b;
+    }
+    file.write(reinterpret_cast<const char*>(rgb.data()),
+               static_cast<std::streamsize>(rgb.size() * sizeof(float)));
+    return file.good();
+  }
+} // namespace cpu
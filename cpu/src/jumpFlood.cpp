@@ -0,0 +1,176 @@
+#include "cpu/jumpFlood.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cpu {
+  namespace {
+    // Rows per task, large enough to keep scheduling overhead low
+    constexpr size_t ROW_GRAIN = 16;
+  } // namespace
+
+  uint32_t JumpFlood::maxPasses(int width, int height) {
+    return static_cast<uint32_t>(
+        std::ceil(std::log2(static_cast<double>(std::max(width, height)))));
+  }
+
+  void JumpFlood::resize(int width, int height) {
+    if (width == m_width && height == m_height) {
+      return;
+    }
+    m_width = width;
+    m_height = height;
+
+    size_t texels = static_cast<size_t>(width) * static_cast<size_t>(height);
+    for (size_t i = 0; i < 2; i++) {
+      m_seedX[i].assign(texels, 0.f);
+      m_seedY[i].assign(texels, 0.f);
+    }
+
+    m_uvX.resize(static_cast<size_t>(width));
+    m_uvY.resize(static_cast<size_t>(height));
+    for (int x = 0; x < width; x++) {
+      m_uvX[static_cast<size_t>(x)] =
+          (static_cast<float>(x) + 0.5f) / static_cast<float>(width);
+    }
+    for (int y = 0; y < height; y++) {
+      m_uvY[static_cast<size_t>(y)] =
+          (static_cast<float>(y) + 0.5f) / static_cast<float>(height);
+    }
+  }
+
+  void JumpFlood::seed(std::span<const float> rgba, int width, int height) {
+    resize(width, height);
+    m_current = 0;
+
+    size_t w = static_cast<size_t>(width);
+    float* seedX = m_seedX[0].data();
+    float* seedY = m_seedY[0].data();
+    const float* uvX = m_uvX.data();
+    const float* scene = rgba.data();
+
+    m_pool.parallelFor(
+        static_cast<size_t>(height), ROW_GRAIN, [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; y++) {
+            float uvY = m_uvY[y];
+            float* rowX = seedX + y * w;
+            float* rowY = seedY + y * w;
+            const float* row = scene + y * w * 4;
+            for (size_t x = 0; x < w; x++) {
+              float alpha = row[x * 4 + 3];
+              rowX[x] = uvX[x] * alpha;
+              rowY[x] = uvY * alpha;
+            }
+          }
+        });
+  }
+
+  void JumpFlood::floodPass(int offset) {
+    size_t next = 1 - m_current;
+    const float* inX = m_seedX[m_current].data();
+    const float* inY = m_seedY[m_current].data();
+    float* outX = m_seedX[next].data();
+    float* outY = m_seedY[next].data();
+    const float* uvX = m_uvX.data();
+    int width = m_width;
+    int height = m_height;
+    size_t w = static_cast<size_t>(width);
+
+    m_pool.parallelFor(
+        static_cast<size_t>(height), ROW_GRAIN, [&](size_t begin, size_t end) {
+          std::vector<float> bestDist(w);
+
+          for (size_t row = begin; row < end; row++) {
+            int y = static_cast<int>(row);
+            float uvY = m_uvY[row];
+            float* rowX = outX + row * w;
+            float* rowY = outY + row * w;
+            std::fill_n(rowX, w, -2.f);
+            std::fill_n(rowY, w, -2.f);
+            std::fill(bestDist.begin(), bestDist.end(), 999999.9f);
+            float* best = bestDist.data();
+
+            // Same neighbour order as the shader, so ties resolve the same way
+            for (int dy = -1; dy <= 1; dy++) {
+              int sy = y + dy * offset;
+              if (sy < 0 || sy >= height) {
+                continue;
+              }
+              const float* srcX = inX + static_cast<size_t>(sy) * w;
+              const float* srcY = inY + static_cast<size_t>(sy) * w;
+
+              for (int dx = -1; dx <= 1; dx++) {
+                // Only the range of x whose neighbour lies inside the image
+                int shift = dx * offset;
+                int first = std::max(0, -shift);
+                int last = std::min(width, width - shift);
+                for (int x = first; x < last; x++) {
+                  float candX = srcX[x + shift];
+                  float candY = srcY[x + shift];
+                  float diffX = candX - uvX[x];
+                  float diffY = candY - uvY;
+                  float dist = diffX * diffX + diffY * diffY;
+                  bool closer =
+                      (candX != 0.f || candY != 0.f) && dist < best[x];
+                  best[x] = closer ? dist : best[x];
+                  rowX[x] = closer ? candX : rowX[x];
+                  rowY[x] = closer ? candY : rowY[x];
+                }
+              }
+            }
+          }
+        });
+
+    m_current = next;
+  }
+
+  void JumpFlood::flood(uint32_t passes) {
+    for (uint32_t i = 0; i < passes; i++) {
+      floodPass(1 << (passes - i - 1));
+    }
+  }
+
+  void JumpFlood::distance(std::span<float> out) {
+    size_t w = static_cast<size_t>(m_width);
+    const float* seedX = m_seedX[m_current].data();
+    const float* seedY = m_seedY[m_current].data();
+    const float* uvX = m_uvX.data();
+    float* dist = out.data();
+
+    m_pool.parallelFor(
+        static_cast<size_t>(m_height), ROW_GRAIN,
+        [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; y++) {
+            float uvY = m_uvY[y];
+            for (size_t x = 0; x < w; x++) {
+              size_t i = y * w + x;
+              float diffX = seedX[i] - uvX[x];
+              float diffY = seedY[i] - uvY;
+              float d = std::min(std::sqrt(diffX * diffX + diffY * diffY), 1.f);
+              // Like the shader, an empty seed means none was found
+              bool empty = seedX[i] == 0.f && seedY[i] == 0.f;
+              dist[i] = empty ? 1.f : d;
+            }
+          }
+        });
+  }
+
+  void JumpFlood::seeds(std::span<float> out) const {
+    const auto& seedX = m_seedX[m_current];
+    const auto& seedY = m_seedY[m_current];
+    for (size_t i = 0; i < seedX.size(); i++) {
+      out[i * 2] = seedX[i];
+      out[i * 2 + 1] = seedY[i];
+    }
+  }
+
+  std::vector<float> JumpFlood::run(std::span<const float> rgba, int width,
+                                    int height, uint32_t passes) {
+    seed(rgba, width, height);
+    flood(passes);
+    std::vector<float> result(static_cast<size_t>(width) *
+                              static_cast<size_t>(height));
+    distance(result);
+    return result;
+  }
+} // namespace cpu
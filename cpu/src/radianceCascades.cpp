@@ -0,0 +1,226 @@
+#include "cpu/radianceCascades.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+namespace cpu {
+  namespace {
+    constexpr int TILE_SIZE = 32;
+    constexpr float TAU = 2.f * std::numbers::pi_v<float>;
+    constexpr float SRGB = 2.2f;
+
+    /// Bilinear fetch with repeat wrapping, the default GL sampler state
+    template <typename T>
+    T sample(std::span<const T> texels, int width, int height, glm::vec2 uv) {
+      float x = uv.x * static_cast<float>(width) - 0.5f;
+      float y = uv.y * static_cast<float>(height) - 0.5f;
+      float x0 = std::floor(x);
+      float y0 = std::floor(y);
+      float fx = x - x0;
+      float fy = y - y0;
+
+      auto wrap = [](int i, int size) {
+        int wrapped = i % size;
+        return wrapped < 0 ? wrapped + size : wrapped;
+      };
+      int ix0 = wrap(static_cast<int>(x0), width);
+      int ix1 = wrap(static_cast<int>(x0) + 1, width);
+      int iy0 = wrap(static_cast<int>(y0), height);
+      int iy1 = wrap(static_cast<int>(y0) + 1, height);
+
+      auto at = [&](int ix, int iy) {
+        return texels[static_cast<size_t>(iy) * static_cast<size_t>(width) +
+                      static_cast<size_t>(ix)];
+      };
+      T bottom = at(ix0, iy0) * (1.f - fx) + at(ix1, iy0) * fx;
+      T top = at(ix0, iy1) * (1.f - fx) + at(ix1, iy1) * fx;
+      return bottom * (1.f - fy) + top * fy;
+    }
+
+    bool outOfUv(glm::vec2 uv) {
+      return uv.x < 0.f || uv.x > 1.f || uv.y < 0.f || uv.y > 1.f;
+    }
+
+    /// Values the fragment shader derives from the constants, shared by
+    /// every texel of a cascade
+    struct Cascade {
+      float sqrtBaseRayCount;
+      float shortestSide;
+      glm::vec2 scale;
+      float cascadeIndex;
+      float intervalStart;
+      float intervalLength;
+      float spacing;
+      float angleStepSize;
+      glm::vec2 size;
+      float minStepSize;
+      bool merges;
+      float upperSpacing;
+      glm::vec2 upperSize;
+
+      Cascade(const FlatlandRcConstants& constants,
+              const FlatlandRcParams& params) {
+        const glm::vec2& resolution = constants.resolution;
+        float baseRayCount = static_cast<float>(constants.baseRayCount);
+        sqrtBaseRayCount = std::sqrt(baseRayCount);
+        shortestSide = std::min(resolution.x, resolution.y);
+        scale = glm::vec2(shortestSide) / resolution;
+        cascadeIndex = static_cast<float>(params.currentCascade);
+
+        float modifierHack = sqrtBaseRayCount / 2.f;
+        intervalStart =
+            params.currentCascade == 0
+                ? 0.f
+                : std::pow(baseRayCount, cascadeIndex - 1.f) / shortestSide;
+        intervalLength = std::pow(baseRayCount, cascadeIndex) / shortestSide;
+        intervalStart *= modifierHack;
+        intervalLength *= modifierHack;
+
+        float rayCount = std::pow(baseRayCount, cascadeIndex + 1.f);
+        spacing = std::pow(sqrtBaseRayCount, cascadeIndex);
+        angleStepSize = TAU * (1.f / rayCount);
+        size = glm::floor(resolution / spacing);
+        minStepSize = std::min(1.f / resolution.x, 1.f / resolution.y) * 0.5f;
+
+        merges = params.currentCascade + 1 < constants.maxCascades;
+        upperSpacing = std::pow(sqrtBaseRayCount, cascadeIndex + 1.f);
+        upperSize = glm::floor(resolution / upperSpacing);
+      }
+    };
+  } // namespace
+
+  void RadianceCascades::renderCascade(std::span<const glm::vec4> scene,
+                                       std::span<const float> distance,
+                                       std::span<const glm::vec4> upper,
+                                       const FlatlandRcConstants& constants,
+                                       const FlatlandRcParams& params,
+                                       std::span<glm::vec4> out) {
+    const glm::vec2& resolution = constants.resolution;
+    int width = static_cast<int>(resolution.x);
+    int height = static_cast<int>(resolution.y);
+    Cascade cascade(constants, params);
+
+    auto traceRay = [&](glm::vec2 uv, glm::vec2 rayDirection,
+                        glm::vec4& radDelta) {
+      float traveled = cascade.intervalStart;
+
+      // We tested uv already (we know we aren't an object), so skip step 0.
+      for (uint32_t step = 1; step < constants.maxSteps; step++) {
+        float dist = sample(distance, width, height, uv);
+
+        uv += rayDirection * dist * cascade.scale;
+
+        if (outOfUv(uv)) {
+          break;
+        }
+
+        if (dist <= cascade.minStepSize) {
+          radDelta += sample(scene, width, height, uv);
+          break;
+        }
+
+        traveled += dist;
+        if (traveled >= cascade.intervalLength) {
+          break;
+        }
+      }
+    };
+
+    auto merge = [&](float index, glm::vec2 probeRelativePosition,
+                     glm::vec4& radDelta) {
+      // Only merge on non-opaque areas
+      if (!cascade.merges || radDelta.a != 0.f) {
+        return;
+      }
+      glm::vec2 upperPosition =
+          glm::vec2(std::fmod(index, cascade.upperSpacing),
+                    std::floor(index / cascade.upperSpacing)) *
+          cascade.upperSize;
+
+      glm::vec2 offset =
+          (probeRelativePosition + 0.5f) / cascade.sqrtBaseRayCount;
+      glm::vec2 clamped =
+          glm::clamp(offset, glm::vec2(0.5f), cascade.upperSize - 0.5f);
+      glm::vec2 upperUv = (upperPosition + clamped) / resolution;
+
+      radDelta += sample(upper, width, height, upperUv);
+    };
+
+    auto shade = [&](int x, int y) {
+      glm::vec2 coord{static_cast<float>(x), static_cast<float>(y)};
+
+      glm::vec2 probeRelativePosition =
+          glm::vec2(std::fmod(coord.x, cascade.size.x),
+                    std::fmod(coord.y, cascade.size.y));
+      glm::vec2 rayPos = glm::floor(coord / cascade.size);
+
+      glm::vec2 probeCenter = (probeRelativePosition + 0.5f) * cascade.spacing;
+      glm::vec2 normalizedProbeCenter = probeCenter / resolution;
+
+      float baseIndex = static_cast<float>(constants.baseRayCount) *
+                        (rayPos.x + (cascade.spacing * rayPos.y));
+
+      glm::vec4 radiance(0.f);
+      for (uint32_t i = 0; i < constants.baseRayCount; i++) {
+        float index = baseIndex + static_cast<float>(i);
+        float angle = cascade.angleStepSize * (index + 0.5f);
+        glm::vec2 rayDirection{std::cos(angle), -std::sin(angle)};
+
+        glm::vec2 sampleUv = normalizedProbeCenter + cascade.intervalStart *
+                                                         rayDirection *
+                                                         cascade.scale;
+        glm::vec4 radDelta(0.f);
+
+        traceRay(sampleUv, rayDirection, radDelta);
+        merge(index, probeRelativePosition, radDelta);
+
+        radiance += radDelta;
+      }
+
+      glm::vec3 final =
+          glm::vec3(radiance) / static_cast<float>(constants.baseRayCount);
+      if (params.currentCascade == 0) {
+        final = glm::pow(final, glm::vec3(1.f / SRGB));
+      }
+      return glm::vec4(final, 1.f);
+    };
+
+    int tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+    int tilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+    m_pool.dispatch(
+        static_cast<size_t>(tilesX) * static_cast<size_t>(tilesY),
+        [&](size_t tile) {
+          int tileX = static_cast<int>(tile % static_cast<size_t>(tilesX));
+          int tileY = static_cast<int>(tile / static_cast<size_t>(tilesX));
+          int endX = std::min(width, (tileX + 1) * TILE_SIZE);
+          int endY = std::min(height, (tileY + 1) * TILE_SIZE);
+          for (int y = tileY * TILE_SIZE; y < endY; y++) {
+            for (int x = tileX * TILE_SIZE; x < endX; x++) {
+              out[static_cast<size_t>(y) * static_cast<size_t>(width) +
+                  static_cast<size_t>(x)] = shade(x, y);
+            }
+          }
+        });
+  }
+
+  std::vector<glm::vec4>
+  RadianceCascades::render(std::span<const glm::vec4> scene,
+                           std::span<const float> distance,
+                           const FlatlandRcConstants& constants,
+                           uint32_t stopCascade) {
+    size_t texels = static_cast<size_t>(constants.resolution.x) *
+                    static_cast<size_t>(constants.resolution.y);
+    m_current.assign(texels, glm::vec4(0.f));
+    m_upper.assign(texels, glm::vec4(0.f));
+
+    for (uint32_t i = constants.maxCascades; i-- > stopCascade;) {
+      renderCascade(scene, distance, m_upper, constants,
+                    FlatlandRcParams{.currentCascade = i}, m_current);
+      std::swap(m_current, m_upper);
+    }
+
+    // The last cascade written was swapped into m_upper
+    return m_upper;
+  }
+} // namespace cpu
@@ -0,0 +1,84 @@
+#include "cpu/threadPool.hpp"
+
+namespace cpu {
+  ThreadPool::ThreadPool(size_t threads) {
+    m_workers.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+      m_workers.emplace_back([this] { workerLoop(); });
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& worker : m_workers) {
+      worker.join();
+    }
+  }
+
+  void ThreadPool::drain(Job& job) {
+    for (size_t i = job.next.fetch_add(1); i < job.size;
+         i = job.next.fetch_add(1)) {
+      job.run(i);
+    }
+  }
+
+  void ThreadPool::workerLoop() {
+    uint64_t seen = 0;
+    std::unique_lock lock(m_mutex);
+    while (true) {
+      m_wake.wait(lock, [&] { return m_stop || m_generation != seen; });
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+      // Woken after the dispatch already finished
+      Job* job = m_job;
+      if (job == nullptr) {
+        continue;
+      }
+
+      // Counted as busy before taking any index, so the dispatcher can't
+      // return while a task taken by this worker is still running
+      m_busy++;
+      lock.unlock();
+      drain(*job);
+      lock.lock();
+      if (--m_busy == 0) {
+        m_done.notify_all();
+      }
+    }
+  }
+
+  void ThreadPool::dispatch(size_t tasks,
+                            const std::function<void(size_t)>& job) {
+    if (tasks == 0) {
+      return;
+    }
+    if (m_workers.empty() || tasks == 1) {
+      for (size_t i = 0; i < tasks; i++) {
+        job(i);
+      }
+      return;
+    }
+
+    Job current{.run = job, .size = tasks};
+    {
+      std::lock_guard lock(m_mutex);
+      m_job = &current;
+      m_generation++;
+    }
+    m_wake.notify_all();
+
+    drain(current);
+
+    // Workers only pick the job up under the lock, so none can reach it
+    // once it's cleared
+    std::unique_lock lock(m_mutex);
+    m_done.wait(lock, [&] { return m_busy == 0; });
+    m_job = nullptr;
+  }
+} // namespace cpu
@@ -2,6 +2,7 @@
 
 #include <gl/bitflag.hpp>
 #include <gl/id.hpp>
+#include <gl/stateCache.hpp>
 #include <glad/glad.h>
 #include <limits>
 
@@ -38,8 +39,10 @@ namespace gl {
     using MappingBitFlag = Bitflag<Mapping>;
 
     inline ~Buffer() {
-      if (m_id != 0)
+      if (m_id != 0) {
+        StateCache::get().forgetBuffer(m_id);
         glDeleteBuffers(1, m_id);
+      }
     }
 
     inline void init(GLuint size, const void* data = nullptr,
@@ -121,11 +124,11 @@ namespace gl {
     using TargetBitFlag = Bitflag<Target>;
 
     inline void bindBase(TargetBitFlag target, GLuint index) const {
-      glBindBufferBase(target, index, m_id);
+      StateCache::get().bindBufferBase(target, index, m_id);
     }
     inline void bindRange(TargetBitFlag target, GLuint index, GLuint offset,
                           GLuint size) const {
-      glBindBufferRange(target, index, m_id, offset, size);
+      StateCache::get().bindBufferRange(target, index, m_id, offset, size);
     }
   };
 } // namespace gl
\ No newline at end of file
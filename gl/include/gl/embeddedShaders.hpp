@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace gl {
+  struct EmbeddedShader {
+    // File name the shader would have in ./shaders/
+    std::string_view name;
+    const unsigned char* data;
+    size_t size;
+
+    std::string_view text() const {
+      return {reinterpret_cast<const char*>(data), size};
+    }
+  };
+
+  /// <summary>
+  /// Shaders compiled into the executable, which are used instead of the
+  /// files in ./shaders/ when present. Built with EMBED_SHADERS the
+  /// generated translation unit adds them during static initialization.
+  /// </summary>
+  class EmbeddedShaders {
+  public:
+    /// <summary>
+    /// Registers <paramref name="shaders"/>, which have to outlive every
+    /// lookup. Returns true so it can initialize a static.
+    /// </summary>
+    static bool add(std::span<const EmbeddedShader> shaders);
+
+    static std::optional<std::string_view> find(std::string_view name);
+
+    static size_t count();
+  };
+} // namespace gl
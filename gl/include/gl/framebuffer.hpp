@@ -1,8 +1,10 @@
 #pragma once
 
 #include <gl/id.hpp>
+#include <gl/stateCache.hpp>
 #include <gl/texture.hpp>
 #include <glad/glad.h>
+#include <utility>
 
 namespace gl {
   class Framebuffer {
@@ -10,6 +12,28 @@ namespace gl {
 
   public:
     Framebuffer() { glCreateFramebuffers(1, m_id); }
+    ~Framebuffer() {
+      if (m_id != 0) {
+        StateCache::get().forgetFramebuffer(m_id);
+        glDeleteFramebuffers(1, m_id);
+      }
+    }
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    Framebuffer(Framebuffer&& other) noexcept = default;
+    Framebuffer& operator=(Framebuffer&& other) noexcept {
+      if (this != &other) {
+        if (m_id != 0) {
+          StateCache::get().forgetFramebuffer(m_id);
+          glDeleteFramebuffers(1, m_id);
+        }
+        m_id = std::move(other.m_id);
+      }
+      return *this;
+    }
+
     const gl::Id& id() const { return m_id; }
 
     void attachTexture(GLenum attachment, GLuint texture,
@@ -21,12 +45,12 @@ namespace gl {
       glNamedFramebufferTexture(m_id, attachment, texture.id(), level);
     }
     void bind(GLenum target = GL_FRAMEBUFFER) const {
-      glBindFramebuffer(target, m_id);
+      StateCache::get().bindFramebuffer(target, m_id);
     }
-    void bindRead() const { glBindFramebuffer(GL_READ_FRAMEBUFFER, m_id); }
-    void bindDraw() const { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_id); }
+    void bindRead() const { bind(GL_READ_FRAMEBUFFER); }
+    void bindDraw() const { bind(GL_DRAW_FRAMEBUFFER); }
     static void unbind(GLenum target = GL_FRAMEBUFFER) {
-      glBindFramebuffer(target, 0);
+      StateCache::get().bindFramebuffer(target, 0);
     }
     void checkStatus(GLenum target = GL_FRAMEBUFFER) const {
       GLenum status = glCheckNamedFramebufferStatus(m_id, target);
@@ -5,9 +5,15 @@
 #include <GLFW/glfw3.h>
 
 #include <gl/buffer.hpp>
+#include <gl/embeddedShaders.hpp>
 #include <gl/framebuffer.hpp>
 #include <gl/gui.hpp>
+#include <gl/profiler.hpp>
+#include <gl/programCache.hpp>
 #include <gl/shaders.hpp>
+#include <gl/specializedPrograms.hpp>
+#include <gl/stateCache.hpp>
 #include <gl/texture.hpp>
+#include <gl/uploadRing.hpp>
 #include <gl/vao.hpp>
 #include <gl/window.hpp>
@@ -10,12 +10,31 @@ namespace gl::gui {
     ImGuiIO& _io;
 
   public:
-    Context(gl::Window& window);
+    /// <param name="installCallbacks">False when GLFW events are received on
+    /// another thread than the one building the UI. They then have to be
+    /// passed on with the add* calls, and frames started with the
+    /// newFrame overload taking the window state.</param>
+    Context(gl::Window& window, bool installCallbacks = true);
     ~Context();
 
     void newFrame();
+    /// <summary>
+    /// Starts a frame without querying GLFW, which only the main thread may
+    /// do, for a context created without callbacks.
+    /// </summary>
+    void newFrame(const gl::Window::Size& windowSize,
+                  const gl::Window::Size& framebufferSize, float deltaTime);
     void endFrame();
 
+    void addMousePos(double x, double y);
+    void addMouseButton(int button, bool down);
+    void addScroll(double x, double y);
+    /// <param name="key">GLFW key code</param>
+    /// <param name="mods">GLFW modifier bits</param>
+    void addKey(int key, int mods, bool down);
+    void addChar(unsigned int codepoint);
+    void addFocus(bool focused);
+
     ImGuiIO& io() { return _io; }
 
     void sleep(int ms);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <optional>
+
+namespace gl {
+  /// <summary>
+  /// An OpenGL context without a window, created through EGL. Prefers the
+  /// surfaceless Mesa platform and falls back to a 1x1 pbuffer, so it works on
+  /// display-less hosts and software drivers such as llvmpipe. Nothing is ever
+  /// presented; render into framebuffer objects instead of framebuffer 0.
+  /// </summary>
+  class HeadlessContext {
+    void* m_display = nullptr;
+    void* m_context = nullptr;
+    void* m_surface = nullptr;
+
+    HeadlessContext(void* display, void* context, void* surface)
+        : m_display(display), m_context(context), m_surface(surface) {}
+
+  public:
+    ~HeadlessContext();
+
+    HeadlessContext(const HeadlessContext&) = delete;
+    HeadlessContext& operator=(const HeadlessContext&) = delete;
+    HeadlessContext(HeadlessContext&& other) noexcept;
+    HeadlessContext& operator=(HeadlessContext&& other) noexcept;
+
+    /// <summary>
+    /// Creates a core profile context, makes it current and loads OpenGL.
+    /// </summary>
+    /// <param name="major">Requested OpenGL major version</param>
+    /// <param name="minor">Requested OpenGL minor version</param>
+    static std::optional<HeadlessContext> create(int major, int minor);
+
+    void makeCurrent() const;
+  };
+} // namespace gl
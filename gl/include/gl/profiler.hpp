@@ -0,0 +1,153 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <gl/uploadRing.hpp>
+#include <glad/glad.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace gl {
+  /// <summary>
+  /// GPU pass profiler built on a pool of GL_TIMESTAMP queries. Each frame
+  /// writes into its own set of queries; results are read back once the set
+  /// comes round again and only if they are available, so profiling never
+  /// stalls the pipeline. Frames whose results are not ready yet are dropped
+  /// instead.
+  /// </summary>
+  class GpuProfiler {
+  public:
+    /// <summary>
+    /// Number of frames of queries kept in flight, one more than the frames
+    /// the GPU may still have queued. With fewer, a GPU bound frame is read
+    /// back before it finished and every result of it is dropped.
+    /// </summary>
+    static constexpr size_t BUFFERED_FRAMES = UploadRing::FRAMES_IN_FLIGHT + 1;
+
+    struct Sample {
+      uint64_t frame;
+      double ms;
+    };
+
+    struct Timing {
+      std::string name;
+      int index;
+      std::string label;
+      // Nesting depth of the scope the last time it was recorded
+      uint32_t depth = 0;
+      double lastMs = 0.0;
+      // Frame lastMs was measured in
+      uint64_t lastFrame = 0;
+      double avgMs = 0.0;
+      std::vector<Sample> history{};
+      // Next write position once the history is full
+      size_t historyHead = 0;
+    };
+
+    /// <summary>
+    /// Ends the timer it was created from when it goes out of scope
+    /// </summary>
+    class Scope {
+      GpuProfiler* m_profiler;
+      size_t m_record;
+
+    public:
+      Scope(GpuProfiler* profiler, size_t record)
+          : m_profiler(profiler), m_record(record) {}
+      ~Scope() {
+        if (m_profiler != nullptr) {
+          m_profiler->end(m_record);
+        }
+      }
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+    };
+
+  private:
+    struct Record {
+      size_t timing;
+      uint32_t depth;
+      GLuint begin;
+      GLuint end;
+    };
+
+    struct FrameQueries {
+      std::vector<GLuint> queries{};
+      std::vector<Record> records{};
+      // Query the last ended scope issued, after every other one of the
+      // frame. Nested scopes end before the one around them
+      GLuint last = 0;
+      size_t used = 0;
+      uint64_t frame = 0;
+      bool pending = false;
+    };
+
+    std::array<FrameQueries, BUFFERED_FRAMES> m_frames{};
+    std::vector<Timing> m_timings{};
+    uint64_t m_frame = 0;
+    size_t m_current = 0;
+    uint32_t m_depth = 0;
+    size_t m_historySize = 240;
+    uint64_t m_droppedFrames = 0;
+    bool m_enabled = true;
+    bool m_inFrame = false;
+
+    static GpuProfiler s_instance;
+
+    GpuProfiler() = default;
+
+    GLuint nextQuery(FrameQueries& frame);
+    size_t findTiming(std::string_view name, int index);
+    void resolve(FrameQueries& frame, bool wait);
+    void end(size_t record);
+
+  public:
+    // Queries are left to be freed with the context, which is already gone by
+    // the time the static instance is destroyed
+    ~GpuProfiler() = default;
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    static GpuProfiler& get();
+
+    /// <summary>
+    /// Starts a frame, reading back the results of the oldest frame in
+    /// flight if the GPU has finished with it.
+    /// </summary>
+    void beginFrame();
+    void endFrame();
+
+    /// <summary>
+    /// Times everything issued until the returned scope is destroyed.
+    /// </summary>
+    /// <param name="name">Pass name</param>
+    /// <param name="index">Optional index appended to the label, e.g. the JFA
+    /// pass or cascade</param>
+    [[nodiscard]] Scope scope(std::string_view name, int index = -1);
+
+    /// <summary>
+    /// Blocks until every frame in flight has been resolved. Meant for
+    /// benchmarks, which stop measuring before reading the results.
+    /// </summary>
+    void flush();
+
+    /// <summary>
+    /// Forgets all timings and their history
+    /// </summary>
+    void reset();
+
+    bool& enabled() { return m_enabled; }
+    void setHistorySize(size_t size) { m_historySize = size; }
+    uint64_t droppedFrames() const { return m_droppedFrames; }
+    /// Index the next frame will get
+    uint64_t frame() const { return m_frame; }
+    const std::vector<Timing>& timings() const { return m_timings; }
+
+    /// <summary>
+    /// Writes the history of every pass as <c>frame,pass,ms</c> rows.
+    /// </summary>
+    bool dumpCsv(std::string_view path) const;
+  };
+} // namespace gl
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <gl/shaders.hpp>
+#include <glad/glad.h>
+#include <optional>
+#include <span>
+#include <string>
+#include <utility>
+
+namespace gl {
+  /// <summary>
+  /// On-disk cache of linked program binaries. Programs are keyed by a hash
+  /// of their sources and the driver's vendor, renderer and version, so a
+  /// driver update or an edited shader misses instead of loading a stale
+  /// binary. Binaries the driver rejects are deleted and rebuilt.
+  /// </summary>
+  class ProgramCache {
+  public:
+    struct Stats {
+      uint32_t hits = 0;
+      uint32_t misses = 0;
+      // Binaries found on disk that the driver refused to load
+      uint32_t rejected = 0;
+    };
+
+    using Source = std::pair<std::string, Shader::Type>;
+
+  private:
+    std::filesystem::path m_directory = "./shader_cache";
+    bool m_enabled = true;
+    // Hash of the driver strings, read once there is a context
+    std::optional<uint64_t> m_driverHash = std::nullopt;
+    std::optional<bool> m_supported = std::nullopt;
+    Stats m_stats{};
+
+    static ProgramCache s_instance;
+
+    ProgramCache() = default;
+
+    uint64_t driverHash();
+    std::filesystem::path path(uint64_t key) const;
+
+  public:
+    ProgramCache(const ProgramCache&) = delete;
+    ProgramCache& operator=(const ProgramCache&) = delete;
+
+    static ProgramCache& get();
+
+    bool& enabled() { return m_enabled; }
+    void setDirectory(std::filesystem::path directory) {
+      m_directory = std::move(directory);
+    }
+    const Stats& stats() const { return m_stats; }
+
+    /// <summary>
+    /// Whether the driver can hand out program binaries at all.
+    /// </summary>
+    bool supported();
+
+    uint64_t key(std::span<const Source> sources);
+
+    /// <summary>
+    /// Loads the binary stored under <paramref name="key"/>, if there is one
+    /// and the driver accepts it.
+    /// </summary>
+    std::optional<Program> load(uint64_t key);
+
+    /// <summary>
+    /// Writes the binary of <paramref name="program"/>, which has to have
+    /// been linked retrievable.
+    /// </summary>
+    void store(uint64_t key, const Program& program);
+  };
+} // namespace gl
@@ -1,18 +1,38 @@
 #pragma once
 
+#include <cstddef>
 #include <expected>
 #include <gl/id.hpp>
+#include <gl/stateCache.hpp>
 #include <glad/glad.h>
 #include <optional>
 #include <span>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace gl {
+  /// <summary>
+  /// Value of a SPIR-V specialization constant, by its constant_id
+  /// </summary>
+  struct Specialization {
+    GLuint id;
+    GLuint value;
+
+    bool operator==(const Specialization&) const = default;
+  };
+
   class Shader {
     gl::Id m_id;
 
+    explicit Shader(gl::Id&& id) : m_id(std::move(id)) {}
+
   public:
-    enum Type { VERTEX = GL_VERTEX_SHADER, FRAGMENT = GL_FRAGMENT_SHADER };
+    enum Type {
+      VERTEX = GL_VERTEX_SHADER,
+      FRAGMENT = GL_FRAGMENT_SHADER,
+      COMPUTE = GL_COMPUTE_SHADER
+    };
     Shader(Type type, std::string_view source);
     ~Shader();
 
@@ -24,6 +44,25 @@ namespace gl {
     const gl::Id& id() const { return m_id; }
 
     static std::optional<Shader> fromFile(std::string_view path, Type type);
+    /// <summary>
+    /// Reads the source of a shader without compiling it, from the
+    /// executable when it was embedded and from ./shaders/ otherwise.
+    /// </summary>
+    static std::optional<std::string> readSource(std::string_view path);
+
+    /// <summary>
+    /// Specializes the <paramref name="entry"/> point of a SPIR-V module.
+    /// Constants missing from <paramref name="values"/> keep the default
+    /// of the shader.
+    /// </summary>
+    static std::optional<Shader>
+    fromSpirv(Type type, std::string_view module, std::string_view entry,
+              std::span<const Specialization> values);
+  };
+
+  struct ProgramBinary {
+    GLenum format;
+    std::vector<std::byte> data;
   };
 
   class Program {
@@ -47,11 +86,17 @@ namespace gl {
       return Program(gl::Id(id));
     }
 
-    inline static std::optional<Program> create(std::span<Shader>&& shaders) {
+    /// <param name="retrievable">Hints the driver that binary() will be
+    /// called, some only keep the binary around when asked to</param>
+    inline static std::optional<Program> create(std::span<Shader>&& shaders,
+                                                bool retrievable = false) {
       GLuint id = glCreateProgram();
       for (const auto& shader : shaders) {
         glAttachShader(id, shader.id());
       }
+      if (retrievable) {
+        glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+      }
       glLinkProgram(id);
       if (handleLinkFail(id)) {
         return std::nullopt;
@@ -59,26 +104,37 @@ namespace gl {
       return Program(gl::Id(id));
     }
 
-    void bind() const { glUseProgram(m_id); }
+    /// <summary>
+    /// Loads a binary from binary(). Drivers reject binaries from other
+    /// drivers or versions, which is not an error, so nothing is logged.
+    /// </summary>
+    static std::optional<Program> fromBinary(GLenum format,
+                                             std::span<const std::byte> data);
+
+    /// <summary>
+    /// The linked binary, for loading with fromBinary() in a later run.
+    /// </summary>
+    std::optional<ProgramBinary> binary() const;
+
+    void bind() const { StateCache::get().useProgram(m_id); }
+
+    /// <summary>
+    /// Compiles and links the shaders in ./shaders/, or loads them from the
+    /// program cache when they were linked before with the same sources.
+    /// </summary>
     static std::expected<Program, std::string>
     fromFiles(std::initializer_list<std::pair<std::string_view, Shader::Type>>
-                  paths) {
-      std::vector<Shader> shaders;
-      shaders.reserve(paths.size());
-      for (const auto& [path, type] : paths) {
-        auto shaderOpt = Shader::fromFile(path, type);
-        if (!shaderOpt.has_value()) {
-          return std::unexpected(std::string("Failed to load shader from ") +
-                                 std::string(path));
-        }
-        shaders.push_back(std::move(shaderOpt.value()));
-      }
+                  paths);
 
-      auto programOpt = create(shaders);
-      if (!programOpt.has_value()) {
-        return std::unexpected("Failed to link program");
-      }
-      return std::move(programOpt.value());
-    }
+    /// <summary>
+    /// Links the entry points of a SPIR-V module specialized with
+    /// <paramref name="values"/>, through the program cache like
+    /// fromFiles().
+    /// </summary>
+    static std::expected<Program, std::string>
+    fromSpirv(std::string_view module,
+              std::span<const std::pair<std::string_view, Shader::Type>>
+                  entries,
+              std::span<const Specialization> values);
   };
 } // namespace gl
\ No newline at end of file
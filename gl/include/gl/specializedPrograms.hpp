@@ -0,0 +1,54 @@
+#pragma once
+
+#include <gl/shaders.hpp>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace gl {
+  /// <summary>
+  /// A SPIR-V module linked once per set of specialization constants. The
+  /// programs are kept, so switching back to values used before is free,
+  /// and linked through the program cache, so later runs skip the driver
+  /// compile as well.
+  /// </summary>
+  class SpecializedPrograms {
+    struct Variant {
+      std::vector<Specialization> values;
+      // Empty if the values failed to specialize, those aren't retried
+      std::optional<Program> program;
+    };
+
+    std::string m_module;
+    std::vector<std::pair<std::string, Shader::Type>> m_entries;
+    std::vector<Variant> m_variants{};
+
+    SpecializedPrograms(
+        std::string&& module,
+        std::vector<std::pair<std::string, Shader::Type>>&& entries)
+        : m_module(std::move(module)), m_entries(std::move(entries)) {}
+
+  public:
+    /// <summary>
+    /// Reads the module at <paramref name="path"/> like a shader source.
+    /// Empty if it wasn't built or the driver can't load SPIR-V.
+    /// </summary>
+    static std::optional<SpecializedPrograms>
+    fromFile(std::string_view path,
+             std::initializer_list<std::pair<std::string_view, Shader::Type>>
+                 entries);
+
+    /// <summary>
+    /// The program specialized with <paramref name="values"/>, linked on
+    /// first use. Null if the driver rejected them. Only valid until the
+    /// next call, which may add a variant.
+    /// </summary>
+    const Program* get(std::span<const Specialization> values);
+
+    size_t size() const { return m_variants.size(); }
+  };
+} // namespace gl
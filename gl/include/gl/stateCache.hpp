@@ -0,0 +1,168 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <glad/glad.h>
+#include <limits>
+
+namespace gl {
+  /// <summary>
+  /// Shadow copy of the bindings the wrappers change: the program, the VAO,
+  /// the texture units, the framebuffers and the indexed uniform and storage
+  /// buffers. Binds that would leave the state as it is are skipped, along
+  /// with the driver's validation of them, which is what costs the most on
+  /// software and debug drivers. Code that binds with raw GL calls, like the
+  /// ImGui backend, has to call <c>invalidate</c> afterwards.
+  /// </summary>
+  class StateCache {
+  public:
+    /// Units and binding indices past these are always bound
+    static constexpr size_t TEXTURE_UNITS = 32;
+    static constexpr size_t BUFFER_BINDINGS = 16;
+
+    struct Counters {
+      uint64_t issued = 0;
+      uint64_t elided = 0;
+    };
+
+  private:
+    // Never a name GL hands out, so the next bind is issued whatever it is
+    static constexpr GLuint UNKNOWN = std::numeric_limits<GLuint>::max();
+
+    struct BufferBinding {
+      GLuint buffer = UNKNOWN;
+      GLintptr offset = 0;
+      // 0 when the whole buffer is bound
+      GLsizeiptr size = 0;
+
+      bool operator==(const BufferBinding&) const = default;
+    };
+
+    GLuint m_program = UNKNOWN;
+    GLuint m_vao = UNKNOWN;
+    GLuint m_drawFramebuffer = UNKNOWN;
+    GLuint m_readFramebuffer = UNKNOWN;
+    std::array<GLuint, TEXTURE_UNITS> m_textures{};
+    std::array<BufferBinding, BUFFER_BINDINGS> m_uniformBuffers{};
+    std::array<BufferBinding, BUFFER_BINDINGS> m_storageBuffers{};
+
+    Counters m_frame{};
+    Counters m_lastFrame{};
+    bool m_enabled = true;
+
+    static StateCache s_instance;
+
+    StateCache() { invalidate(); }
+
+    /// True if the call has to be made, which is then counted
+    template <typename T> bool update(T& cached, const T& value) {
+      if (m_enabled && cached == value) {
+        m_frame.elided++;
+        return false;
+      }
+      cached = value;
+      m_frame.issued++;
+      return true;
+    }
+
+    BufferBinding* bufferBinding(GLenum target, GLuint index) {
+      if (index >= BUFFER_BINDINGS) {
+        return nullptr;
+      }
+      switch (target) {
+      case GL_UNIFORM_BUFFER:
+        return &m_uniformBuffers[index];
+      case GL_SHADER_STORAGE_BUFFER:
+        return &m_storageBuffers[index];
+      default:
+        return nullptr;
+      }
+    }
+
+  public:
+    StateCache(const StateCache&) = delete;
+    StateCache& operator=(const StateCache&) = delete;
+
+    static StateCache& get();
+
+    void useProgram(GLuint program) {
+      if (update(m_program, program)) {
+        glUseProgram(program);
+      }
+    }
+
+    void bindVertexArray(GLuint vao) {
+      if (update(m_vao, vao)) {
+        glBindVertexArray(vao);
+      }
+    }
+
+    void bindTextureUnit(GLuint unit, GLuint texture) {
+      if (unit >= TEXTURE_UNITS) {
+        m_frame.issued++;
+        glBindTextureUnit(unit, texture);
+        return;
+      }
+      if (update(m_textures[unit], texture)) {
+        glBindTextureUnit(unit, texture);
+      }
+    }
+
+    /// <summary>
+    /// <c>GL_FRAMEBUFFER</c> binds both the draw and the read framebuffer,
+    /// and is only skipped if both are already bound.
+    /// </summary>
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+      auto* binding = bufferBinding(target, index);
+      if (binding == nullptr) {
+        m_frame.issued++;
+        glBindBufferBase(target, index, buffer);
+        return;
+      }
+      if (update(*binding, BufferBinding{.buffer = buffer})) {
+        glBindBufferBase(target, index, buffer);
+      }
+    }
+
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                         GLintptr offset, GLsizeiptr size) {
+      auto* binding = bufferBinding(target, index);
+      if (binding == nullptr) {
+        m_frame.issued++;
+        glBindBufferRange(target, index, buffer, offset, size);
+        return;
+      }
+      if (update(*binding, BufferBinding{buffer, offset, size})) {
+        glBindBufferRange(target, index, buffer, offset, size);
+      }
+    }
+
+    /// <summary>
+    /// Forgets every binding, the next bind of each kind is issued.
+    /// </summary>
+    void invalidate();
+
+    /// <summary>
+    /// Called before the object is deleted. GL unbinds deleted objects and
+    /// may hand their names out again, so the cache must not match them.
+    /// </summary>
+    void forgetVertexArray(GLuint vao);
+    void forgetTexture(GLuint texture);
+    void forgetFramebuffer(GLuint framebuffer);
+    void forgetBuffer(GLuint buffer);
+
+    void beginFrame() { m_frame = {}; }
+    void endFrame() { m_lastFrame = m_frame; }
+
+    /// <summary>
+    /// When disabled every bind is issued, the bindings are still tracked so
+    /// enabling it again is safe.
+    /// </summary>
+    bool& enabled() { return m_enabled; }
+    /// Calls made and skipped during the last finished frame
+    const Counters& lastFrame() const { return m_lastFrame; }
+  };
+} // namespace gl
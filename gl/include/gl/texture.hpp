@@ -1,7 +1,9 @@
 #pragma once
 
 #include <gl/id.hpp>
+#include <gl/stateCache.hpp>
 #include <glad/glad.h>
+#include <utility>
 
 namespace gl {
   class Texture {
@@ -17,10 +19,41 @@ namespace gl {
 
   public:
     Texture() { glCreateTextures(GL_TEXTURE_2D, 1, m_id); }
+    ~Texture() {
+      if (m_id != 0) {
+        StateCache::get().forgetTexture(m_id);
+        glDeleteTextures(1, m_id);
+      }
+    }
+
+    Texture(const Texture&) = delete;
+    Texture& operator=(const Texture&) = delete;
+
+    Texture(Texture&& other) noexcept = default;
+    Texture& operator=(Texture&& other) noexcept {
+      if (this != &other) {
+        if (m_id != 0) {
+          StateCache::get().forgetTexture(m_id);
+          glDeleteTextures(1, m_id);
+        }
+        m_id = std::move(other.m_id);
+        m_size = other.m_size;
+      }
+      return *this;
+    }
+
     const gl::Id& id() const { return m_id; }
 
-    void bind(GLenum unit) const { glBindTextureUnit(unit, m_id); }
-    static void unbind(GLenum unit) { glBindTextureUnit(unit, 0); }
+    void bind(GLenum unit) const {
+      StateCache::get().bindTextureUnit(unit, m_id);
+    }
+    static void unbind(GLenum unit) {
+      StateCache::get().bindTextureUnit(unit, 0);
+    }
+    void bindImage(GLuint unit, GLint level, GLenum access,
+                   GLenum format) const {
+      glBindImageTexture(unit, m_id, level, GL_FALSE, 0, access, format);
+    }
     void setParameter(GLenum pname, GLint param) const {
       glTextureParameteri(m_id, pname, param);
     }
@@ -34,6 +67,10 @@ namespace gl {
       glTextureSubImage2D(m_id, level, xoffset, yoffset, width, height, format,
                           type, pixels);
     }
+    void getImage(GLint level, GLenum format, GLenum type, GLsizei bufSize,
+                  void* pixels) const {
+      glGetTextureImage(m_id, level, format, type, bufSize, pixels);
+    }
 
     const Size& size() const { return m_size; }
   };
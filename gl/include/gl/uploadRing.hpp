@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <gl/buffer.hpp>
+#include <gl/stateCache.hpp>
+#include <glad/glad.h>
+#include <optional>
+#include <vector>
+
+namespace gl {
+  /// <summary>
+  /// Upload heap for per-pass uniform data. A single persistently mapped
+  /// buffer is split into one region per frame in flight; passes copy their
+  /// parameters into the current region and bind the sub-allocation with
+  /// <c>glBindBufferRange</c>. Each region is fenced when its frame ends and
+  /// only waited on when the ring comes back around to it, so a write never
+  /// lands in memory a draw of an earlier frame may still be reading.
+  /// </summary>
+  class UploadRing {
+  public:
+    /// Frames that can be queued before the CPU waits for the GPU
+    static constexpr size_t FRAMES_IN_FLIGHT = 3;
+
+    struct Allocation {
+      GLuint buffer;
+      GLuint offset;
+      GLuint size;
+      void* data;
+    };
+
+  private:
+    // Created on first use, there is no context yet when the instance is
+    // constructed
+    std::optional<StorageBuffer> m_buffer = std::nullopt;
+    std::byte* m_mapping = nullptr;
+    GLuint m_regionSize = 64 * 1024;
+    GLuint m_alignment = 256;
+
+    std::array<GLsync, FRAMES_IN_FLIGHT> m_fences{};
+    // Buffers for what did not fit in a region, freed with it
+    std::array<std::vector<StorageBuffer>, FRAMES_IN_FLIGHT> m_spills{};
+    size_t m_region = 0;
+    GLuint m_head = 0;
+    GLuint m_lastUsed = 0;
+
+    uint64_t m_stalls = 0;
+    uint64_t m_overflows = 0;
+
+    static UploadRing s_instance;
+
+    UploadRing() = default;
+
+    void ensureBuffer();
+    GLuint regionStart() const {
+      return static_cast<GLuint>(m_region) * m_regionSize;
+    }
+
+  public:
+    // Fences and the buffer are left to be freed with the context, which is
+    // already gone by the time the static instance is destroyed
+    ~UploadRing() = default;
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    static UploadRing& get();
+
+    /// <summary>
+    /// Moves on to the next region, waiting for the GPU only if the frame
+    /// that last used it has not finished yet.
+    /// </summary>
+    void beginFrame();
+
+    /// <summary>
+    /// Fences everything allocated since <c>beginFrame</c>.
+    /// </summary>
+    void endFrame();
+
+    /// <summary>
+    /// Hands out <paramref name="size"/> bytes of the current region, aligned
+    /// for uniform buffer binding. What does not fit gets a buffer of its own
+    /// that lives as long as the region's frame.
+    /// </summary>
+    Allocation allocate(GLuint size);
+
+    template <typename T> Allocation upload(const T& value) {
+      auto allocation = allocate(sizeof(T));
+      std::memcpy(allocation.data, &value, sizeof(T));
+      return allocation;
+    }
+
+    static void bindUniform(const Allocation& allocation, GLuint index) {
+      StateCache::get().bindBufferRange(GL_UNIFORM_BUFFER, index,
+                                        allocation.buffer, allocation.offset,
+                                        allocation.size);
+    }
+
+    /// <summary>
+    /// Uploads <paramref name="value"/> and binds it to uniform block
+    /// <paramref name="index"/>.
+    /// </summary>
+    template <typename T> void bindUniform(const T& value, GLuint index) {
+      bindUniform(upload(value), index);
+    }
+
+    /// Frames that had to wait for their region to be released
+    uint64_t stalls() const { return m_stalls; }
+    /// Allocations that did not fit in their region
+    uint64_t overflows() const { return m_overflows; }
+    /// Bytes allocated in the last finished frame
+    GLuint used() const { return m_lastUsed; }
+    GLuint regionSize() const { return m_regionSize; }
+  };
+} // namespace gl
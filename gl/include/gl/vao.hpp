@@ -1,6 +1,7 @@
 #pragma once
 
 #include <gl/id.hpp>
+#include <gl/stateCache.hpp>
 #include <glad/glad.h>
 #include <optional>
 
@@ -12,8 +13,10 @@ namespace gl {
   public:
     inline Vao() { glCreateVertexArrays(1, m_id); }
     inline ~Vao() {
-      if (m_id != 0)
+      if (m_id != 0) {
+        StateCache::get().forgetVertexArray(m_id);
         glDeleteVertexArrays(1, m_id);
+      }
     }
     Vao(const Vao&) = delete;
     Vao& operator=(const Vao&) = delete;
@@ -21,7 +24,7 @@ namespace gl {
     Vao& operator=(Vao&& other) noexcept = default;
 
     inline const gl::Id& id() const { return m_id; }
-    inline void bind() const { glBindVertexArray(m_id); }
+    inline void bind() const { StateCache::get().bindVertexArray(m_id); }
     static void unbind();
 
     /// <summary>
@@ -51,6 +54,12 @@ namespace gl {
 
     void bindAttribs(GLuint bufferIndex,
                      std::initializer_list<GLuint> attribIndices);
+    /// <summary>
+    /// Advance the buffer bound at <paramref name="bufferIndex"/> once every
+    /// <paramref name="divisor"/> instances instead of once per vertex.
+    /// Uses DSA
+    /// </summary>
+    void bindingDivisor(GLuint bufferIndex, GLuint divisor);
     class BindGuard {
     public:
       ~BindGuard() { Vao::unbind(); }
@@ -13,7 +13,8 @@ namespace gl {
 
     static gl::WindowManager s_instance;
 
-    static int loadGl();
+    using ProcLoader = void* (*)(const char* name);
+    static int loadGl(ProcLoader loader);
 
     WindowManager();
 
@@ -32,6 +33,7 @@ namespace gl {
     }
 
     friend class Window;
+    friend class HeadlessContext;
   };
 
   /// <summary>
@@ -57,6 +59,15 @@ namespace gl {
     bool shouldClose() const;
     void swapBuffers() const;
     static void pollEvents();
+    /// <summary>
+    /// Sleeps until at least one event arrived, then processes them
+    /// </summary>
+    static void waitEvents();
+    /// <summary>
+    /// Releases the current context of the calling thread, so another one can
+    /// make it current
+    /// </summary>
+    static void releaseCurrent();
 
     void setUserPtr(void* ptr);
     static void* getUserPtr(GLFWwindow* window);
@@ -69,6 +80,24 @@ namespace gl {
     void setMouseButtonCallback(GLFWmousebuttonfun callback) {
       glfwSetMouseButtonCallback(window, callback);
     }
+    void setCharCallback(GLFWcharfun callback) {
+      glfwSetCharCallback(window, callback);
+    }
+    void setScrollCallback(GLFWscrollfun callback) {
+      glfwSetScrollCallback(window, callback);
+    }
+    void setWindowSizeCallback(GLFWwindowsizefun callback) {
+      glfwSetWindowSizeCallback(window, callback);
+    }
+    void setFramebufferSizeCallback(GLFWframebuffersizefun callback) {
+      glfwSetFramebufferSizeCallback(window, callback);
+    }
+    void setIconifyCallback(GLFWwindowiconifyfun callback) {
+      glfwSetWindowIconifyCallback(window, callback);
+    }
+    void setFocusCallback(GLFWwindowfocusfun callback) {
+      glfwSetWindowFocusCallback(window, callback);
+    }
 
     struct Size {
       int width;
@@ -80,5 +109,6 @@ namespace gl {
     };
 
     Size size() const;
+    Size framebufferSize() const;
   };
 } // namespace gl
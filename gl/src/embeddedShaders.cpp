@@ -0,0 +1,38 @@
+#include "gl/embeddedShaders.hpp"
+#include <vector>
+
+namespace gl {
+  namespace {
+    // Function local, as the generated translation unit registers during
+    // static initialization in an unspecified order
+    std::vector<std::span<const EmbeddedShader>>& registered() {
+      static std::vector<std::span<const EmbeddedShader>> shaders;
+      return shaders;
+    }
+  } // namespace
+
+  bool EmbeddedShaders::add(std::span<const EmbeddedShader> shaders) {
+    registered().push_back(shaders);
+    return true;
+  }
+
+  std::optional<std::string_view>
+  EmbeddedShaders::find(std::string_view name) {
+    for (const auto& shaders : registered()) {
+      for (const auto& shader : shaders) {
+        if (shader.name == name) {
+          return shader.text();
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  size_t EmbeddedShaders::count() {
+    size_t count = 0;
+    for (const auto& shaders : registered()) {
+      count += shaders.size();
+    }
+    return count;
+  }
+} // namespace gl
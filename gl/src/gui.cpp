@@ -1,18 +1,96 @@
 #include "gl/gui.hpp"
+#include "gl/stateCache.hpp"
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_opengl3.h"
 #include "imgui/imgui.h"
 
+namespace {
+  ImGuiKey toImGuiKey(int key) {
+    if (key >= GLFW_KEY_A && key <= GLFW_KEY_Z) {
+      return static_cast<ImGuiKey>(ImGuiKey_A + (key - GLFW_KEY_A));
+    }
+    if (key >= GLFW_KEY_0 && key <= GLFW_KEY_9) {
+      return static_cast<ImGuiKey>(ImGuiKey_0 + (key - GLFW_KEY_0));
+    }
+    if (key >= GLFW_KEY_F1 && key <= GLFW_KEY_F12) {
+      return static_cast<ImGuiKey>(ImGuiKey_F1 + (key - GLFW_KEY_F1));
+    }
+    switch (key) {
+    case GLFW_KEY_TAB:
+      return ImGuiKey_Tab;
+    case GLFW_KEY_LEFT:
+      return ImGuiKey_LeftArrow;
+    case GLFW_KEY_RIGHT:
+      return ImGuiKey_RightArrow;
+    case GLFW_KEY_UP:
+      return ImGuiKey_UpArrow;
+    case GLFW_KEY_DOWN:
+      return ImGuiKey_DownArrow;
+    case GLFW_KEY_PAGE_UP:
+      return ImGuiKey_PageUp;
+    case GLFW_KEY_PAGE_DOWN:
+      return ImGuiKey_PageDown;
+    case GLFW_KEY_HOME:
+      return ImGuiKey_Home;
+    case GLFW_KEY_END:
+      return ImGuiKey_End;
+    case GLFW_KEY_INSERT:
+      return ImGuiKey_Insert;
+    case GLFW_KEY_DELETE:
+      return ImGuiKey_Delete;
+    case GLFW_KEY_BACKSPACE:
+      return ImGuiKey_Backspace;
+    case GLFW_KEY_SPACE:
+      return ImGuiKey_Space;
+    case GLFW_KEY_ENTER:
+      return ImGuiKey_Enter;
+    case GLFW_KEY_KP_ENTER:
+      return ImGuiKey_KeypadEnter;
+    case GLFW_KEY_ESCAPE:
+      return ImGuiKey_Escape;
+    case GLFW_KEY_MINUS:
+      return ImGuiKey_Minus;
+    case GLFW_KEY_PERIOD:
+      return ImGuiKey_Period;
+    case GLFW_KEY_LEFT_SHIFT:
+      return ImGuiKey_LeftShift;
+    case GLFW_KEY_LEFT_CONTROL:
+      return ImGuiKey_LeftCtrl;
+    case GLFW_KEY_LEFT_ALT:
+      return ImGuiKey_LeftAlt;
+    case GLFW_KEY_LEFT_SUPER:
+      return ImGuiKey_LeftSuper;
+    case GLFW_KEY_RIGHT_SHIFT:
+      return ImGuiKey_RightShift;
+    case GLFW_KEY_RIGHT_CONTROL:
+      return ImGuiKey_RightCtrl;
+    case GLFW_KEY_RIGHT_ALT:
+      return ImGuiKey_RightAlt;
+    case GLFW_KEY_RIGHT_SUPER:
+      return ImGuiKey_RightSuper;
+    default:
+      return ImGuiKey_None;
+    }
+  }
+} // namespace
+
 namespace gl::gui {
-  Context::Context(gl::Window& window)
+  Context::Context(gl::Window& window, bool installCallbacks)
       : _io((IMGUI_CHECKVERSION(), ImGui::CreateContext(), ImGui::GetIO())) {
     _io.ConfigFlags |=
         ImGuiConfigFlags_NavEnableKeyboard; // Enable Keyboard Controls
 
     ImGui::StyleColorsDark();
 
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplGlfw_InitForOpenGL(window, installCallbacks);
     ImGui_ImplOpenGL3_Init("#version 460");
+    if (!installCallbacks) {
+      // The GLFW clipboard may only be used from the main thread, ImGui keeps
+      // its own instead
+      auto& platform = ImGui::GetPlatformIO();
+      platform.Platform_GetClipboardTextFn = nullptr;
+      platform.Platform_SetClipboardTextFn = nullptr;
+    }
   }
 
   Context::~Context() {
@@ -26,9 +104,54 @@ namespace gl::gui {
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
   }
+  void Context::newFrame(const gl::Window::Size& windowSize,
+                         const gl::Window::Size& framebufferSize,
+                         float deltaTime) {
+    ImGui_ImplOpenGL3_NewFrame();
+    _io.DisplaySize = ImVec2(static_cast<float>(windowSize.width),
+                             static_cast<float>(windowSize.height));
+    if (windowSize.width > 0 && windowSize.height > 0) {
+      _io.DisplayFramebufferScale = ImVec2(
+          static_cast<float>(framebufferSize.width) /
+              static_cast<float>(windowSize.width),
+          static_cast<float>(framebufferSize.height) /
+              static_cast<float>(windowSize.height));
+    }
+    // ImGui asserts on a zero delta
+    _io.DeltaTime = deltaTime > 0.f ? deltaTime : 1.f / 1000.f;
+    ImGui::NewFrame();
+  }
+
+  void Context::addMousePos(double x, double y) {
+    _io.AddMousePosEvent(static_cast<float>(x), static_cast<float>(y));
+  }
+  void Context::addMouseButton(int button, bool down) {
+    if (button >= 0 && button < ImGuiMouseButton_COUNT) {
+      _io.AddMouseButtonEvent(button, down);
+    }
+  }
+  void Context::addScroll(double x, double y) {
+    _io.AddMouseWheelEvent(static_cast<float>(x), static_cast<float>(y));
+  }
+  void Context::addKey(int key, int mods, bool down) {
+    _io.AddKeyEvent(ImGuiMod_Ctrl, (mods & GLFW_MOD_CONTROL) != 0);
+    _io.AddKeyEvent(ImGuiMod_Shift, (mods & GLFW_MOD_SHIFT) != 0);
+    _io.AddKeyEvent(ImGuiMod_Alt, (mods & GLFW_MOD_ALT) != 0);
+    _io.AddKeyEvent(ImGuiMod_Super, (mods & GLFW_MOD_SUPER) != 0);
+    if (auto imguiKey = toImGuiKey(key); imguiKey != ImGuiKey_None) {
+      _io.AddKeyEvent(imguiKey, down);
+    }
+  }
+  void Context::addChar(unsigned int codepoint) {
+    _io.AddInputCharacter(codepoint);
+  }
+  void Context::addFocus(bool focused) { _io.AddFocusEvent(focused); }
+
   void Context::endFrame() {
     ImGui::Render();
     ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    // The backend binds its own program, VAO and texture
+    StateCache::get().invalidate();
   }
 
   void Context::sleep(int ms) { ImGui_ImplGlfw_Sleep(ms); }
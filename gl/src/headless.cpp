@@ -0,0 +1,170 @@
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl/headless.hpp"
+#include "gl/window.hpp"
+#include "logger.hpp"
+#include <string_view>
+#include <utility>
+
+namespace {
+  bool hasExtension(const char* extensions, std::string_view name) {
+    if (extensions == nullptr) {
+      return false;
+    }
+    std::string_view list(extensions);
+    size_t pos = 0;
+    while ((pos = list.find(name, pos)) != std::string_view::npos) {
+      size_t end = pos + name.size();
+      bool startOk = pos == 0 || list[pos - 1] == ' ';
+      bool endOk = end == list.size() || list[end] == ' ';
+      if (startOk && endOk) {
+        return true;
+      }
+      pos = end;
+    }
+    return false;
+  }
+
+  EGLDisplay getDisplay() {
+    const char* clientExtensions =
+        eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+
+    if (hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+      auto getPlatformDisplay =
+          reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+              eglGetProcAddress("eglGetPlatformDisplayEXT"));
+      if (getPlatformDisplay != nullptr) {
+        EGLDisplay display = getPlatformDisplay(
+            EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        if (display != EGL_NO_DISPLAY) {
+          gl::Logger::debug("Using EGL surfaceless platform");
+          return display;
+        }
+      }
+    }
+
+    return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+} // namespace
+
+namespace gl {
+  std::optional<HeadlessContext> HeadlessContext::create(int major,
+                                                         int minor) {
+    EGLDisplay display = getDisplay();
+    if (display == EGL_NO_DISPLAY) {
+      gl::Logger::error("Failed to get an EGL display");
+      return std::nullopt;
+    }
+
+    EGLint eglMajor = 0;
+    EGLint eglMinor = 0;
+    if (!eglInitialize(display, &eglMajor, &eglMinor)) {
+      gl::Logger::error("Failed to initialize EGL: 0x{:x}", eglGetError());
+      return std::nullopt;
+    }
+    gl::Logger::debug("Initialized EGL {}.{}", eglMajor, eglMinor);
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+      gl::Logger::error("EGL does not support desktop OpenGL");
+      eglTerminate(display);
+      return std::nullopt;
+    }
+
+    const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE,    EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE,
+        EGL_OPENGL_BIT,      EGL_RED_SIZE,    8,
+        EGL_GREEN_SIZE,      8,               EGL_BLUE_SIZE,
+        8,                   EGL_ALPHA_SIZE,  8,
+        EGL_NONE,
+    };
+    EGLConfig config = nullptr;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) ||
+        numConfigs == 0) {
+      gl::Logger::error("No suitable EGL config found");
+      eglTerminate(display);
+      return std::nullopt;
+    }
+
+    const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION,
+        major,
+        EGL_CONTEXT_MINOR_VERSION,
+        minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+#ifndef NDEBUG
+        EGL_CONTEXT_OPENGL_DEBUG,
+        EGL_TRUE,
+#endif
+        EGL_NONE,
+    };
+    EGLContext context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT) {
+      gl::Logger::error("Failed to create OpenGL {}.{} context: 0x{:x}", major,
+                        minor, eglGetError());
+      eglTerminate(display);
+      return std::nullopt;
+    }
+
+    EGLSurface surface = EGL_NO_SURFACE;
+    if (!hasExtension(eglQueryString(display, EGL_EXTENSIONS),
+                      "EGL_KHR_surfaceless_context")) {
+      const EGLint pbufferAttribs[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+      surface = eglCreatePbufferSurface(display, config, pbufferAttribs);
+      if (surface == EGL_NO_SURFACE) {
+        gl::Logger::error("Failed to create EGL pbuffer: 0x{:x}",
+                          eglGetError());
+        eglDestroyContext(display, context);
+        eglTerminate(display);
+        return std::nullopt;
+      }
+      gl::Logger::debug("Using 1x1 EGL pbuffer surface");
+    }
+
+    HeadlessContext headless(display, context, surface);
+    headless.makeCurrent();
+
+    if (WindowManager::loadGl(
+            reinterpret_cast<WindowManager::ProcLoader>(eglGetProcAddress)) ==
+        0) {
+      return std::nullopt;
+    }
+
+    return headless;
+  }
+
+  HeadlessContext::~HeadlessContext() {
+    if (m_display == nullptr) {
+      return;
+    }
+    eglMakeCurrent(m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (m_surface != EGL_NO_SURFACE) {
+      eglDestroySurface(m_display, m_surface);
+    }
+    eglDestroyContext(m_display, m_context);
+    eglTerminate(m_display);
+  }
+
+  HeadlessContext::HeadlessContext(HeadlessContext&& other) noexcept
+      : m_display(std::exchange(other.m_display, nullptr)),
+        m_context(std::exchange(other.m_context, nullptr)),
+        m_surface(std::exchange(other.m_surface, nullptr)) {}
+
+  HeadlessContext&
+  HeadlessContext::operator=(HeadlessContext&& other) noexcept {
+    std::swap(m_display, other.m_display);
+    std::swap(m_context, other.m_context);
+    std::swap(m_surface, other.m_surface);
+    return *this;
+  }
+
+  void HeadlessContext::makeCurrent() const {
+    if (!eglMakeCurrent(m_display, m_surface, m_surface, m_context)) {
+      gl::Logger::error("Failed to make EGL context current: 0x{:x}",
+                        eglGetError());
+    }
+  }
+} // namespace gl
@@ -0,0 +1,170 @@
+#include "gl/profiler.hpp"
+#include "logger.hpp"
+#include <fstream>
+
+namespace gl {
+  GpuProfiler GpuProfiler::s_instance;
+  GpuProfiler& GpuProfiler::get() { return s_instance; }
+
+  GLuint GpuProfiler::nextQuery(FrameQueries& frame) {
+    if (frame.used == frame.queries.size()) {
+      // Grow in chunks so the first frames don't create queries one by one
+      size_t grow = std::max<size_t>(frame.queries.size(), 32);
+      frame.queries.resize(frame.queries.size() + grow, 0);
+      glCreateQueries(GL_TIMESTAMP, static_cast<GLsizei>(grow),
+                      frame.queries.data() + frame.used);
+    }
+    return frame.queries[frame.used++];
+  }
+
+  size_t GpuProfiler::findTiming(std::string_view name, int index) {
+    for (size_t i = 0; i < m_timings.size(); i++) {
+      if (m_timings[i].index == index && m_timings[i].name == name) {
+        return i;
+      }
+    }
+
+    std::string label = index < 0 ? std::string(name)
+                                  : fmt::format("{} {}", name, index);
+    m_timings.push_back(
+        Timing{.name = std::string(name), .index = index, .label = label});
+    return m_timings.size() - 1;
+  }
+
+  void GpuProfiler::resolve(FrameQueries& frame, bool wait) {
+    if (!frame.pending) {
+      return;
+    }
+    frame.pending = false;
+
+    if (frame.records.empty() || frame.last == 0) {
+      return;
+    }
+
+    if (!wait) {
+      // Queries complete in order, so the last one issued tells us about all
+      // of them
+      GLint available = GL_FALSE;
+      glGetQueryObjectiv(frame.last, GL_QUERY_RESULT_AVAILABLE, &available);
+      if (available == GL_FALSE) {
+        m_droppedFrames++;
+        return;
+      }
+    }
+
+    for (const auto& record : frame.records) {
+      GLuint64 begin = 0;
+      GLuint64 end = 0;
+      glGetQueryObjectui64v(record.begin, GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(record.end, GL_QUERY_RESULT, &end);
+
+      auto& timing = m_timings[record.timing];
+      timing.depth = record.depth;
+      timing.lastMs = static_cast<double>(end - begin) / 1.0e6;
+      timing.lastFrame = frame.frame;
+
+      Sample sample{.frame = frame.frame, .ms = timing.lastMs};
+      if (timing.history.size() < m_historySize) {
+        timing.history.push_back(sample);
+      } else if (!timing.history.empty()) {
+        timing.history[timing.historyHead] = sample;
+        timing.historyHead = (timing.historyHead + 1) % timing.history.size();
+      }
+
+      double sum = 0.0;
+      for (const auto& s : timing.history) {
+        sum += s.ms;
+      }
+      timing.avgMs = sum / static_cast<double>(timing.history.size());
+    }
+  }
+
+  void GpuProfiler::beginFrame() {
+    if (!m_enabled) {
+      return;
+    }
+
+    m_current = (m_current + 1) % BUFFERED_FRAMES;
+    auto& frame = m_frames[m_current];
+    resolve(frame, false);
+
+    frame.used = 0;
+    frame.records.clear();
+    frame.last = 0;
+    frame.frame = m_frame++;
+    m_depth = 0;
+    m_inFrame = true;
+  }
+
+  void GpuProfiler::endFrame() {
+    if (!m_inFrame) {
+      return;
+    }
+    m_frames[m_current].pending = true;
+    m_inFrame = false;
+  }
+
+  GpuProfiler::Scope GpuProfiler::scope(std::string_view name, int index) {
+    if (!m_enabled || !m_inFrame) {
+      return Scope(nullptr, 0);
+    }
+
+    auto& frame = m_frames[m_current];
+    Record record{
+        .timing = findTiming(name, index),
+        .depth = m_depth++,
+        .begin = nextQuery(frame),
+        .end = nextQuery(frame),
+    };
+    glQueryCounter(record.begin, GL_TIMESTAMP);
+    frame.records.push_back(record);
+    return Scope(this, frame.records.size() - 1);
+  }
+
+  void GpuProfiler::end(size_t record) {
+    if (!m_inFrame) {
+      return;
+    }
+    auto& frame = m_frames[m_current];
+    frame.last = frame.records[record].end;
+    glQueryCounter(frame.last, GL_TIMESTAMP);
+    m_depth--;
+  }
+
+  void GpuProfiler::flush() {
+    // Oldest first so the history stays in frame order
+    for (size_t i = 1; i <= BUFFERED_FRAMES; i++) {
+      resolve(m_frames[(m_current + i) % BUFFERED_FRAMES], true);
+    }
+  }
+
+  void GpuProfiler::reset() {
+    for (auto& frame : m_frames) {
+      frame.pending = false;
+      frame.records.clear();
+    }
+    m_timings.clear();
+    m_droppedFrames = 0;
+  }
+
+  bool GpuProfiler::dumpCsv(std::string_view path) const {
+    std::ofstream file{std::string(path)};
+    if (!file.is_open()) {
+      gl::Logger::error("Failed to open {} for writing", path);
+      return false;
+    }
+
+    file << "frame,pass,ms\n";
+    for (const auto& timing : m_timings) {
+      const auto& history = timing.history;
+      for (size_t i = 0; i < history.size(); i++) {
+        const auto& sample = history[(timing.historyHead + i) % history.size()];
+        file << sample.frame << ',' << timing.label << ',' << sample.ms
+             << '\n';
+      }
+    }
+
+    gl::Logger::info("Wrote GPU timings to {}", path);
+    return true;
+  }
+} // namespace gl
@@ -0,0 +1,166 @@
+#include "gl/programCache.hpp"
+#include "logger.hpp"
+#include <array>
+#include <fstream>
+#include <string_view>
+#include <system_error>
+
+namespace gl {
+  namespace {
+    // Bumped whenever the file layout changes
+    constexpr uint32_t FILE_VERSION = 1;
+    constexpr std::array<char, 4> MAGIC{'R', 'C', 'P', 'B'};
+
+    struct Header {
+      std::array<char, 4> magic;
+      uint32_t version;
+      uint32_t format;
+      uint32_t length;
+    };
+
+    /// FNV-1a, enough to tell sources apart
+    void hash(uint64_t& state, std::string_view data) {
+      for (char c : data) {
+        state ^= static_cast<unsigned char>(c);
+        state *= 0x100000001b3ull;
+      }
+    }
+
+    std::string_view glString(GLenum name) {
+      auto str = reinterpret_cast<const char*>(glGetString(name));
+      return str == nullptr ? std::string_view{} : std::string_view(str);
+    }
+  } // namespace
+
+  ProgramCache ProgramCache::s_instance;
+  ProgramCache& ProgramCache::get() { return s_instance; }
+
+  uint64_t ProgramCache::driverHash() {
+    if (!m_driverHash.has_value()) {
+      uint64_t state = 0xcbf29ce484222325ull;
+      hash(state, glString(GL_VENDOR));
+      hash(state, glString(GL_RENDERER));
+      hash(state, glString(GL_VERSION));
+      m_driverHash = state;
+    }
+    return *m_driverHash;
+  }
+
+  std::filesystem::path ProgramCache::path(uint64_t key) const {
+    return m_directory / fmt::format("{:016x}.bin", key);
+  }
+
+  bool ProgramCache::supported() {
+    if (!m_supported.has_value()) {
+      GLint formats = 0;
+      glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+      m_supported = formats > 0;
+      if (!*m_supported) {
+        gl::Logger::info("Driver has no program binary formats, not caching");
+      }
+    }
+    return *m_supported;
+  }
+
+  uint64_t ProgramCache::key(std::span<const Source> sources) {
+    uint64_t state = driverHash();
+    for (const auto& [source, type] : sources) {
+      // Type and length first, so moving text between stages changes it
+      hash(state, fmt::format("{}:{}:", static_cast<GLenum>(type),
+                              source.size()));
+      hash(state, source);
+    }
+    return state;
+  }
+
+  std::optional<Program> ProgramCache::load(uint64_t key) {
+    if (!m_enabled || !supported()) {
+      return std::nullopt;
+    }
+
+    auto filePath = path(key);
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+      m_stats.misses++;
+      return std::nullopt;
+    }
+
+    // The length is only trusted if the file holds exactly that much, a
+    // corrupt one could ask for gigabytes
+    std::error_code sizeError;
+    uintmax_t fileSize = std::filesystem::file_size(filePath, sizeError);
+    Header header{};
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    std::vector<std::byte> binary;
+    if (file && !sizeError && header.magic == MAGIC &&
+        header.version == FILE_VERSION &&
+        fileSize - sizeof(header) == header.length) {
+      binary.resize(header.length);
+      file.read(reinterpret_cast<char*>(binary.data()),
+                static_cast<std::streamsize>(binary.size()));
+    }
+    bool complete = file && !binary.empty();
+    file.close();
+
+    auto program = complete ? Program::fromBinary(header.format, binary)
+                            : std::nullopt;
+    if (!program.has_value()) {
+      gl::Logger::warn("Program binary {} was rejected, rebuilding",
+                       filePath.string());
+      m_stats.rejected++;
+      m_stats.misses++;
+      std::error_code error;
+      std::filesystem::remove(filePath, error);
+      return std::nullopt;
+    }
+
+    m_stats.hits++;
+    return program;
+  }
+
+  void ProgramCache::store(uint64_t key, const Program& program) {
+    if (!m_enabled || !supported()) {
+      return;
+    }
+    auto binary = program.binary();
+    if (!binary.has_value()) {
+      return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_directory, error);
+    if (error) {
+      gl::Logger::warn("Failed to create program cache {}: {}",
+                       m_directory.string(), error.message());
+      return;
+    }
+
+    // Written next to it and renamed, so a crash never leaves half a file
+    auto filePath = path(key);
+    auto tempPath = filePath;
+    tempPath += ".tmp";
+    {
+      std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+      Header header{.magic = MAGIC,
+                    .version = FILE_VERSION,
+                    .format = binary->format,
+                    .length = static_cast<uint32_t>(binary->data.size())};
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(binary->data.data()),
+                 static_cast<std::streamsize>(binary->data.size()));
+      if (!file) {
+        gl::Logger::warn("Failed to write program binary {}",
+                         tempPath.string());
+        file.close();
+        std::filesystem::remove(tempPath, error);
+        return;
+      }
+    }
+    std::filesystem::rename(tempPath, filePath, error);
+    if (error) {
+      gl::Logger::warn("Failed to store program binary {}: {}",
+                       filePath.string(), error.message());
+      std::filesystem::remove(tempPath, error);
+    }
+  }
+} // namespace gl
@@ -1,19 +1,26 @@
 #include "logger.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <gl/embeddedShaders.hpp>
+#include <gl/programCache.hpp>
 #include <gl/shaders.hpp>
 
 namespace gl {
-  std::optional<Shader> Shader::fromFile(std::string_view path,
-                                         Shader::Type type) {
+  std::optional<std::string> Shader::readSource(std::string_view path) {
     constexpr std::size_t readSize = 4096;
 
+    if (auto embedded = EmbeddedShaders::find(path); embedded.has_value()) {
+      return std::string(*embedded);
+    }
+
     std::string pathStr("./shaders/");
     pathStr.append(path);
 
     auto absPath = std::filesystem::absolute(pathStr);
 
-    std::ifstream shaderFile(absPath);
+    // Binary, SPIR-V modules are read through here too
+    std::ifstream shaderFile(absPath, std::ios::binary);
 
     if (!shaderFile.is_open()) {
       gl::Logger::error("Failed to open shader file: {}", absPath.string());
@@ -28,13 +35,55 @@ namespace gl {
     source.append(buffer, 0, shaderFile.gcount());
 
     shaderFile.close();
+    return source;
+  }
 
-    Shader shader(type, source);
+  std::optional<Shader> Shader::fromFile(std::string_view path,
+                                         Shader::Type type) {
+    auto source = readSource(path);
+    if (!source.has_value()) {
+      return std::nullopt;
+    }
+
+    Shader shader(type, *source);
     Logger::debug("Compiled shader {}", path);
 
     return shader;
   }
 
+  std::optional<Shader>
+  Shader::fromSpirv(Type type, std::string_view module, std::string_view entry,
+                    std::span<const Specialization> values) {
+    Shader shader(gl::Id(glCreateShader(type)));
+    glShaderBinary(1, shader.m_id, GL_SHADER_BINARY_FORMAT_SPIR_V,
+                   module.data(), static_cast<GLsizei>(module.size()));
+
+    std::vector<GLuint> ids;
+    std::vector<GLuint> constants;
+    ids.reserve(values.size());
+    constants.reserve(values.size());
+    for (const auto& value : values) {
+      ids.push_back(value.id);
+      constants.push_back(value.value);
+    }
+    std::string entryName(entry);
+    glSpecializeShader(shader.m_id, entryName.c_str(),
+                       static_cast<GLuint>(ids.size()), ids.data(),
+                       constants.data());
+
+    GLint success;
+    glGetShaderiv(shader.m_id, GL_COMPILE_STATUS, &success);
+    if (!success) {
+      GLint logLength = 0;
+      glGetShaderiv(shader.m_id, GL_INFO_LOG_LENGTH, &logLength);
+      std::string infoLog(std::max(logLength, 1), '\0');
+      glGetShaderInfoLog(shader.m_id, logLength, nullptr, infoLog.data());
+      gl::Logger::error("Failed to specialize {}: {}", entry, infoLog);
+      return std::nullopt;
+    }
+    return shader;
+  }
+
   Shader::Shader(Type type, std::string_view source) : m_id(gl::Id()) {
     m_id = glCreateShader(type);
     const char* src = source.data();
@@ -65,4 +114,108 @@ namespace gl {
 
     return false;
   }
+
+  std::optional<Program> Program::fromBinary(GLenum format,
+                                             std::span<const std::byte> data) {
+    GLuint id = glCreateProgram();
+    glProgramBinary(id, format, data.data(), static_cast<GLsizei>(data.size()));
+    GLint success;
+    glGetProgramiv(id, GL_LINK_STATUS, &success);
+    if (!success) {
+      glDeleteProgram(id);
+      return std::nullopt;
+    }
+    return Program(gl::Id(id));
+  }
+
+  std::optional<ProgramBinary> Program::binary() const {
+    GLint length = 0;
+    glGetProgramiv(m_id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      return std::nullopt;
+    }
+    ProgramBinary binary{.format = 0,
+                         .data = std::vector<std::byte>(length)};
+    glGetProgramBinary(m_id, length, nullptr, &binary.format,
+                       binary.data.data());
+    return binary;
+  }
+
+  std::expected<Program, std::string> Program::fromFiles(
+      std::initializer_list<std::pair<std::string_view, Shader::Type>>
+          paths) {
+    std::vector<ProgramCache::Source> sources;
+    sources.reserve(paths.size());
+    for (const auto& [path, type] : paths) {
+      auto source = Shader::readSource(path);
+      if (!source.has_value()) {
+        return std::unexpected(std::string("Failed to load shader from ") +
+                               std::string(path));
+      }
+      sources.emplace_back(std::move(*source), type);
+    }
+
+    auto& cache = ProgramCache::get();
+    auto key = cache.key(sources);
+    if (auto cached = cache.load(key); cached.has_value()) {
+      return std::move(cached.value());
+    }
+
+    std::vector<Shader> shaders;
+    shaders.reserve(sources.size());
+    for (const auto& [source, type] : sources) {
+      shaders.emplace_back(type, source);
+    }
+    Logger::debug("Compiled {} shaders for {}", shaders.size(),
+                  paths.begin()->first);
+
+    auto programOpt = create(shaders, cache.enabled());
+    if (!programOpt.has_value()) {
+      return std::unexpected("Failed to link program");
+    }
+    cache.store(key, programOpt.value());
+    return std::move(programOpt.value());
+  }
+
+  std::expected<Program, std::string> Program::fromSpirv(
+      std::string_view module,
+      std::span<const std::pair<std::string_view, Shader::Type>> entries,
+      std::span<const Specialization> values) {
+    // The values are part of the key, each specialization is its own binary
+    std::string specialization;
+    for (const auto& value : values) {
+      specialization += fmt::format("{}={};", value.id, value.value);
+    }
+    std::vector<ProgramCache::Source> sources;
+    sources.reserve(entries.size());
+    for (const auto& [entry, type] : entries) {
+      sources.emplace_back(fmt::format("{}:{}:{}", entry, specialization,
+                                       module),
+                           type);
+    }
+
+    auto& cache = ProgramCache::get();
+    auto key = cache.key(sources);
+    if (auto cached = cache.load(key); cached.has_value()) {
+      return std::move(cached.value());
+    }
+
+    std::vector<Shader> shaders;
+    shaders.reserve(entries.size());
+    for (const auto& [entry, type] : entries) {
+      auto shader = Shader::fromSpirv(type, module, entry, values);
+      if (!shader.has_value()) {
+        return std::unexpected(std::string("Failed to specialize ") +
+                               std::string(entry));
+      }
+      shaders.push_back(std::move(shader.value()));
+    }
+
+    auto programOpt = create(shaders, cache.enabled());
+    if (!programOpt.has_value()) {
+      return std::unexpected("Failed to link specialized program");
+    }
+    cache.store(key, programOpt.value());
+    return std::move(programOpt.value());
+  }
 } // namespace gl
\ No newline at end of file
@@ -0,0 +1,56 @@
+#include "gl/specializedPrograms.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+namespace gl {
+  std::optional<SpecializedPrograms> SpecializedPrograms::fromFile(
+      std::string_view path,
+      std::initializer_list<std::pair<std::string_view, Shader::Type>>
+          entries) {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_SHADER_BINARY_FORMATS, &formats);
+    std::vector<GLint> binaryFormats(std::max(formats, 0));
+    glGetIntegerv(GL_SHADER_BINARY_FORMATS, binaryFormats.data());
+    if (std::ranges::find(binaryFormats, GL_SHADER_BINARY_FORMAT_SPIR_V) ==
+        binaryFormats.end()) {
+      gl::Logger::warn("Driver can't load SPIR-V, not specializing {}", path);
+      return std::nullopt;
+    }
+
+    auto module = Shader::readSource(path);
+    if (!module.has_value()) {
+      return std::nullopt;
+    }
+
+    std::vector<std::pair<std::string, Shader::Type>> entryNames;
+    entryNames.reserve(entries.size());
+    for (const auto& [entry, type] : entries) {
+      entryNames.emplace_back(entry, type);
+    }
+    return SpecializedPrograms(std::move(*module), std::move(entryNames));
+  }
+
+  const Program*
+  SpecializedPrograms::get(std::span<const Specialization> values) {
+    for (const auto& variant : m_variants) {
+      if (std::ranges::equal(variant.values, values)) {
+        return variant.program.has_value() ? &*variant.program : nullptr;
+      }
+    }
+
+    std::vector<std::pair<std::string_view, Shader::Type>> entries(
+        m_entries.begin(), m_entries.end());
+    auto program = Program::fromSpirv(m_module, entries, values);
+    if (!program.has_value()) {
+      gl::Logger::error("Failed to specialize program: {}", program.error());
+    }
+
+    auto& variant = m_variants.emplace_back(Variant{
+        .values = {values.begin(), values.end()},
+        .program = program.has_value()
+                       ? std::optional<Program>(std::move(program.value()))
+                       : std::nullopt,
+    });
+    return variant.program.has_value() ? &*variant.program : nullptr;
+  }
+} // namespace gl
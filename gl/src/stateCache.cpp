@@ -0,0 +1,67 @@
+#include "gl/stateCache.hpp"
+
+namespace gl {
+  StateCache StateCache::s_instance;
+  StateCache& StateCache::get() { return s_instance; }
+
+  void StateCache::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+    bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+    if (m_enabled && (!draw || m_drawFramebuffer == framebuffer) &&
+        (!read || m_readFramebuffer == framebuffer)) {
+      m_frame.elided++;
+      return;
+    }
+    if (draw) {
+      m_drawFramebuffer = framebuffer;
+    }
+    if (read) {
+      m_readFramebuffer = framebuffer;
+    }
+    m_frame.issued++;
+    glBindFramebuffer(target, framebuffer);
+  }
+
+  void StateCache::invalidate() {
+    m_program = UNKNOWN;
+    m_vao = UNKNOWN;
+    m_drawFramebuffer = UNKNOWN;
+    m_readFramebuffer = UNKNOWN;
+    m_textures.fill(UNKNOWN);
+    m_uniformBuffers.fill(BufferBinding{});
+    m_storageBuffers.fill(BufferBinding{});
+  }
+
+  void StateCache::forgetVertexArray(GLuint vao) {
+    if (m_vao == vao) {
+      m_vao = UNKNOWN;
+    }
+  }
+
+  void StateCache::forgetTexture(GLuint texture) {
+    for (auto& bound : m_textures) {
+      if (bound == texture) {
+        bound = UNKNOWN;
+      }
+    }
+  }
+
+  void StateCache::forgetFramebuffer(GLuint framebuffer) {
+    if (m_drawFramebuffer == framebuffer) {
+      m_drawFramebuffer = UNKNOWN;
+    }
+    if (m_readFramebuffer == framebuffer) {
+      m_readFramebuffer = UNKNOWN;
+    }
+  }
+
+  void StateCache::forgetBuffer(GLuint buffer) {
+    for (auto* bindings : {&m_uniformBuffers, &m_storageBuffers}) {
+      for (auto& binding : *bindings) {
+        if (binding.buffer == buffer) {
+          binding = BufferBinding{};
+        }
+      }
+    }
+  }
+} // namespace gl
@@ -0,0 +1,99 @@
+#include "gl/uploadRing.hpp"
+#include "logger.hpp"
+
+namespace gl {
+  UploadRing UploadRing::s_instance;
+  UploadRing& UploadRing::get() { return s_instance; }
+
+  void UploadRing::ensureBuffer() {
+    if (m_buffer.has_value()) {
+      return;
+    }
+
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment > 0) {
+      m_alignment = static_cast<GLuint>(alignment);
+    }
+    m_regionSize = (m_regionSize + m_alignment - 1) / m_alignment * m_alignment;
+
+    m_buffer.emplace(
+        m_regionSize * static_cast<GLuint>(FRAMES_IN_FLIGHT), nullptr,
+        Buffer::UsageBitFlag(Buffer::Usage::WRITE) |
+            Buffer::Usage::PERSISTENT | Buffer::Usage::COHERENT);
+    m_mapping = static_cast<std::byte*>(
+        m_buffer->map(Buffer::Mapping::WRITE | Buffer::Mapping::PERSISTENT |
+                      Buffer::Mapping::COHERENT));
+  }
+
+  void UploadRing::beginFrame() {
+    ensureBuffer();
+    m_region = (m_region + 1) % FRAMES_IN_FLIGHT;
+    m_head = 0;
+
+    GLsync& fence = m_fences[m_region];
+    if (fence == nullptr) {
+      return;
+    }
+
+    GLenum status = glClientWaitSync(fence, 0, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      m_stalls++;
+      // One second at a time, so a lost context can't hang us forever
+      constexpr GLuint64 timeout = 1'000'000'000;
+      do {
+        status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+      } while (status == GL_TIMEOUT_EXPIRED);
+    }
+    if (status == GL_WAIT_FAILED) {
+      gl::Logger::error("Waiting for upload ring region {} failed", m_region);
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+    m_spills[m_region].clear();
+  }
+
+  void UploadRing::endFrame() {
+    if (!m_buffer.has_value()) {
+      return;
+    }
+    m_lastUsed = m_head;
+    GLsync& fence = m_fences[m_region];
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  UploadRing::Allocation UploadRing::allocate(GLuint size) {
+    ensureBuffer();
+    GLuint aligned = (size + m_alignment - 1) / m_alignment * m_alignment;
+
+    if (m_head + aligned > m_regionSize) {
+      if (m_overflows++ == 0) {
+        gl::Logger::warn("Upload ring region of {} bytes overflowed",
+                         m_regionSize);
+      }
+      // Earlier allocations may still be bound, so the region can't be
+      // reused before the frame is over
+      auto& spill = m_spills[m_region].emplace_back(
+          size, nullptr,
+          Buffer::UsageBitFlag(Buffer::Usage::WRITE) |
+              Buffer::Usage::PERSISTENT | Buffer::Usage::COHERENT);
+      void* data =
+          spill.map(Buffer::Mapping::WRITE | Buffer::Mapping::PERSISTENT |
+                    Buffer::Mapping::COHERENT);
+      return Allocation{
+          .buffer = spill.id(), .offset = 0, .size = size, .data = data};
+    }
+
+    Allocation allocation{
+        .buffer = m_buffer->id(),
+        .offset = regionStart() + m_head,
+        .size = size,
+        .data = m_mapping + regionStart() + m_head,
+    };
+    m_head += aligned;
+    return allocation;
+  }
+} // namespace gl
@@ -1,7 +1,7 @@
 #include <gl/vao.hpp>
 
 namespace gl {
-  void gl::Vao::unbind() { glBindVertexArray(0); }
+  void gl::Vao::unbind() { StateCache::get().bindVertexArray(0); }
 
   void gl::Vao::bindVertexBuffer(GLuint index, const gl::Id& bufferId,
                                  GLuint offset, GLuint stride) {
@@ -35,4 +35,8 @@ namespace gl {
       glVertexArrayAttribBinding(m_id, index, bufferIndex);
     }
   }
+
+  void gl::Vao::bindingDivisor(GLuint bufferIndex, GLuint divisor) {
+    glVertexArrayBindingDivisor(m_id, bufferIndex, divisor);
+  }
 } // namespace gl
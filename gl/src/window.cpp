@@ -108,14 +108,13 @@ namespace gl {
   }
   WindowManager::~WindowManager() { glfwTerminate(); }
 
-  int WindowManager::loadGl() {
+  int WindowManager::loadGl(ProcLoader loader) {
     auto& wm = WindowManager::get();
     if (wm.loadedGl) {
       gl::Logger::warn("Attempted to load OpenGL multiple times");
       return -1;
     }
-    int version =
-        gladLoadGLLoader(reinterpret_cast<GLADloadproc>(glfwGetProcAddress));
+    int version = gladLoadGLLoader(loader);
     if (version != 0) {
       wm.loadedGl = true;
       wm.glLoadedVersion = version;
@@ -155,13 +154,16 @@ namespace gl {
     glfwMakeContextCurrent(window);
     auto& wm = WindowManager::get();
     if (!wm.loadedGl) {
-      WindowManager::loadGl();
+      WindowManager::loadGl(
+          reinterpret_cast<WindowManager::ProcLoader>(glfwGetProcAddress));
     }
   }
 
   bool Window::shouldClose() const { return glfwWindowShouldClose(window); }
   void Window::swapBuffers() const { glfwSwapBuffers(window); }
   void Window::pollEvents() { glfwPollEvents(); }
+  void Window::waitEvents() { glfwWaitEvents(); }
+  void Window::releaseCurrent() { glfwMakeContextCurrent(nullptr); }
 
   void Window::setUserPtr(void* ptr) { glfwSetWindowUserPointer(window, ptr); }
   void* Window::getUserPtr(GLFWwindow* window) {
@@ -174,4 +176,10 @@ namespace gl {
     return s;
   }
 
+  Window::Size Window::framebufferSize() const {
+    Size s;
+    glfwGetFramebufferSize(window, &s.width, &s.height);
+    return s;
+  }
+
 } // namespace gl
@@ -0,0 +1,1023 @@
+#include "../drawing.hpp"
+#include "../flatland_rc.hpp"
+#include "../fullscreen.hpp"
+#include "../jfa.hpp"
+#include "../logger.hpp"
+#include "../naive.hpp"
+#include "../textureFormats.hpp"
+#include "scene.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cpu/image.hpp>
+#include <filesystem>
+#include <fstream>
+#include <gl/headless.hpp>
+#include <string>
+
+namespace {
+  // CpuJfa runs the GPU JFA and the CPU version side by side and compares
+  // their distance fields, CpuRc compares cascade 0 against the CPU reference
+  enum class Mode { JFA, Naive, RadianceCascades, CpuJfa, CpuRc };
+
+  std::string_view modeName(Mode mode) {
+    switch (mode) {
+    case Mode::JFA:
+      return "jfa";
+    case Mode::Naive:
+      return "naive";
+    case Mode::RadianceCascades:
+      return "rc";
+    case Mode::CpuJfa:
+      return "cpu-jfa";
+    case Mode::CpuRc:
+      return "cpu-rc";
+    }
+    return "unknown";
+  }
+
+  // Whether the JFA flood passes run as fragment or compute passes
+  enum class JfaPath { Fragment, Compute };
+
+  std::string_view jfaPathName(JfaPath path) {
+    return path == JfaPath::Compute ? "compute" : "fragment";
+  }
+
+  // How the cascades merge with the one above, see FlatlandRc::preAveraged
+  enum class Merge { PerRay, PreAveraged };
+
+  std::string_view mergeName(Merge merge) {
+    return merge == Merge::PreAveraged ? "pre-averaged" : "per-ray";
+  }
+
+  // Whether the raymarching passes draw with the GLSL build reading their
+  // inputs from uniforms, the SPIR-V build specialized for them or the GLSL
+  // variant compiled for them, see ShaderVariants
+  enum class Shaders { Generic, Specialized, Variant };
+
+  std::string_view shadersName(Shaders shaders) {
+    switch (shaders) {
+    case Shaders::Specialized:
+      return "specialized";
+    case Shaders::Variant:
+      return "variant";
+    default:
+      return "generic";
+    }
+  }
+
+  struct Options {
+    uint32_t frames = 100;
+    uint32_t warmup = 10;
+    std::vector<gl::Window::Size> resolutions{{1024, 1024}};
+    std::vector<uint32_t> rayCounts{4};
+    std::vector<uint32_t> maxSteps{32};
+    // 0 runs every pass the resolution needs
+    std::vector<uint32_t> jfaPasses{0};
+    std::vector<JfaPath> jfaPaths{JfaPath::Fragment};
+    std::vector<Merge> merges{Merge::PerRay};
+    std::vector<Shaders> shaders{Shaders::Generic};
+    std::vector<uint32_t> probeSpacings{1};
+    std::vector<Mode> modes{Mode::JFA, Mode::Naive, Mode::RadianceCascades};
+    std::optional<std::string> scenePath;
+    uint32_t seed = 1;
+    // 0 uses every core
+    uint32_t threads = 0;
+    // Only render the CPU reference, without creating a GL context
+    bool offline = false;
+    // Directory to write PFM images of reference runs to
+    std::optional<std::string> imageDir;
+    TextureFormats formats{};
+    // Keep one buffer per cascade instead of ping-ponging between two
+    bool fullCascades = false;
+    // Compile every program instead of loading cached binaries
+    bool programCache = true;
+    // Skip binds that would change nothing
+    bool stateCache = true;
+    std::string output = "bench.json";
+  };
+
+  struct RunConfig {
+    Mode mode;
+    gl::Window::Size size;
+    uint32_t rayCount;
+    uint32_t maxSteps;
+    uint32_t jfaPasses;
+    JfaPath jfaPath = JfaPath::Fragment;
+    Merge merge = Merge::PerRay;
+    uint32_t probeSpacing = 1;
+    Shaders shaders = Shaders::Generic;
+  };
+
+  /// <summary>
+  /// Difference between the CPU and GPU distance fields
+  /// </summary>
+  struct Validation {
+    double maxAbsError = 0.0;
+    double meanAbsError = 0.0;
+    // Share of texels off by more than 1e-3
+    double mismatched = 0.0;
+  };
+
+  struct RunResult {
+    RunConfig config;
+    Stats frame;
+    std::vector<std::pair<std::string, Stats>> passes;
+    std::optional<Validation> validation = std::nullopt;
+    std::optional<cpu::ImageDiff> imageDiff = std::nullopt;
+    // Estimates for the formats used and for all RGBA32F
+    TextureFormats::Footprint footprint{};
+    TextureFormats::Footprint baseline{};
+    uint32_t cascadeBuffers = 0;
+    // Binds per measured frame
+    double issuedBinds = 0.0;
+    double elidedBinds = 0.0;
+  };
+
+  void printUsage() {
+    std::cout
+        << "Usage: RadianceCascadesGLBench [options]\n"
+           "  --frames N            Measured frames per run (default 100)\n"
+           "  --warmup N            Unmeasured frames per run (default 10)\n"
+           "  --resolutions WxH,..  Resolutions to sweep (default 1024x1024)\n"
+           "  --rays N,..           Ray counts to sweep (default 4)\n"
+           "  --steps N,..          Max raymarch steps to sweep (default 32)\n"
+           "  --jfa-passes N,..     JFA pass counts, 0 = all (default 0)\n"
+           "  --jfa-path fragment,compute\n"
+           "                        JFA implementations (default fragment)\n"
+           "  --merge per-ray,pre-averaged\n"
+           "                        Cascade merges (default per-ray)\n"
+           "  --shaders generic,specialized,variant\n"
+           "                        Naive and cascade shader builds, SPIR-V\n"
+           "                        specialized or compiled for the ray count\n"
+           "                        and steps (default generic)\n"
+           "  --probe-spacing N,..  Cascade 0 probe spacings in pixels, 1, 2\n"
+           "                        or 4 (default 1)\n"
+           "  --modes jfa,naive,rc,cpu-jfa,cpu-rc\n"
+           "                        Modes to run (default jfa,naive,rc)\n"
+           "  --scene FILE          Scene to load instead of generating one,\n"
+           "                        a .ppm or a .rcs saved by the app\n"
+           "  --seed N              Seed of the generated scene (default 1)\n"
+           "  --threads N           CPU threads, 0 = all (default 0)\n"
+           "  --offline             Render the CPU reference only, without GL\n"
+           "  --images DIR          Write PFM images of reference runs to DIR\n"
+           "  --full-cascades       Keep every cascade instead of two buffers\n"
+           "  --no-program-cache    Compile programs instead of loading\n"
+           "                        cached binaries\n"
+           "  --no-state-cache      Issue binds that change nothing\n"
+           "  --formats K=V,..      Texture formats, keys scene, seed,\n"
+           "                        distance and cascade, e.g. seed=RG16F\n"
+           "  --output FILE         JSON report path (default bench.json)\n";
+  }
+
+  std::vector<std::string_view> split(std::string_view list) {
+    std::vector<std::string_view> parts;
+    size_t start = 0;
+    while (start <= list.size()) {
+      size_t end = list.find(',', start);
+      if (end == std::string_view::npos) {
+        end = list.size();
+      }
+      if (end > start) {
+        parts.push_back(list.substr(start, end - start));
+      }
+      start = end + 1;
+    }
+    return parts;
+  }
+
+  std::optional<uint32_t> parseUint(std::string_view str) {
+    uint32_t value = 0;
+    auto [ptr, ec] =
+        std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || ptr != str.data() + str.size()) {
+      return std::nullopt;
+    }
+    return value;
+  }
+
+  std::optional<std::vector<uint32_t>> parseUintList(std::string_view list) {
+    std::vector<uint32_t> values;
+    for (auto part : split(list)) {
+      auto value = parseUint(part);
+      if (!value.has_value()) {
+        return std::nullopt;
+      }
+      values.push_back(*value);
+    }
+    if (values.empty()) {
+      return std::nullopt;
+    }
+    return values;
+  }
+
+  std::optional<Options> parseOptions(int argc, char** argv) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+      std::string_view arg = argv[i];
+      if (arg == "--help" || arg == "-h") {
+        printUsage();
+        return std::nullopt;
+      }
+      if (arg == "--offline") {
+        options.offline = true;
+        continue;
+      }
+      if (arg == "--full-cascades") {
+        options.fullCascades = true;
+        continue;
+      }
+      if (arg == "--no-program-cache") {
+        options.programCache = false;
+        continue;
+      }
+      if (arg == "--no-state-cache") {
+        options.stateCache = false;
+        continue;
+      }
+      if (i + 1 >= argc) {
+        Logger::error("Missing value for {}", arg);
+        return std::nullopt;
+      }
+      std::string_view value = argv[++i];
+
+      bool ok = true;
+      if (arg == "--frames" || arg == "--warmup" || arg == "--seed" ||
+          arg == "--threads") {
+        auto parsed = parseUint(value);
+        ok = parsed.has_value();
+        if (ok) {
+          (arg == "--frames"   ? options.frames
+           : arg == "--warmup" ? options.warmup
+           : arg == "--seed"   ? options.seed
+                               : options.threads) = *parsed;
+        }
+      } else if (arg == "--resolutions") {
+        options.resolutions.clear();
+        for (auto part : split(value)) {
+          size_t x = part.find('x');
+          auto width = parseUint(part.substr(0, x));
+          auto height = x == std::string_view::npos
+                            ? std::nullopt
+                            : parseUint(part.substr(x + 1));
+          if (!width || !height || *width == 0 || *height == 0) {
+            ok = false;
+            break;
+          }
+          options.resolutions.push_back(
+              {static_cast<int>(*width), static_cast<int>(*height)});
+        }
+        ok = ok && !options.resolutions.empty();
+      } else if (arg == "--rays" || arg == "--steps" || arg == "--jfa-passes") {
+        auto parsed = parseUintList(value);
+        ok = parsed.has_value();
+        if (ok) {
+          (arg == "--rays"    ? options.rayCounts
+           : arg == "--steps" ? options.maxSteps
+                              : options.jfaPasses) = std::move(*parsed);
+        }
+      } else if (arg == "--jfa-path") {
+        options.jfaPaths.clear();
+        for (auto part : split(value)) {
+          if (part == "fragment") {
+            options.jfaPaths.push_back(JfaPath::Fragment);
+          } else if (part == "compute") {
+            options.jfaPaths.push_back(JfaPath::Compute);
+          } else {
+            ok = false;
+          }
+        }
+        ok = ok && !options.jfaPaths.empty();
+      } else if (arg == "--merge") {
+        options.merges.clear();
+        for (auto part : split(value)) {
+          if (part == "per-ray") {
+            options.merges.push_back(Merge::PerRay);
+          } else if (part == "pre-averaged") {
+            options.merges.push_back(Merge::PreAveraged);
+          } else {
+            ok = false;
+          }
+        }
+        ok = ok && !options.merges.empty();
+      } else if (arg == "--shaders") {
+        options.shaders.clear();
+        for (auto part : split(value)) {
+          if (part == "generic") {
+            options.shaders.push_back(Shaders::Generic);
+          } else if (part == "specialized") {
+            options.shaders.push_back(Shaders::Specialized);
+          } else if (part == "variant") {
+            options.shaders.push_back(Shaders::Variant);
+          } else {
+            ok = false;
+          }
+        }
+        ok = ok && !options.shaders.empty();
+      } else if (arg == "--probe-spacing") {
+        auto parsed = parseUintList(value);
+        ok = parsed.has_value() &&
+             std::ranges::all_of(*parsed, [](uint32_t spacing) {
+               return std::ranges::find(FlatlandRc::PROBE_SPACINGS,
+                                        spacing) !=
+                      FlatlandRc::PROBE_SPACINGS.end();
+             });
+        if (ok) {
+          options.probeSpacings = std::move(*parsed);
+        }
+      } else if (arg == "--modes") {
+        options.modes.clear();
+        for (auto part : split(value)) {
+          if (part == "jfa") {
+            options.modes.push_back(Mode::JFA);
+          } else if (part == "naive") {
+            options.modes.push_back(Mode::Naive);
+          } else if (part == "rc") {
+            options.modes.push_back(Mode::RadianceCascades);
+          } else if (part == "cpu-jfa") {
+            options.modes.push_back(Mode::CpuJfa);
+          } else if (part == "cpu-rc") {
+            options.modes.push_back(Mode::CpuRc);
+          } else {
+            ok = false;
+          }
+        }
+        ok = ok && !options.modes.empty();
+      } else if (arg == "--formats") {
+        auto& formats = options.formats;
+        for (auto part : split(value)) {
+          auto eq = part.find('=');
+          auto key = part.substr(0, eq);
+          auto name = eq == std::string_view::npos ? std::string_view{}
+                                                   : part.substr(eq + 1);
+          if (key == "scene") {
+            auto found = TextureFormats::find<TextureFormats::Scene>(
+                TextureFormats::SCENES, name);
+            ok = ok && found.has_value();
+            formats.scene = found.value_or(formats.scene);
+          } else if (key == "seed") {
+            auto found = TextureFormats::find<TextureFormats::Seed>(
+                TextureFormats::SEEDS, name);
+            ok = ok && found.has_value();
+            formats.seed = found.value_or(formats.seed);
+          } else if (key == "distance") {
+            auto found = TextureFormats::find<TextureFormats::Distance>(
+                TextureFormats::DISTANCES, name);
+            ok = ok && found.has_value();
+            formats.distance = found.value_or(formats.distance);
+          } else if (key == "cascade") {
+            auto found = TextureFormats::find<TextureFormats::Cascade>(
+                TextureFormats::CASCADES, name);
+            ok = ok && found.has_value();
+            formats.cascade = found.value_or(formats.cascade);
+          } else {
+            ok = false;
+          }
+        }
+      } else if (arg == "--scene") {
+        options.scenePath = std::string(value);
+      } else if (arg == "--images") {
+        options.imageDir = std::string(value);
+      } else if (arg == "--output") {
+        options.output = std::string(value);
+      } else {
+        Logger::error("Unknown option {}", arg);
+        printUsage();
+        return std::nullopt;
+      }
+
+      if (!ok) {
+        Logger::error("Invalid value for {}: {}", arg, value);
+        return std::nullopt;
+      }
+    }
+
+    return options;
+  }
+
+  std::vector<RunConfig> expandRuns(const Options& options,
+                                    const gl::Window::Size& size) {
+    std::vector<RunConfig> runs;
+    for (auto mode : options.modes) {
+      for (auto passes : options.jfaPasses) {
+        for (auto path : options.jfaPaths) {
+          if (mode == Mode::JFA || mode == Mode::CpuJfa) {
+            // Ray count and steps do not affect the JFA
+            runs.push_back({mode, size, 0, 0, passes, path});
+            continue;
+          }
+          // Only the cascades merge, the CPU modes have no shaders
+          bool cascades =
+              mode == Mode::RadianceCascades || mode == Mode::CpuRc;
+          bool gpu = mode == Mode::Naive || mode == Mode::RadianceCascades;
+          std::vector<Merge> merges =
+              cascades ? options.merges : std::vector<Merge>{Merge::PerRay};
+          std::vector<uint32_t> spacings =
+              cascades ? options.probeSpacings : std::vector<uint32_t>{1};
+          std::vector<Shaders> shaders =
+              gpu ? options.shaders : std::vector<Shaders>{Shaders::Generic};
+          for (auto rays : options.rayCounts) {
+            for (auto steps : options.maxSteps) {
+              for (auto merge : merges) {
+                for (auto spacing : spacings) {
+                  for (auto build : shaders) {
+                    runs.push_back({mode, size, rays, steps, passes, path,
+                                    merge, spacing, build});
+                  }
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+    return runs;
+  }
+
+  std::string jsonEscape(std::string_view str) {
+    std::string out;
+    out.reserve(str.size());
+    for (char c : str) {
+      if (c == '"' || c == '\\') {
+        out.push_back('\\');
+      }
+      if (static_cast<unsigned char>(c) >= 0x20) {
+        out.push_back(c);
+      }
+    }
+    return out;
+  }
+
+  std::string statsJson(const Stats& stats) {
+    return fmt::format(
+        R"({{"min": {:.4f}, "median": {:.4f}, "p99": {:.4f}, "mean": {:.4f}}})",
+        stats.min, stats.median, stats.p99, stats.mean);
+  }
+
+  std::string glString(GLenum name) {
+    auto str = reinterpret_cast<const char*>(glGetString(name));
+    return str == nullptr ? std::string() : std::string(str);
+  }
+
+  std::string imageDiffJson(const cpu::ImageDiff& diff) {
+    // JSON has no infinity, identical images get a null PSNR
+    return fmt::format(
+        R"({{"rmse": {:.6f}, "maxAbs": {:.6f}, "psnr": {}}})", diff.rmse,
+        diff.maxAbs,
+        std::isinf(diff.psnr) ? "null" : fmt::format("{:.3f}", diff.psnr));
+  }
+
+  bool writeReport(const Options& options,
+                   const std::vector<RunResult>& results) {
+    std::ofstream file(options.output);
+    if (!file.is_open()) {
+      Logger::error("Failed to open {}", options.output);
+      return false;
+    }
+
+    file << "{\n";
+    file << fmt::format(
+        R"(  "gl": {{"vendor": "{}", "renderer": "{}", "version": "{}"}},)",
+        options.offline ? "" : jsonEscape(glString(GL_VENDOR)),
+        options.offline ? "" : jsonEscape(glString(GL_RENDERER)),
+        options.offline ? "" : jsonEscape(glString(GL_VERSION)));
+    file << "\n";
+    file << fmt::format(
+        R"(  "config": {{"frames": {}, "warmup": {}, "scene": "{}", )"
+        R"("seed": {}, "threads": {}, "formats": {{"scene": "{}", )"
+        R"("seed": "{}", "distance": "{}", "cascade": "{}"}}}},)",
+        options.frames, options.warmup,
+        jsonEscape(options.scenePath.value_or("generated")), options.seed,
+        options.threads, options.formats.sceneFormat().name,
+        options.formats.seedFormat().name,
+        options.formats.distanceFormat().name,
+        options.formats.cascadeFormat().name);
+    file << "\n  \"runs\": [\n";
+
+    for (size_t i = 0; i < results.size(); i++) {
+      const auto& result = results[i];
+      const auto& config = result.config;
+      file << fmt::format(
+          R"(    {{"mode": "{}", "width": {}, "height": {}, "rayCount": {}, )"
+          R"("maxSteps": {}, "jfaPasses": {}, "jfaPath": "{}", "merge": "{}", )"
+          R"("probeSpacing": {}, "shaders": "{}", "unit": "ms", "frame": {}, )"
+          R"("passes": {{)",
+          modeName(config.mode), config.size.width, config.size.height,
+          config.rayCount, config.maxSteps, config.jfaPasses,
+          jfaPathName(config.jfaPath), mergeName(config.merge),
+          config.probeSpacing, shadersName(config.shaders),
+          statsJson(result.frame));
+      for (size_t p = 0; p < result.passes.size(); p++) {
+        file << fmt::format(R"({}"{}": {})", p == 0 ? "" : ", ",
+                            jsonEscape(result.passes[p].first),
+                            statsJson(result.passes[p].second));
+      }
+      file << "}";
+      if (result.validation.has_value()) {
+        file << fmt::format(
+            R"(, "validation": {{"maxAbsError": {:.6f}, )"
+            R"("meanAbsError": {:.6f}, "mismatched": {:.6f}}})",
+            result.validation->maxAbsError, result.validation->meanAbsError,
+            result.validation->mismatched);
+      }
+      if (result.imageDiff.has_value()) {
+        file << R"(, "imageDiff": )" << imageDiffJson(*result.imageDiff);
+      }
+      file << fmt::format(
+          R"(, "cascadeBuffers": {}, "vramBytes": {}, )"
+          R"("baselineVramBytes": {}, "trafficBytes": {}, )"
+          R"("baselineTrafficBytes": {}, "binds": {{"issued": {:.1f}, )"
+          R"("elided": {:.1f}}})",
+          result.cascadeBuffers, result.footprint.vramBytes,
+          result.baseline.vramBytes, result.footprint.trafficBytes,
+          result.baseline.trafficBytes, result.issuedBinds,
+          result.elidedBinds);
+      file << (i + 1 == results.size() ? "}\n" : "},\n");
+    }
+
+    file << "  ]\n}\n";
+    Logger::info("Wrote {} runs to {}", results.size(), options.output);
+    return true;
+  }
+
+  struct Pipeline {
+    Drawing drawing;
+    Jfa jfa;
+    NaiveRaymarch naive;
+    FlatlandRc flatland;
+    TexFbo target;
+    // The uploaded scene, input of the CPU JFA
+    SceneRaster scene;
+  };
+
+  std::optional<Pipeline> createPipeline(const gl::Vao& fullscreenVao,
+                                         TexturePool& pool,
+                                         const gl::Window::Size& size,
+                                         const SceneRaster& scene,
+                                         const uint32_t& rayCount,
+                                         const uint32_t& maxSteps,
+                                         const TextureFormats& formats) {
+    auto drawing = Drawing::create(pool, size, formats);
+    auto jfa = Jfa::create(fullscreenVao, pool, size, formats);
+    auto naive =
+        NaiveRaymarch::create(fullscreenVao, pool, rayCount, maxSteps);
+    auto flatland = FlatlandRc::create(fullscreenVao, pool, rayCount,
+                                       maxSteps, size, formats);
+    if (!drawing || !jfa || !naive || !flatland) {
+      Logger::error("Failed to create the render pipeline");
+      return std::nullopt;
+    }
+
+    auto sized = scene.resampled(size);
+    drawing->texture().subImage(0, 0, 0, size.width, size.height, GL_RGBA,
+                                GL_FLOAT, sized.pixels.data());
+
+    // Naive renders into whatever is bound, and there is no default
+    // framebuffer when running surfaceless
+    TexFbo target{};
+    target.tex.storage(1, GL_RGBA8, {size.width, size.height});
+    target.fbo.attachTexture(GL_COLOR_ATTACHMENT0, target.tex);
+
+    return Pipeline{
+        .drawing = std::move(*drawing),
+        .jfa = std::move(*jfa),
+        .naive = std::move(*naive),
+        .flatland = std::move(*flatland),
+        .target = std::move(target),
+        .scene = std::move(sized),
+    };
+  }
+
+  Validation validate(const Jfa& jfa, std::span<const float> cpuDistance,
+                      const gl::Window::Size& size) {
+    // The GPU distance has the same value in rgb, only red is read back
+    std::vector<float> gpuDistance(cpuDistance.size());
+    jfa.distanceResult().tex.getImage(
+        0, GL_RED, GL_FLOAT,
+        static_cast<GLsizei>(gpuDistance.size() * sizeof(float)),
+        gpuDistance.data());
+
+    Validation validation{};
+    size_t mismatched = 0;
+    double sum = 0.0;
+    for (size_t i = 0; i < gpuDistance.size(); i++) {
+      double error = std::abs(static_cast<double>(gpuDistance[i]) -
+                              static_cast<double>(cpuDistance[i]));
+      validation.maxAbsError = std::max(validation.maxAbsError, error);
+      sum += error;
+      mismatched += error > 1e-3 ? 1 : 0;
+    }
+    double texels = static_cast<double>(size.width) * size.height;
+    validation.meanAbsError = sum / texels;
+    validation.mismatched = static_cast<double>(mismatched) / texels;
+    return validation;
+  }
+
+  struct CpuPasses {
+    cpu::JumpFlood jfa;
+    cpu::RadianceCascades rc;
+  };
+
+  double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  }
+
+  void writeImage(const Options& options, const RunConfig& config,
+                  std::string_view source,
+                  std::span<const glm::vec4> pixels) {
+    if (!options.imageDir.has_value()) {
+      return;
+    }
+    // The reference merges per ray at every pixel, the GPU image is named
+    // after the merge and probe spacing it was compared with
+    auto name = fmt::format("{}_{}x{}_r{}_s{}_{}_p{}_{}.pfm",
+                            modeName(config.mode), config.size.width,
+                            config.size.height, config.rayCount,
+                            config.maxSteps, mergeName(config.merge),
+                            config.probeSpacing, source);
+    auto path = (std::filesystem::path(*options.imageDir) / name).string();
+    if (!cpu::writePfm(path, config.size.width, config.size.height, pixels)) {
+      Logger::error("Failed to write {}", path);
+    }
+  }
+
+  /// <summary>
+  /// Renders cascade 0 with the CPU reference from the GPU distance field, so
+  /// only the cascades are compared, and diffs it against the GPU result.
+  /// </summary>
+  void compareReference(Pipeline& pipeline, CpuPasses& cpuPasses,
+                        const RunConfig& config, const Options& options,
+                        RunResult& result) {
+    gl::Window::Size size = config.size;
+    size_t texels =
+        static_cast<size_t>(size.width) * static_cast<size_t>(size.height);
+
+    std::vector<float> distance(texels);
+    pipeline.jfa.distanceResult().tex.getImage(
+        0, GL_RED, GL_FLOAT, static_cast<GLsizei>(texels * sizeof(float)),
+        distance.data());
+    std::vector<glm::vec4> gpuImage(texels);
+    pipeline.flatland.result().tex.getImage(
+        0, GL_RGBA, GL_FLOAT,
+        static_cast<GLsizei>(texels * sizeof(glm::vec4)), gpuImage.data());
+
+    FlatlandRc::FlatlandRcConstants constants{
+        .resolution = {static_cast<float>(size.width),
+                       static_cast<float>(size.height)},
+        .baseRayCount = config.rayCount,
+        .maxSteps = config.maxSteps,
+        .maxCascades = pipeline.flatland.maxCascades(),
+    };
+    auto start = std::chrono::steady_clock::now();
+    auto cpuImage =
+        cpuPasses.rc.render(pipeline.scene.pixels, distance, constants);
+    result.passes.emplace_back("CPU RC", Stats::compute({elapsedMs(start)}));
+
+    result.imageDiff = cpu::ImageDiff::compute(gpuImage, cpuImage);
+    writeImage(options, config, "gpu", gpuImage);
+    writeImage(options, config, "cpu", cpuImage);
+  }
+
+  /// <summary>
+  /// CPU only runs of the reference for hosts without a usable GL. Each
+  /// configuration is rendered once.
+  /// </summary>
+  std::vector<RunResult>
+  runOffline(const Options& options,
+             const std::optional<SceneRaster>& loadedScene,
+             CpuPasses& cpuPasses) {
+    std::vector<RunResult> results;
+
+    for (const auto& size : options.resolutions) {
+      auto scene = loadedScene.has_value()
+                       ? loadedScene->resampled(size)
+                       : SceneRaster::generate(size, options.seed);
+      std::span<const float> sceneFloats{
+          reinterpret_cast<const float*>(scene.pixels.data()),
+          scene.pixels.size() * 4};
+      glm::vec2 fsize{static_cast<float>(size.width),
+                      static_cast<float>(size.height)};
+
+      for (auto passes : options.jfaPasses) {
+        uint32_t maxPasses = cpu::JumpFlood::maxPasses(size.width, size.height);
+        uint32_t jfaPasses =
+            passes == 0 ? maxPasses : std::min(passes, maxPasses);
+
+        auto jfaStart = std::chrono::steady_clock::now();
+        auto distance =
+            cpuPasses.jfa.run(sceneFloats, size.width, size.height, jfaPasses);
+        double jfaMs = elapsedMs(jfaStart);
+
+        for (auto rays : options.rayCounts) {
+          for (auto steps : options.maxSteps) {
+            RunConfig config{Mode::CpuRc, size, rays, steps, jfaPasses};
+            Logger::info("Rendering reference at {}x{} (rays {}, steps {})",
+                         size.width, size.height, rays, steps);
+
+            FlatlandRc::FlatlandRcConstants constants{
+                .resolution = fsize,
+                .baseRayCount = rays,
+                .maxSteps = steps,
+                .maxCascades = FlatlandRc::calcMaxCascades(fsize, rays),
+            };
+            auto rcStart = std::chrono::steady_clock::now();
+            auto image = cpuPasses.rc.render(scene.pixels, distance, constants);
+            double rcMs = elapsedMs(rcStart);
+
+            results.push_back(RunResult{
+                .config = config,
+                .frame = Stats::compute({jfaMs + rcMs}),
+                .passes = {{"CPU JFA", Stats::compute({jfaMs})},
+                           {"CPU RC", Stats::compute({rcMs})}},
+            });
+            writeImage(options, config, "cpu", image);
+          }
+        }
+      }
+    }
+    return results;
+  }
+
+  RunResult run(Pipeline& pipeline, CpuPasses& cpuPasses,
+                const RunConfig& config, const Options& options) {
+    auto& drawing = pipeline.drawing;
+    auto& jfa = pipeline.jfa;
+    auto& naive = pipeline.naive;
+    auto& flatland = pipeline.flatland;
+    auto& target = pipeline.target;
+    gl::Window::Size size = config.size;
+    glm::vec2 fsize{static_cast<float>(size.width),
+                    static_cast<float>(size.height)};
+
+    auto& profiler = gl::GpuProfiler::get();
+    profiler.reset();
+    auto& stateCache = gl::StateCache::get();
+    gl::StateCache::Counters binds{};
+    profiler.setHistorySize(options.frames);
+    uint64_t firstMeasured = profiler.frame() + options.warmup;
+
+    std::vector<double> frameSamples;
+    frameSamples.reserve(options.frames);
+
+    std::span<const float> sceneFloats{
+        reinterpret_cast<const float*>(pipeline.scene.pixels.data()),
+        pipeline.scene.pixels.size() * 4};
+    std::vector<float> cpuDistance(pipeline.scene.pixels.size());
+    // Seed, flood, distance and total
+    std::array<std::vector<double>, 4> cpuSamples{};
+
+    for (uint32_t frame = 0; frame < options.warmup + options.frames;
+         frame++) {
+      auto start = std::chrono::steady_clock::now();
+      profiler.beginFrame();
+      gl::UploadRing::get().beginFrame();
+      stateCache.beginFrame();
+
+      {
+        auto frameTimer = profiler.scope("Frame");
+        jfa.draw(drawing.texture(), size);
+
+        switch (config.mode) {
+        case Mode::JFA:
+          break;
+        case Mode::CpuJfa: {
+          using Clock = std::chrono::steady_clock;
+          auto seeded = Clock::now();
+          cpuPasses.jfa.seed(sceneFloats, size.width, size.height);
+          auto flooded = Clock::now();
+          cpuPasses.jfa.flood(config.jfaPasses);
+          auto measured = Clock::now();
+          cpuPasses.jfa.distance(cpuDistance);
+          auto done = Clock::now();
+
+          if (frame >= options.warmup) {
+            auto ms = [](Clock::time_point from, Clock::time_point to) {
+              return std::chrono::duration<double, std::milli>(to - from)
+                  .count();
+            };
+            cpuSamples[0].push_back(ms(seeded, flooded));
+            cpuSamples[1].push_back(ms(flooded, measured));
+            cpuSamples[2].push_back(ms(measured, done));
+            cpuSamples[3].push_back(ms(seeded, done));
+          }
+          break;
+        }
+        case Mode::Naive: {
+          target.fbo.bind();
+          naive.draw(drawing.texture(), jfa.distanceResult().tex, fsize);
+          gl::Framebuffer::unbind();
+          break;
+        }
+        case Mode::RadianceCascades:
+        case Mode::CpuRc: {
+          flatland.draw(drawing.texture(), jfa.distanceResult().tex,
+                        fsize);
+          break;
+        }
+        }
+      }
+
+      stateCache.endFrame();
+      gl::UploadRing::get().endFrame();
+      profiler.endFrame();
+      glFinish();
+      auto end = std::chrono::steady_clock::now();
+
+      if (frame >= options.warmup) {
+        frameSamples.push_back(
+            std::chrono::duration<double, std::milli>(end - start).count());
+        binds.issued += stateCache.lastFrame().issued;
+        binds.elided += stateCache.lastFrame().elided;
+      }
+    }
+    profiler.flush();
+
+    RunResult result{.config = config,
+                     .frame = Stats::compute(std::move(frameSamples)),
+                     .passes = {}};
+    if (options.frames > 0) {
+      auto frames = static_cast<double>(options.frames);
+      result.issuedBinds = static_cast<double>(binds.issued) / frames;
+      result.elidedBinds = static_cast<double>(binds.elided) / frames;
+    }
+    for (const auto& timing : profiler.timings()) {
+      std::vector<double> samples;
+      samples.reserve(timing.history.size());
+      for (const auto& sample : timing.history) {
+        if (sample.frame >= firstMeasured) {
+          samples.push_back(sample.ms);
+        }
+      }
+      result.passes.emplace_back(timing.label,
+                                 Stats::compute(std::move(samples)));
+    }
+
+    if (config.mode == Mode::CpuJfa) {
+      constexpr std::array<std::string_view, 4> cpuLabels{
+          "CPU seed", "CPU flood", "CPU distance", "CPU total"};
+      for (size_t i = 0; i < cpuLabels.size(); i++) {
+        result.passes.emplace_back(std::string(cpuLabels[i]),
+                                   Stats::compute(std::move(cpuSamples[i])));
+      }
+      result.validation = validate(jfa, cpuDistance, size);
+    }
+    if (config.mode == Mode::CpuRc) {
+      compareReference(pipeline, cpuPasses, config, options, result);
+    }
+    return result;
+  }
+} // namespace
+
+int main(int argc, char** argv) {
+  auto optionsOpt = parseOptions(argc, argv);
+  if (!optionsOpt.has_value()) {
+    return -1;
+  }
+  auto& options = optionsOpt.value();
+
+  std::optional<SceneRaster> loadedScene;
+  if (options.scenePath.has_value()) {
+    loadedScene = SceneRaster::load(*options.scenePath);
+    if (!loadedScene.has_value()) {
+      return -1;
+    }
+  }
+
+  cpu::ThreadPool threadPool(options.threads == 0
+                                 ? cpu::ThreadPool::defaultThreads()
+                                 : options.threads - 1);
+  CpuPasses cpuPasses{
+      .jfa = cpu::JumpFlood(threadPool),
+      .rc = cpu::RadianceCascades(threadPool),
+  };
+
+  if (options.offline) {
+    auto results = runOffline(options, loadedScene, cpuPasses);
+    return writeReport(options, results) ? 0 : -1;
+  }
+
+  auto contextOpt = gl::HeadlessContext::create(4, 6);
+  if (!contextOpt.has_value()) {
+    Logger::error("Failed to create a headless OpenGL context");
+    return -1;
+  }
+  Logger::info("Benchmarking on {} ({})", glString(GL_RENDERER),
+               glString(GL_VERSION));
+
+  gl::ProgramCache::get().enabled() = options.programCache;
+  gl::StateCache::get().enabled() = options.stateCache;
+
+  auto fullscreen = FullscreenTriangle::create();
+  TexturePool texturePool;
+
+  std::vector<RunResult> results;
+
+  for (const auto& size : options.resolutions) {
+    glViewport(0, 0, size.width, size.height);
+    glm::vec2 fsize{static_cast<float>(size.width),
+                    static_cast<float>(size.height)};
+
+    auto scene = loadedScene.has_value()
+                     ? *loadedScene
+                     : SceneRaster::generate(size, options.seed);
+
+    // The passes keep references to these, like the sliders in the app
+    uint32_t rayCount = options.rayCounts.front();
+    uint32_t maxSteps = options.maxSteps.front();
+
+    auto pipelineStart = std::chrono::steady_clock::now();
+    auto cacheHits = gl::ProgramCache::get().stats().hits;
+    auto pipelineOpt =
+        createPipeline(fullscreen.vao, texturePool, size, scene, rayCount,
+                       maxSteps, options.formats);
+    if (!pipelineOpt.has_value()) {
+      return -1;
+    }
+    Logger::info("Created pipeline in {:.1f}ms, {} programs from the cache",
+                 std::chrono::duration<double, std::milli>(
+                     std::chrono::steady_clock::now() - pipelineStart)
+                     .count(),
+                 gl::ProgramCache::get().stats().hits - cacheHits);
+    auto& pipeline = pipelineOpt.value();
+    pipeline.flatland.lean() = !options.fullCascades;
+
+    for (auto config : expandRuns(options, size)) {
+      auto& jfa = pipeline.jfa;
+      jfa.passes() = config.jfaPasses == 0
+                         ? jfa.maxPasses()
+                         : std::min(config.jfaPasses, jfa.maxPasses());
+      config.jfaPasses = jfa.passes();
+      jfa.compute() = config.jfaPath == JfaPath::Compute;
+      pipeline.flatland.preAveraged() = config.merge == Merge::PreAveraged;
+      pipeline.flatland.setProbeSpacing(config.probeSpacing, fsize);
+      if (config.shaders == Shaders::Specialized &&
+          !(pipeline.flatland.canSpecialize() &&
+            pipeline.naive.canSpecialize())) {
+        // Reported as what actually ran
+        Logger::warn("No SPIR-V shaders, running the generic ones instead");
+        config.shaders = Shaders::Generic;
+      }
+      if (config.shaders == Shaders::Variant &&
+          !ShaderVariants::index(config.rayCount, config.maxSteps)) {
+        Logger::warn("No shader variant for {} rays and {} steps, running "
+                     "the generic shaders instead",
+                     config.rayCount, config.maxSteps);
+        config.shaders = Shaders::Generic;
+      }
+      bool specialized = config.shaders == Shaders::Specialized;
+      bool variant = config.shaders == Shaders::Variant;
+      pipeline.flatland.specialized() = specialized;
+      pipeline.naive.specialized() = specialized;
+      pipeline.flatland.variants() = variant;
+      pipeline.naive.variants() = variant;
+
+      if (config.mode != Mode::JFA && config.mode != Mode::CpuJfa) {
+        rayCount = config.rayCount;
+        maxSteps = config.maxSteps;
+        pipeline.flatland.updateMaxCascades(fsize);
+      }
+
+      Logger::info(
+          "Running {} at {}x{} (rays {}, steps {}, jfa passes {}, {} jfa, "
+          "{} merge, probe spacing {}, {} shaders)",
+          modeName(config.mode), size.width, size.height, config.rayCount,
+          config.maxSteps, config.jfaPasses, jfaPathName(config.jfaPath),
+          mergeName(config.merge), config.probeSpacing,
+          shadersName(config.shaders));
+      auto result = run(pipeline, cpuPasses, config, options);
+      // The JFA modes leave the cascades alone
+      bool jfaOnly = config.mode == Mode::JFA || config.mode == Mode::CpuJfa;
+      uint32_t cascades = jfaOnly ? 0 : pipeline.flatland.maxCascades();
+      uint32_t buffers = pipeline.flatland.cascadeBuffers();
+      result.cascadeBuffers = buffers;
+      result.footprint = options.formats.footprint(
+          size, config.jfaPasses, cascades, buffers, config.rayCount,
+          config.maxSteps, config.probeSpacing);
+      result.baseline = TextureFormats{}.footprint(
+          size, config.jfaPasses, cascades, buffers, config.rayCount,
+          config.maxSteps, config.probeSpacing);
+      Logger::info("  frame median {:.3f} ms, p99 {:.3f} ms",
+                   result.frame.median, result.frame.p99);
+      Logger::info("  {:.1f} binds per frame, {:.1f} skipped",
+                   result.issuedBinds, result.elidedBinds);
+      if (result.validation.has_value()) {
+        Logger::info("  CPU vs GPU distance: max error {:.6f}, mean {:.6f}",
+                     result.validation->maxAbsError,
+                     result.validation->meanAbsError);
+      }
+      if (result.imageDiff.has_value()) {
+        Logger::info("  CPU vs GPU cascade 0: rmse {:.6f}, max error {:.6f}",
+                     result.imageDiff->rmse, result.imageDiff->maxAbs);
+      }
+      results.push_back(std::move(result));
+    }
+  }
+
+  return writeReport(options, results) ? 0 : -1;
+}
@@ -0,0 +1,163 @@
+#include "scene.hpp"
+#include "../logger.hpp"
+#include "../sceneFile.hpp"
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+
+namespace {
+  void fillCapsule(SceneRaster& scene, glm::vec2 from, glm::vec2 to,
+                   float radius, const glm::vec4& color) {
+    int minX = std::max(0, static_cast<int>(std::min(from.x, to.x) - radius));
+    int maxX = std::min(scene.size.width - 1,
+                        static_cast<int>(std::max(from.x, to.x) + radius));
+    int minY = std::max(0, static_cast<int>(std::min(from.y, to.y) - radius));
+    int maxY = std::min(scene.size.height - 1,
+                        static_cast<int>(std::max(from.y, to.y) + radius));
+
+    glm::vec2 line = to - from;
+    float lineLengthSq = line.x * line.x + line.y * line.y;
+
+    for (int y = minY; y <= maxY; y++) {
+      for (int x = minX; x <= maxX; x++) {
+        glm::vec2 toStart =
+            glm::vec2(static_cast<float>(x) + 0.5f,
+                      static_cast<float>(y) + 0.5f) -
+            from;
+        float t = lineLengthSq > 0.f
+                      ? (toStart.x * line.x + toStart.y * line.y) / lineLengthSq
+                      : 0.f;
+        t = std::clamp(t, 0.f, 1.f);
+        glm::vec2 closest = toStart - line * t;
+        if (closest.x * closest.x + closest.y * closest.y <= radius * radius) {
+          scene.at(x, y) = color;
+        }
+      }
+    }
+  }
+} // namespace
+
+SceneRaster SceneRaster::generate(const gl::Window::Size& size,
+                                  uint32_t seed) {
+  SceneRaster scene{
+      .size = size,
+      .pixels = std::vector<glm::vec4>(
+          static_cast<size_t>(size.width) * static_cast<size_t>(size.height),
+          glm::vec4(0.f)),
+  };
+
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+  glm::vec2 fsize{static_cast<float>(size.width),
+                  static_cast<float>(size.height)};
+  float shortestSide = std::min(fsize.x, fsize.y);
+
+  constexpr int lights = 12;
+  constexpr int occluders = 16;
+
+  for (int i = 0; i < lights + occluders; i++) {
+    bool isLight = i < lights;
+    glm::vec2 from = glm::vec2(unit(rng), unit(rng)) * fsize;
+    glm::vec2 to = from + (glm::vec2(unit(rng), unit(rng)) - 0.5f) *
+                              (shortestSide * 0.25f);
+    float radius = shortestSide * (0.005f + unit(rng) * 0.02f);
+    glm::vec4 color = isLight ? glm::vec4(unit(rng), unit(rng), unit(rng), 1.f)
+                              : glm::vec4(0.f, 0.f, 0.f, 1.f);
+    fillCapsule(scene, from, to, radius, color);
+  }
+
+  return scene;
+}
+
+std::optional<SceneRaster> SceneRaster::loadPpm(std::string_view path) {
+  std::ifstream file{std::string(path), std::ios::binary};
+  if (!file.is_open()) {
+    Logger::error("Failed to open scene {}", path);
+    return std::nullopt;
+  }
+
+  std::string magic;
+  int width = 0;
+  int height = 0;
+  int maxValue = 0;
+  file >> magic >> width >> height >> maxValue;
+  file.get(); // Single whitespace before the pixel data
+
+  if (magic != "P6" || width <= 0 || height <= 0 || maxValue <= 0 ||
+      maxValue > 255) {
+    Logger::error("Scene {} is not an 8-bit binary PPM", path);
+    return std::nullopt;
+  }
+
+  std::vector<unsigned char> bytes(static_cast<size_t>(width) * height * 3);
+  if (!file.read(reinterpret_cast<char*>(bytes.data()),
+                 static_cast<std::streamsize>(bytes.size()))) {
+    Logger::error("Scene {} is truncated", path);
+    return std::nullopt;
+  }
+
+  SceneRaster scene{
+      .size = {width, height},
+      .pixels = std::vector<glm::vec4>(static_cast<size_t>(width) * height),
+  };
+
+  float scale = 1.f / static_cast<float>(maxValue);
+  for (int y = 0; y < height; y++) {
+    // PPM rows go top to bottom, textures bottom to top
+    const unsigned char* row = &bytes[static_cast<size_t>(height - 1 - y) *
+                                      width * 3];
+    for (int x = 0; x < width; x++) {
+      glm::vec3 rgb{row[x * 3] * scale, row[x * 3 + 1] * scale,
+                    row[x * 3 + 2] * scale};
+      bool empty = rgb.x == 0.f && rgb.y == 0.f && rgb.z == 0.f;
+      scene.at(x, y) = glm::vec4(rgb, empty ? 0.f : 1.f);
+    }
+  }
+
+  return scene;
+}
+
+std::optional<SceneRaster> SceneRaster::loadSceneFile(std::string_view path) {
+  auto file = SceneFile::open(path);
+  if (!file.has_value()) {
+    return std::nullopt;
+  }
+  auto pixels = file->decode();
+  if (!pixels.has_value()) {
+    Logger::error("Scene {} is corrupt", path);
+    return std::nullopt;
+  }
+  Logger::info("Loaded scene {}, {} of {} tiles run-length encoded", path,
+               file->rleTiles(), file->tiles());
+  return SceneRaster{.size = file->size(), .pixels = std::move(*pixels)};
+}
+
+std::optional<SceneRaster> SceneRaster::load(std::string_view path) {
+  return path.ends_with(".rcs") ? loadSceneFile(path) : loadPpm(path);
+}
+
+SceneRaster SceneRaster::resampled(const gl::Window::Size& newSize) const {
+  if (newSize == size) {
+    return *this;
+  }
+
+  SceneRaster scene{
+      .size = newSize,
+      .pixels = std::vector<glm::vec4>(static_cast<size_t>(newSize.width) *
+                                       newSize.height),
+  };
+
+  for (int y = 0; y < newSize.height; y++) {
+    int srcY = static_cast<int>(static_cast<int64_t>(y) * size.height /
+                                newSize.height);
+    for (int x = 0; x < newSize.width; x++) {
+      int srcX = static_cast<int>(static_cast<int64_t>(x) * size.width /
+                                  newSize.width);
+      scene.at(x, y) = at(srcX, srcY);
+    }
+  }
+
+  return scene;
+}
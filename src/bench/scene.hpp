@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <gl/window.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// CPU copy of a scene in the layout of the <c>Drawing</c> canvas: RGBA32F,
+/// rows bottom to top, alpha > 0 marks emitters/occluders.
+/// </summary>
+struct SceneRaster {
+  gl::Window::Size size{};
+  std::vector<glm::vec4> pixels;
+
+  glm::vec4& at(int x, int y) { return pixels[y * size.width + x]; }
+  const glm::vec4& at(int x, int y) const {
+    return pixels[y * size.width + x];
+  }
+
+  /// <summary>
+  /// Procedural scene of coloured lights and black occluders. Shapes are
+  /// placed in normalized coordinates so every resolution sees the same scene.
+  /// </summary>
+  static SceneRaster generate(const gl::Window::Size& size, uint32_t seed);
+
+  /// <summary>
+  /// Loads a binary PPM (P6). Black pixels are treated as empty space.
+  /// </summary>
+  static std::optional<SceneRaster> loadPpm(std::string_view path);
+
+  /// <summary>
+  /// Loads a scene saved by the app, see <c>SceneFile</c>.
+  /// </summary>
+  static std::optional<SceneRaster> loadSceneFile(std::string_view path);
+
+  /// <summary>
+  /// Loads a scene file if <paramref name="path"/> ends in .rcs, a PPM
+  /// otherwise.
+  /// </summary>
+  static std::optional<SceneRaster> load(std::string_view path);
+
+  /// <summary>
+  /// Nearest neighbour resample to another resolution.
+  /// </summary>
+  SceneRaster resampled(const gl::Window::Size& newSize) const;
+};
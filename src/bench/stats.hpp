@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+struct Stats {
+  double min = 0.0;
+  double median = 0.0;
+  double p99 = 0.0;
+  double mean = 0.0;
+
+  static Stats compute(std::vector<double> samples) {
+    if (samples.empty()) {
+      return {};
+    }
+    std::sort(samples.begin(), samples.end());
+
+    auto percentile = [&](double p) {
+      auto rank = static_cast<size_t>(
+          std::ceil(p * static_cast<double>(samples.size())));
+      return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+    };
+
+    double sum = std::accumulate(samples.begin(), samples.end(), 0.0);
+
+    return Stats{
+        .min = samples.front(),
+        .median = percentile(0.5),
+        .p99 = percentile(0.99),
+        .mean = sum / static_cast<double>(samples.size()),
+    };
+  }
+};
@@ -1,100 +1,207 @@
 #pragma once
 
+#include "input.hpp"
+#include "logger.hpp"
+#include "rect.hpp"
+#include "sceneFile.hpp"
+#include "strokeBatch.hpp"
+#include "textureFormats.hpp"
+#include "texturePool.hpp"
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
+#include <utility>
 
 class Drawing {
-  const gl::Vao& m_fullscreenVao;
-  gl::Program m_program;
-  gl::Texture m_texture;
-  gl::Framebuffer m_fbo;
-
-  gl::StorageBuffer m_ubo;
-  void* m_uboMapping;
+  StrokeBatch m_strokes;
+  TexturePool& m_pool;
+  TexturePool::Target m_canvas;
+  GLenum m_format;
 
   float m_brushRadius = 5.f;
   glm::vec3 m_brushColor{1.f, 0.f, 0.f};
 
-  Drawing(const gl::Vao& fullscreenVao, gl::Program&& drawProgram,
-          gl::Texture&& drawTexture, gl::Framebuffer&& drawFbo,
-          gl::StorageBuffer&& ubo, void* uboMapping)
-      : m_fullscreenVao(fullscreenVao), m_program(std::move(drawProgram)),
-        m_texture(std::move(drawTexture)), m_fbo(std::move(drawFbo)),
-        m_ubo(std::move(ubo)), m_uboMapping(uboMapping) {}
+  // Bumped whenever the canvas changes, so later passes can cache on it
+  uint64_t m_version = 1;
+  // Texels changed since the last takeDirty()
+  Rect m_dirty{};
+
+  SceneReadback m_readback{};
+
+  // Where the stroke in progress got to, on the canvas, while the left
+  // button is held
+  std::optional<glm::vec2> m_strokeEnd = std::nullopt;
+
+  Drawing(StrokeBatch&& strokes, TexturePool& pool,
+          TexturePool::Target&& canvas, GLenum format)
+      : m_strokes(std::move(strokes)), m_pool(pool),
+        m_canvas(std::move(canvas)), m_format(format) {}
+
+  gl::Window::Size canvasSize() const {
+    return {m_canvas->tex.size().width, m_canvas->tex.size().height};
+  }
+
+  /// Moves the canvas into a new texture of the current format
+  void recreate(const gl::Window::Size& size) {
+    auto framebufferSize = m_canvas->tex.size();
+    auto canvas = m_pool.acquire({m_format, size});
+
+    m_canvas->fbo.blit(canvas->fbo.id(), 0, 0, framebufferSize.width,
+                       framebufferSize.height, 0, 0, size.width, size.height,
+                       GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    m_canvas = std::move(canvas);
+    m_version++;
+    m_dirty = Rect::full(size);
+  }
 
 public:
-  struct DrawParams {
-    glm::vec2 from;
-    glm::vec2 to;
-    glm::vec4 color;
-    glm::vec2 resolution;
-  };
 
   float& brushRadius() { return m_brushRadius; }
   glm::vec3& brushColor() { return m_brushColor; }
 
-  const gl::Framebuffer& fbo() const { return m_fbo; }
-  const gl::Texture& texture() const { return m_texture; }
-
-  static std::optional<Drawing> create(const gl::Vao& fullscreenVao,
-                                       const gl::Window::Size& size) {
-    auto drawProgramOpt =
-        gl::Program::fromFiles({{"draw_vert.glsl", gl::Shader::VERTEX},
-                                {"draw_frag.glsl", gl::Shader::FRAGMENT}});
-    if (!drawProgramOpt.has_value()) {
-      Logger::error("Failed to load draw program: {}", drawProgramOpt.error());
+  const gl::Framebuffer& fbo() const { return m_canvas->fbo; }
+  const gl::Texture& texture() const { return m_canvas->tex; }
+  uint64_t version() const { return m_version; }
+  /// Key of the canvas texture
+  TexturePool::Key key() const { return {m_format, canvasSize()}; }
+  /// Segments in the last batch drawn
+  size_t lastSegments() const { return m_strokes.lastCount(); }
+
+  /// <summary>
+  /// Returns the bounds of everything drawn since the last call and resets
+  /// them. The whole canvas is dirty after a clear or resize.
+  /// </summary>
+  Rect takeDirty() { return std::exchange(m_dirty, Rect{}); }
+
+  static std::optional<Drawing> create(TexturePool& pool,
+                                       const gl::Window::Size& size,
+                                       const TextureFormats& formats = {}) {
+    auto strokes = StrokeBatch::create();
+    if (!strokes.has_value()) {
       return std::nullopt;
     }
-    auto& drawProgram = drawProgramOpt.value();
-    gl::Texture drawTexture{};
-    drawTexture.storage(1, GL_RGBA32F, {size.width, size.height});
-    gl::Framebuffer drawFbo;
-    drawFbo.attachTexture(GL_COLOR_ATTACHMENT0, drawTexture);
-
-    gl::StorageBuffer drawParamsBuffer(
-        sizeof(DrawParams), nullptr,
-        gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-            gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
-
-    auto drawMapping = drawParamsBuffer.map(gl::Buffer::Mapping::WRITE |
-                                            gl::Buffer::Mapping::PERSISTENT |
-                                            gl::Buffer::Mapping::COHERENT);
-
-    return Drawing(fullscreenVao, std::move(drawProgram),
-                   std::move(drawTexture), std::move(drawFbo),
-                   std::move(drawParamsBuffer), drawMapping);
+    GLenum format = formats.sceneFormat().internalFormat;
+    auto canvas = pool.acquire({format, size});
+
+    return Drawing(std::move(strokes.value()), pool, std::move(canvas),
+                   format);
   }
 
   void resize(const gl::Window::Size& size) {
-    auto framebufferSize = m_texture.size();
     Logger::info("Resizing framebuffer to {}x{}", size.width, size.height);
-    gl::Texture newTexture{};
-    newTexture.storage(1, GL_RGBA32F, {size.width, size.height});
-    gl::Framebuffer newFbo{};
-    newFbo.attachTexture(GL_COLOR_ATTACHMENT0, newTexture);
-
-    m_fbo.blit(newFbo.id(), 0, 0, framebufferSize.width, framebufferSize.height,
-               0, 0, size.width, size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-    m_texture = std::move(newTexture);
-    m_fbo = std::move(newFbo);
+    recreate(size);
+  }
+
+  /// <summary>
+  /// Switches the canvas to the scene format of <paramref name="formats"/>,
+  /// keeping what was drawn.
+  /// </summary>
+  void setFormats(const TextureFormats& formats) {
+    GLenum format = formats.sceneFormat().internalFormat;
+    if (format != m_format) {
+      m_format = format;
+      recreate(canvasSize());
+    }
+  }
+
+  /// <summary>
+  /// Replaces the canvas with <paramref name="scene"/>, scaled to the canvas
+  /// if it was saved at another size.
+  /// </summary>
+  bool load(const SceneFile& scene) {
+    auto size = scene.size();
+    auto canvas = canvasSize();
+    if (size == canvas) {
+      if (!scene.upload(m_canvas->tex)) {
+        return false;
+      }
+    } else {
+      auto loaded = m_pool.acquire({m_format, size});
+      if (!scene.upload(loaded->tex)) {
+        return false;
+      }
+      loaded->fbo.blit(m_canvas->fbo.id(), 0, 0, size.width, size.height, 0, 0,
+                       canvas.width, canvas.height, GL_COLOR_BUFFER_BIT,
+                       GL_LINEAR);
+    }
+    m_version++;
+    m_dirty = Rect::full(canvas);
+    return true;
+  }
+
+  /// <summary>
+  /// Starts saving the canvas to <paramref name="path"/>. Once the GPU has
+  /// copied the canvas out, a later pollSave() has it written on a thread of
+  /// its own and reports when it finished.
+  /// </summary>
+  bool save(std::string path) {
+    return m_readback.start(m_canvas->tex, m_format, std::move(path));
+  }
+  bool saving() const { return m_readback.pending(); }
+
+  /// <summary>
+  /// Finishes a save started earlier if its copy is done, call once a frame.
+  /// Empty while nothing finished, otherwise whether the file was written.
+  /// </summary>
+  std::optional<bool> pollSave(bool wait = false) {
+    return m_readback.poll(wait);
+  }
+
+  void clear(const glm::vec4& color) {
+    glClearNamedFramebufferfv(m_canvas->fbo.id(), GL_COLOR, 0, &color.r);
+    m_version++;
+    m_dirty = Rect::full(canvasSize());
   }
 
+  /// <summary>
+  /// Strokes every cursor position of the frame's input events while the
+  /// left button is held, as one batch.
+  /// </summary>
   void draw(const Input& input, const glm::vec2& fsize) {
-    if (input.mouse().isButtonDown(0)) {
-      DrawParams params{
-          .from = input.mouse().lastPosition(),
-          .to = input.mouse().position,
-          .color = {m_brushColor, m_brushRadius},
-          .resolution = fsize,
-      };
-
-      memcpy(m_uboMapping, &params, sizeof(DrawParams));
-      m_ubo.bindBase(gl::StorageBuffer::Target::UNIFORM, 0);
-      m_fbo.bind();
-      m_program.bind();
-      m_fullscreenVao.bind();
-      glDrawArrays(GL_TRIANGLES, 0, 3);
-      gl::Framebuffer::unbind();
+    // Cursor rows go top to bottom, the canvas's bottom to top
+    auto toCanvas = [&](const glm::vec2& position) {
+      return glm::vec2{position.x, fsize.y - position.y};
+    };
+    glm::vec4 color{m_brushColor, m_brushRadius};
+    auto strokeTo = [&](const glm::vec2& position) {
+      glm::vec2 to = toCanvas(position);
+      m_strokes.add(
+          {.from = m_strokeEnd.value_or(to), .to = to, .color = color});
+      m_strokeEnd = to;
+    };
+
+    for (const auto& event : input.events()) {
+      switch (event.type) {
+      case InputEvent::Type::CursorMove:
+        if (m_strokeEnd.has_value()) {
+          strokeTo(event.position);
+        }
+        break;
+      case InputEvent::Type::MouseButton:
+        if (event.code != GLFW_MOUSE_BUTTON_LEFT) {
+          break;
+        }
+        if (event.action == GLFW_PRESS) {
+          // A dot where the stroke starts
+          m_strokeEnd.reset();
+          strokeTo(event.position);
+        } else if (event.action == GLFW_RELEASE) {
+          m_strokeEnd.reset();
+        }
+        break;
+      case InputEvent::Type::Key:
+        break;
+      }
     }
+    // Released while not drawing, or with the events dropped
+    if (!input.mouse().isButtonDown(GLFW_MOUSE_BUTTON_LEFT)) {
+      m_strokeEnd.reset();
+    }
+    if (m_strokes.empty()) {
+      return;
+    }
+
+    m_version++;
+    auto timer = gl::GpuProfiler::get().scope("Drawing");
+    m_dirty = m_dirty.united(m_strokes.flush(m_canvas->fbo, canvasSize()));
   }
 };
@@ -1,39 +1,263 @@
 #pragma once
 
 #include "flipFlops.hpp"
+#include "rect.hpp"
+#include "shaderVariants.hpp"
+#include "stageCache.hpp"
+#include "textureFormats.hpp"
+#include "texturePool.hpp"
+#include <array>
+#include <cpu/radianceCascades.hpp>
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
 #include <optional>
+#include <span>
 #include <vector>
 
 class FlatlandRc {
+public:
+  struct Programs {
+    gl::Program rc;
+    gl::Program average;
+    gl::Program upsample;
+    // SPIR-V build of rc, empty if it can't be loaded
+    std::optional<gl::SpecializedPrograms> specialized = std::nullopt;
+    // rc compiled for common ray counts and steps
+    ShaderVariants variants{"flatland_rc"};
+  };
+
+  /// constant_id of each specialization constant in flatland_rc.slang
+  enum SpecConstant : GLuint {
+    SPEC_BASE_RAY_COUNT = 0,
+    SPEC_MAX_STEPS = 1,
+    SPEC_CASCADE_COUNT = 2,
+  };
+
+  /// Screen pixels between cascade 0 probes
+  static constexpr std::array<uint32_t, 3> PROBE_SPACINGS{1, 2, 4};
+
+  /// Pool slots of the transient targets
+  struct ScratchSlots {
+    // The two cascade buffers of the lean storage
+    std::array<uint32_t, 2> cascades{0, 1};
+    uint32_t probes = 2;
+    uint32_t averaged = 3;
+
+    bool operator==(const ScratchSlots&) const = default;
+  };
+
+private:
   const gl::Vao& m_fullscreenVao;
 
-  gl::Program m_program;
+  Programs m_programs;
 
-  TexFbo m_result;
+  TexturePool& m_pool;
 
-  gl::StorageBuffer m_constantsUbo;
-  std::vector<gl::StorageBuffer> m_paramsUbo;
+  TexturePool::Target m_result;
 
+  // Transient in the lean mode, where no cascade above 0 is kept between
+  // draws
   FlipFlops m_flipFlops;
+  // Upper cascade averaged per ray group of the one being drawn
+  TexturePool::Target m_averaged;
+  // Cascade 0 before it is upsampled to the screen, if probes are spaced out
+  TexturePool::Target m_probes;
+  // The probes are exclusive while incremental updates are on, since those
+  // only redraw them in part and upsample all of them
+  bool m_probesKept = true;
+
+  ScratchSlots m_slots{};
 
   const uint32_t& m_baseRayCount;
   const uint32_t& m_maxSteps;
 
   uint32_t m_cascadeIndex = 0;
   uint32_t m_maxCascades;
+  GLenum m_format;
+
+  // Keep two cascade buffers and ping-pong between them, as cascade i only
+  // reads cascade i + 1. Only possible while cascade 0 is the one shown
+  bool m_lean = true;
+  bool m_leanStorage = true;
+
+  // Merge each ray group with one sample of the pre-averaged upper cascade
+  // instead of one sample per ray
+  bool m_preAveraged = false;
+
+  // Draw with rc specialized for the current ray count, steps and cascades
+  bool m_specialized = false;
+  // Draw with the compiled variant of rc for the current ray count and
+  // steps, if there is one
+  bool m_variants = true;
 
-  FlatlandRc(const gl::Vao& fullscreenVao, gl::Program&& rcProgram,
-             TexFbo&& result, gl::StorageBuffer&& constantsUbo,
-             std::vector<gl::StorageBuffer>&& paramsUbo, FlipFlops&& flipFlops,
+  // Every cascade is laid out as if the screen was this many times smaller
+  uint32_t m_probeSpacing = 1;
+
+  struct CacheInputs {
+    uint64_t sceneVersion;
+    uint64_t jfaVersion;
+    glm::vec2 resolution;
+    uint32_t rayCount;
+    uint32_t maxSteps;
+    uint32_t maxCascades;
+    bool preAveraged;
+    uint32_t probeSpacing;
+
+    bool operator==(const CacheInputs&) const = default;
+  };
+
+  StageCache<CacheInputs> m_cache{};
+
+  bool m_incremental = true;
+  // Set after an incremental update. Its lower cascades kept the previous
+  // merge from the upper ones outside their region, so the next idle frame
+  // redraws everything
+  bool m_needsRefresh = false;
+
+  /// Texels the rays of a cascade can reach from their probe, plus the probe
+  /// footprint and a texel for filtering
+  float cascadeReach(uint32_t cascade) const {
+    float baseRayCount = static_cast<float>(m_baseRayCount);
+    float sqrtBaseRayCount = std::sqrt(baseRayCount);
+    float index = static_cast<float>(cascade);
+    float intervalStart =
+        cascade == 0 ? 0.f : std::pow(baseRayCount, index - 1.f);
+    float intervalLength = std::pow(baseRayCount, index);
+    return (intervalStart + intervalLength) * (sqrtBaseRayCount / 2.f) +
+           std::pow(sqrtBaseRayCount, index) + 1.f;
+  }
+
+  /// <summary>
+  /// Draws a cascade only for the probes inside <paramref name="region"/>.
+  /// Every direction has its own block of probes in the texture, so the
+  /// region is scissored once per block.
+  /// </summary>
+  void drawRegion(uint32_t cascade, const Rect& region,
+                  const glm::vec2& fsize) {
+    float spacing = std::pow(std::sqrt(static_cast<float>(m_baseRayCount)),
+                             static_cast<float>(cascade));
+    int probesX = static_cast<int>(std::floor(fsize.x / spacing));
+    int probesY = static_cast<int>(std::floor(fsize.y / spacing));
+    if (probesX == 0 || probesY == 0) {
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+      return;
+    }
+
+    // One extra probe on each side for the bilinear merge
+    auto first = [&](int texel, int probes) {
+      return std::clamp(
+          static_cast<int>(std::floor(static_cast<float>(texel) / spacing)) -
+              1,
+          0, probes);
+    };
+    auto last = [&](int texel, int probes) {
+      return std::clamp(
+          static_cast<int>(std::ceil(static_cast<float>(texel) / spacing)) +
+              1,
+          0, probes);
+    };
+    int x0 = first(region.x0, probesX);
+    int x1 = last(region.x1, probesX);
+    int y0 = first(region.y0, probesY);
+    int y1 = last(region.y1, probesY);
+
+    int blocksX = (static_cast<int>(fsize.x) + probesX - 1) / probesX;
+    int blocksY = (static_cast<int>(fsize.y) + probesY - 1) / probesY;
+
+    glEnable(GL_SCISSOR_TEST);
+    for (int by = 0; by < blocksY; by++) {
+      for (int bx = 0; bx < blocksX; bx++) {
+        Rect block{bx * probesX + x0, by * probesY + y0, bx * probesX + x1,
+                   by * probesY + y1};
+        block.scissor();
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+      }
+    }
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  /// <summary>
+  /// Texture every ray group's average fits in. Groups use the probe grid of
+  /// the cascade above, which is sqrt(rayCount) times coarser.
+  /// </summary>
+  static TexturePool::Key averagedKey(GLenum format, const glm::vec2& fsize,
+                                      uint32_t rayCount) {
+    float sqrtRayCount = std::sqrt(static_cast<float>(rayCount));
+    return {format,
+            {static_cast<int>(std::ceil(fsize.x / sqrtRayCount)),
+             static_cast<int>(std::ceil(fsize.y / sqrtRayCount))}};
+  }
+
+  /// <summary>
+  /// Averages cascade <paramref name="cascade"/> + 1, bound to unit 2, for
+  /// the ray groups of <paramref name="cascade"/> and binds the result in
+  /// its place.
+  /// </summary>
+  void average(uint32_t cascade, const glm::vec2& fsize,
+               const gl::Program& rc) {
+    auto timer = gl::GpuProfiler::get().scope("Cascade average",
+                                              static_cast<int>(cascade));
+    m_programs.average.bind();
+    m_averaged->fbo.bind();
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    float sqrtRayCount = std::sqrt(static_cast<float>(m_baseRayCount));
+    glViewport(0, 0, static_cast<GLsizei>(std::ceil(fsize.x / sqrtRayCount)),
+               static_cast<GLsizei>(std::ceil(fsize.y / sqrtRayCount)));
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    m_averaged->tex.bind(2);
+    rc.bind();
+  }
+
+  /// <summary>
+  /// The cascade program, specialized for the current inputs or the
+  /// compiled variant for them if enabled. Either is linked the first time
+  /// the inputs are seen.
+  /// </summary>
+  const gl::Program& rcProgram() {
+    if (!m_specialized || !m_programs.specialized.has_value()) {
+      const gl::Program* variant =
+          m_variants ? m_programs.variants.get(m_baseRayCount, m_maxSteps)
+                     : nullptr;
+      return variant != nullptr ? *variant : m_programs.rc;
+    }
+    std::array<gl::Specialization, 3> values{{
+        {SPEC_BASE_RAY_COUNT, m_baseRayCount},
+        {SPEC_MAX_STEPS, m_maxSteps},
+        {SPEC_CASCADE_COUNT, m_maxCascades},
+    }};
+    const gl::Program* program = m_programs.specialized->get(values);
+    return program != nullptr ? *program : m_programs.rc;
+  }
+
+  /// <summary>
+  /// Reconstructs the screen from the spaced out cascade 0 probes, bound to
+  /// unit 2. Probes are weighted bilinearly, then by how much the scene and
+  /// distance field at their centre agree with the pixel, so light does not
+  /// bleed across the edges of shapes.
+  /// </summary>
+  void upsample(const glm::vec2& fsize) {
+    auto timer = gl::GpuProfiler::get().scope("Cascade upsample");
+    m_programs.upsample.bind();
+    gl::UploadRing::get().bindUniform(
+        FlatlandRcUpsample{.resolution = fsize,
+                           .probeResolution = probeResolution(fsize),
+                           .spacing = static_cast<float>(m_probeSpacing)},
+        0);
+    m_result->fbo.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  FlatlandRc(const gl::Vao& fullscreenVao, Programs&& programs,
+             TexturePool& pool, TexturePool::Target&& result,
              const uint32_t& rayCount, const uint32_t& maxSteps,
-             uint32_t maxCascades)
-      : m_fullscreenVao(fullscreenVao), m_program(std::move(rcProgram)),
-        m_result(std::move(result)), m_constantsUbo(std::move(constantsUbo)),
-        m_paramsUbo(std::move(paramsUbo)), m_flipFlops(std::move(flipFlops)),
-        m_baseRayCount(rayCount), m_maxSteps(maxSteps),
-        m_maxCascades(maxCascades) {}
+             uint32_t maxCascades, GLenum format)
+      : m_fullscreenVao(fullscreenVao), m_programs(std::move(programs)),
+        m_pool(pool), m_result(std::move(result)), m_baseRayCount(rayCount),
+        m_maxSteps(maxSteps), m_maxCascades(maxCascades), m_format(format) {}
 
 public:
   const uint32_t& maxCascades() const { return m_maxCascades; }
@@ -45,54 +269,198 @@ public:
     return static_cast<uint32_t>(cascades);
   }
 
+  /// Size of the cascade 0 probe grid, and the texel size every cascade is
+  /// laid out in
+  glm::vec2 probeResolution(const glm::vec2& fsize) const {
+    float spacing = static_cast<float>(m_probeSpacing);
+    return {std::max(std::floor(fsize.x / spacing), 1.f),
+            std::max(std::floor(fsize.y / spacing), 1.f)};
+  }
+
   void updateMaxCascades(const glm::vec2& fsize) {
-    uint32_t maxCascades = calcMaxCascades(fsize, m_baseRayCount);
+    uint32_t maxCascades =
+        calcMaxCascades(probeResolution(fsize), m_baseRayCount);
     if (m_cascadeIndex >= maxCascades) {
       m_cascadeIndex = maxCascades - 1;
     }
 
-    if (maxCascades > m_maxCascades) {
-      // Add more UBOs
-      for (uint32_t i = m_maxCascades; i < maxCascades; i++) {
-        gl::StorageBuffer ubo(
-            sizeof(FlatlandRcParams), nullptr,
-            gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-                gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
-        ubo.map(gl::Buffer::Mapping::WRITE | gl::Buffer::Mapping::PERSISTENT |
-                gl::Buffer::Mapping::COHERENT);
-        m_paramsUbo.push_back(std::move(ubo));
-      }
-    } else if (maxCascades < m_maxCascades) {
-      // Remove extra UBOs
-      m_paramsUbo.resize(maxCascades);
+    m_maxCascades = maxCascades;
+    allocateCascades(fsize);
+  }
+
+private:
+  /// <summary>
+  /// Recreates the cascade buffers, two in the lean mode and one per cascade
+  /// otherwise. Their contents are gone, so everything is redrawn. The old
+  /// ones go back to the pool first, so they can be picked up again.
+  /// </summary>
+  void allocateCascades(const glm::vec2& fsize) {
+    glm::vec2 resolution = probeResolution(fsize);
+    gl::Window::Size size{static_cast<int>(resolution.x),
+                          static_cast<int>(resolution.y)};
+    m_flipFlops = FlipFlops{};
+    m_averaged.reset();
+    m_probes.reset();
+
+    m_leanStorage = transientCascades();
+    if (m_leanStorage) {
+      m_flipFlops =
+          FlipFlops(m_pool, m_format, size,
+                    std::span(m_slots.cascades).first(cascadeBuffers()));
+    } else {
+      m_flipFlops = FlipFlops(m_pool, m_format, size, cascadeBuffers());
+    }
+    m_averaged = m_pool.transient(
+        averagedKey(m_format, resolution, m_baseRayCount), m_slots.averaged);
+    m_probesKept = probesKept();
+    if (m_probeSpacing > 1) {
+      m_probes = m_probesKept
+                     ? m_pool.acquire({m_format, size})
+                     : m_pool.transient({m_format, size}, m_slots.probes);
     }
+    m_cache.invalidate();
+  }
 
-    m_flipFlops = FlipFlops(
-        GL_RGBA32F, {static_cast<int>(fsize.x), static_cast<int>(fsize.y)},
-        maxCascades);
+  /// Takes back what release() handed to the pool, and switches between the
+  /// lean and full storage if the lean setting or the shown cascade changed,
+  /// or the probes between kept and transient
+  void syncStorage(const glm::vec2& fsize) {
+    if (!m_result) {
+      m_result = m_pool.acquire(
+          {m_format, {static_cast<int>(fsize.x), static_cast<int>(fsize.y)}});
+      m_cache.invalidate();
+    }
+    if (m_flipFlops.empty() || m_leanStorage != transientCascades() ||
+        m_probesKept != probesKept()) {
+      allocateCascades(fsize);
+    }
+  }
 
-    m_maxCascades = maxCascades;
+  /// Buffer cascade <paramref name="cascade"/> (1 and up) is drawn to
+  const TexFbo& cascadeBuffer(uint32_t cascade) const {
+    return m_flipFlops[m_leanStorage ? cascade % 2 : cascade];
   }
 
-  // Constant between iterations
-  struct FlatlandRcConstants {
-    glm::vec2 resolution;
-    uint32_t baseRayCount;
-    uint32_t maxSteps;
-    uint32_t maxCascades;
+public:
+  bool& lean() { return m_lean; }
+  bool& preAveraged() { return m_preAveraged; }
+  bool& specialized() { return m_specialized; }
+  bool& variants() { return m_variants; }
+  /// Whether a compiled variant matches the current ray count and steps
+  bool hasVariant() const {
+    return ShaderVariants::index(m_baseRayCount, m_maxSteps).has_value();
+  }
+  bool canSpecialize() const { return m_programs.specialized.has_value(); }
+  /// Programs specialized so far
+  size_t specializations() const {
+    return canSpecialize() ? m_programs.specialized->size() : 0;
+  }
+  uint32_t probeSpacing() const { return m_probeSpacing; }
+
+  /// <summary>
+  /// Spaces the cascade 0 probes <paramref name="spacing"/> pixels apart,
+  /// which shrinks every cascade by its square. The cascades are recreated.
+  /// </summary>
+  void setProbeSpacing(uint32_t spacing, const glm::vec2& fsize) {
+    if (spacing == m_probeSpacing) {
+      return;
+    }
+    m_probeSpacing = std::max<uint32_t>(spacing, 1);
+    updateMaxCascades(fsize);
+  }
+
+  /// Textures the cascades above 0 are stored in
+  uint32_t cascadeBuffers() const {
+    return m_leanStorage ? std::min<uint32_t>(2, m_maxCascades)
+                         : m_maxCascades;
+  }
+  /// Whether the cascade buffers are transient, in the lean storage
+  bool transientCascades() const { return m_lean && m_cascadeIndex == 0; }
+  /// Whether the spaced out cascade 0 probes outlive the draw, for the
+  /// incremental updates that keep them outside the changed region
+  bool probesKept() const { return m_incremental; }
+
+  /// Key of the result, at the screen size
+  TexturePool::Key resultKey(const glm::vec2& fsize) const {
+    return {m_format,
+            {static_cast<int>(fsize.x), static_cast<int>(fsize.y)}};
+  }
+  /// Key of the cascade buffers and of the spaced out cascade 0 probes
+  TexturePool::Key cascadeKey(const glm::vec2& fsize) const {
+    glm::vec2 resolution = probeResolution(fsize);
+    return {m_format,
+            {static_cast<int>(resolution.x), static_cast<int>(resolution.y)}};
+  }
+  /// Key of the upper cascade averaged per ray group
+  TexturePool::Key averagedKey(const glm::vec2& fsize) const {
+    return averagedKey(m_format, probeResolution(fsize), m_baseRayCount);
+  }
+
+  /// <summary>
+  /// Moves the transient targets to other pool slots. They are recreated,
+  /// so everything is redrawn.
+  /// </summary>
+  void setScratchSlots(const ScratchSlots& slots, const glm::vec2& fsize) {
+    if (slots != m_slots) {
+      m_slots = slots;
+      allocateCascades(fsize);
+    }
+  }
+
+  /// <summary>
+  /// Hands every texture back to the pool while the cascades aren't shown.
+  /// The next update takes them again and redraws everything.
+  /// </summary>
+  void release() {
+    m_result.reset();
+    m_flipFlops = FlipFlops{};
+    m_averaged.reset();
+    m_probes.reset();
+  }
+
+  // Shared with the CPU reference, which takes the same inputs
+  using FlatlandRcConstants = cpu::FlatlandRcConstants;
+  using FlatlandRcParams = cpu::FlatlandRcParams;
+
+  /// GPU only, the CPU reference always merges per ray
+  struct FlatlandRcMerge {
+    uint32_t preAveraged;
   };
 
-  // Per iteration
-  struct FlatlandRcParams {
-    uint32_t currentCascade;
+  struct FlatlandRcUpsample {
+    glm::vec2 resolution;
+    glm::vec2 probeResolution;
+    float spacing;
   };
 
   const uint32_t& cascadeIndex() const { return m_cascadeIndex; }
+  /// Cascade 0, the final image
+  const TexFbo& result() const { return *m_result; }
+
+  StageCache<CacheInputs>& cache() { return m_cache; }
+  bool& incremental() { return m_incremental; }
+
+  /// <summary>
+  /// Switches every cascade to the cascade format of
+  /// <paramref name="formats"/>. They are recreated empty, so the next
+  /// update draws them all.
+  /// </summary>
+  void setFormats(const TextureFormats& formats, const glm::vec2& fsize) {
+    GLenum format = formats.cascadeFormat().internalFormat;
+    if (format == m_format) {
+      return;
+    }
+    m_format = format;
+
+    resize({static_cast<int>(fsize.x), static_cast<int>(fsize.y)});
+  }
 
   static std::optional<FlatlandRc> create(const gl::Vao& fullscreenVao,
+                                          TexturePool& pool,
                                           const uint32_t& rayCount,
                                           const uint32_t& maxSteps,
-                                          const gl::Window::Size& size) {
+                                          const gl::Window::Size& size,
+                                          const TextureFormats& formats = {}) {
 
     glm::vec2 fsize{static_cast<float>(size.width),
                     static_cast<float>(size.height)};
@@ -107,84 +475,190 @@ public:
                     programOpt.error());
       return std::nullopt;
     }
-    auto& program = programOpt.value();
-
-    gl::StorageBuffer constantsUbo(
-        sizeof(FlatlandRcConstants), nullptr,
-        gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-            gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
-    constantsUbo.map(gl::Buffer::Mapping::WRITE |
-                     gl::Buffer::Mapping::PERSISTENT |
-                     gl::Buffer::Mapping::COHERENT);
+    auto averageProgramOpt = gl::Program::fromFiles(
+        {{"flatland_rc_average_vert.glsl", gl::Shader::VERTEX},
+         {"flatland_rc_average_frag.glsl", gl::Shader::FRAGMENT}});
+    if (!averageProgramOpt.has_value()) {
+      Logger::error("Failed to load flatland_rc_average program: {}",
+                    averageProgramOpt.error());
+      return std::nullopt;
+    }
 
-    std::vector<gl::StorageBuffer> paramsUbo;
-    paramsUbo.reserve(maxCascades);
-    for (uint32_t i = 0; i < maxCascades; i++) {
-      gl::StorageBuffer ubo(
-          sizeof(FlatlandRcParams), nullptr,
-          gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-              gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
-      ubo.map(gl::Buffer::Mapping::WRITE | gl::Buffer::Mapping::PERSISTENT |
-              gl::Buffer::Mapping::COHERENT);
-      paramsUbo.push_back(std::move(ubo));
+    auto upsampleProgramOpt = gl::Program::fromFiles(
+        {{"flatland_rc_upsample_vert.glsl", gl::Shader::VERTEX},
+         {"flatland_rc_upsample_frag.glsl", gl::Shader::FRAGMENT}});
+    if (!upsampleProgramOpt.has_value()) {
+      Logger::error("Failed to load flatland_rc_upsample program: {}",
+                    upsampleProgramOpt.error());
+      return std::nullopt;
     }
-    FlipFlops flipFlops(GL_RGBA32F, size, maxCascades);
 
-    gl::Texture resultTex{};
-    resultTex.storage(1, GL_RGBA32F, {size.width, size.height});
-    gl::Framebuffer resultFbo;
-    resultFbo.attachTexture(GL_COLOR_ATTACHMENT0, resultTex);
-    TexFbo result{std::move(resultTex), std::move(resultFbo)};
+    Programs programs{
+        .rc = std::move(programOpt.value()),
+        .average = std::move(averageProgramOpt.value()),
+        .upsample = std::move(upsampleProgramOpt.value()),
+        .specialized = gl::SpecializedPrograms::fromFile(
+            "flatland_rc_specialized.spv",
+            {{"vert", gl::Shader::VERTEX}, {"frag", gl::Shader::FRAGMENT}}),
+    };
+
+    GLenum format = formats.cascadeFormat().internalFormat;
+    FlatlandRc flatland(fullscreenVao, std::move(programs), pool,
+                        pool.acquire({format, size}), rayCount, maxSteps,
+                        maxCascades, format);
+    // Starts out lean, showing cascade 0
+    flatland.allocateCascades(fsize);
+    return flatland;
+  }
 
-    return FlatlandRc(fullscreenVao, std::move(program), std::move(result),
-                      std::move(constantsUbo), std::move(paramsUbo),
-                      std::move(flipFlops), rayCount, maxSteps, maxCascades);
+  /// <summary>
+  /// Resizes the result and every cascade, swapping textures through the
+  /// pool. Everything is redrawn on the next update.
+  /// </summary>
+  void resize(const gl::Window::Size& size) {
+    glm::vec2 fsize{static_cast<float>(size.width),
+                    static_cast<float>(size.height)};
+    m_result.reset();
+    m_result = m_pool.acquire({m_format, size});
+    updateMaxCascades(fsize);
   }
 
-  // TODO: Resize
+  /// <summary>
+  /// Redraws the cascades only if the scene, distance field or ray
+  /// parameters changed since the last call.
+  /// </summary>
+  /// <returns>Whether the cascades were recomputed</returns>
+  /// <param name="changed">Region the JFA recomputed, none if it all
+  /// changed. The scene changes are inside it too</param>
+  bool update(const gl::Texture& sceneTexture, const gl::Texture& jfaTexture,
+              const glm::vec2& fsize, uint64_t sceneVersion,
+              uint64_t jfaVersion,
+              const std::optional<Rect>& changed = std::nullopt) {
+    syncStorage(fsize);
+    auto previous = m_cache.inputs();
+    CacheInputs inputs{.sceneVersion = sceneVersion,
+                       .jfaVersion = jfaVersion,
+                       .resolution = fsize,
+                       .rayCount = m_baseRayCount,
+                       .maxSteps = m_maxSteps,
+                       .maxCascades = m_maxCascades,
+                       .preAveraged = m_preAveraged,
+                       .probeSpacing = m_probeSpacing};
+    if (!m_cache.needsUpdate(inputs)) {
+      if (!m_needsRefresh) {
+        return false;
+      }
+      m_needsRefresh = false;
+      draw(sceneTexture, jfaTexture, fsize);
+      return true;
+    }
+
+    // Only the scene and distance field changed, inside the region. The
+    // region only covers the last JFA update, so none may have been missed
+    bool incremental = m_incremental && changed.has_value() &&
+                       !changed->empty() && previous.has_value() &&
+                       previous->jfaVersion + 1 == jfaVersion &&
+                       previous->resolution == inputs.resolution &&
+                       previous->rayCount == inputs.rayCount &&
+                       previous->maxSteps == inputs.maxSteps &&
+                       previous->maxCascades == inputs.maxCascades &&
+                       previous->preAveraged == inputs.preAveraged &&
+                       previous->probeSpacing == inputs.probeSpacing;
+    draw(sceneTexture, jfaTexture, fsize, incremental ? *changed : Rect{});
+    m_needsRefresh = incremental;
+    return true;
+  }
 
+  /// <param name="changed">If set, cascades whose rays reach less than a
+  /// quarter of the screen are only redrawn around it</param>
   void draw(const gl::Texture& sceneTexture, const gl::Texture& jfaTexture,
-            const glm::vec2& fsize) {
+            const glm::vec2& fsize, const Rect& changed = Rect{}) {
+    syncStorage(fsize);
     m_fullscreenVao.bind();
-    m_program.bind();
+    const gl::Program& rc = rcProgram();
+    rc.bind();
 
     sceneTexture.bind(0);
     jfaTexture.bind(1);
 
-    constexpr glm::vec2 clear(0.0);
-
-    {
-      FlatlandRcConstants params{.resolution = fsize,
-                                 .baseRayCount = m_baseRayCount,
-                                 .maxSteps = m_maxSteps,
-                                 .maxCascades = m_maxCascades};
-      void* constMapping = m_constantsUbo.getMapping();
-      std::memcpy(constMapping, &params, sizeof(FlatlandRcConstants));
+    // The cascades only see the probe grid, as if the screen was smaller
+    glm::vec2 resolution = probeResolution(fsize);
+    gl::Window::Size size{static_cast<int>(resolution.x),
+                          static_cast<int>(resolution.y)};
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glViewport(0, 0, size.width, size.height);
+
+    auto& ring = gl::UploadRing::get();
+    ring.bindUniform(FlatlandRcConstants{.resolution = resolution,
+                                         .baseRayCount = m_baseRayCount,
+                                         .maxSteps = m_maxSteps,
+                                         .maxCascades = m_maxCascades},
+                     0);
+    ring.bindUniform(
+        FlatlandRcMerge{.preAveraged = m_preAveraged ? 1u : 0u}, 2);
+
+    // Every lower cascade uses the reach of the highest one, so the regions
+    // they merge from were redrawn too
+    uint32_t lowerCascades = 0;
+    float lowerReach = 0.f;
+    if (!changed.empty()) {
+      float limit = std::min(resolution.x, resolution.y) / 4.f;
+      while (lowerCascades < m_maxCascades &&
+             cascadeReach(lowerCascades) <= limit) {
+        lowerReach = cascadeReach(lowerCascades);
+        lowerCascades++;
+      }
     }
-    m_constantsUbo.bindBase(gl::StorageBuffer::Target::UNIFORM, 0);
+    Rect lowerRegion =
+        changed.downscaled(static_cast<int>(m_probeSpacing))
+            .expanded(static_cast<int>(std::ceil(lowerReach)))
+            .clamped(size);
 
+    auto& profiler = gl::GpuProfiler::get();
     for (int32_t i = m_maxCascades - 1; i >= 0; --i) {
-      FlatlandRcParams params{.currentCascade = static_cast<uint32_t>(i)};
-      auto mapping = m_paramsUbo[i].getMapping();
-      std::memcpy(mapping, &params, sizeof(FlatlandRcParams));
-      m_paramsUbo[i].bindBase(gl::StorageBuffer::Target::UNIFORM, 1);
+      auto timer = profiler.scope("Cascade", i);
+      ring.bindUniform(
+          FlatlandRcParams{.currentCascade = static_cast<uint32_t>(i)}, 1);
+      if (m_preAveraged && static_cast<uint32_t>(i) + 1 < m_maxCascades) {
+        average(static_cast<uint32_t>(i), resolution, rc);
+      }
 
       if (i >= 1) {
-        m_flipFlops[i].fbo.bind();
-        glDrawArrays(GL_TRIANGLES, 0, 3);
-        m_flipFlops[i].tex.bind(2);
+        cascadeBuffer(static_cast<uint32_t>(i)).fbo.bind();
+      } else if (m_probeSpacing > 1) {
+        m_probes->fbo.bind();
+      } else {
+        m_result->fbo.bind();
+      }
+
+      if (static_cast<uint32_t>(i) < lowerCascades) {
+        drawRegion(static_cast<uint32_t>(i), lowerRegion, resolution);
       } else {
-        m_result.fbo.bind();
         glDrawArrays(GL_TRIANGLES, 0, 3);
       }
+
+      if (i >= 1) {
+        cascadeBuffer(static_cast<uint32_t>(i)).tex.bind(2);
+      }
+    }
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    if (m_probeSpacing > 1) {
+      m_probes->tex.bind(2);
+      upsample(fsize);
     }
     gl::Framebuffer::unbind();
   }
 
   void blitToScreen(const gl::Window::Size& size) {
-    auto& cascadeFbo =
-        m_cascadeIndex == 0 ? m_result.fbo : m_flipFlops[m_cascadeIndex].fbo;
-    cascadeFbo.blit(0, 0, 0, size.width, size.height, 0, 0, size.width,
-                    size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    auto timer = gl::GpuProfiler::get().scope("Cascade blit");
+    // Any other cascade than 0 is shown with the full storage, at the size
+    // of the probe grid
+    const TexFbo& cascade =
+        m_cascadeIndex == 0 ? *m_result : cascadeBuffer(m_cascadeIndex);
+    const auto& source = cascade.tex.size();
+    cascade.fbo.blit(0, 0, 0, source.width, source.height, 0, 0, size.width,
+                     size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
   }
-};
\ No newline at end of file
+};
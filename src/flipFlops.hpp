@@ -1,23 +1,40 @@
 #pragma once
 
+#include "texturePool.hpp"
 #include <gl/gl.hpp>
-
-struct TexFbo {
-  gl::Texture tex;
-  gl::Framebuffer fbo;
-};
+#include <span>
 
 class FlipFlops {
-  std::vector<TexFbo> buffers;
+  std::vector<TexturePool::Target> buffers;
 
 public:
-  FlipFlops(GLenum internalFormat, const gl::Window::Size& size, size_t num) {
-    buffers.resize(num);
+  FlipFlops() = default;
+
+  /// <param name="transient">Share the buffers with other passes, their
+  /// contents then only last until another pass draws</param>
+  FlipFlops(TexturePool& pool, GLenum internalFormat,
+            const gl::Window::Size& size, size_t num, bool transient = false) {
+    buffers.reserve(num);
+    TexturePool::Key key{internalFormat, size};
     for (size_t i = 0; i < num; i++) {
-      buffers[i].tex.storage(1, internalFormat, {size.width, size.height});
-      buffers[i].fbo.attachTexture(GL_COLOR_ATTACHMENT0, buffers[i].tex);
+      buffers.push_back(transient
+                            ? pool.transient(key, static_cast<uint32_t>(i))
+                            : pool.acquire(key));
+    }
+  }
+
+  /// <summary>
+  /// Transient buffers in the given pool <paramref name="slots"/>, one each
+  /// </summary>
+  FlipFlops(TexturePool& pool, GLenum internalFormat,
+            const gl::Window::Size& size, std::span<const uint32_t> slots) {
+    buffers.reserve(slots.size());
+    TexturePool::Key key{internalFormat, size};
+    for (uint32_t slot : slots) {
+      buffers.push_back(pool.transient(key, slot));
     }
   }
 
-  const TexFbo& operator[](size_t index) const { return buffers[index]; }
+  bool empty() const { return buffers.empty(); }
+  const TexFbo& operator[](size_t index) const { return *buffers[index]; }
 };
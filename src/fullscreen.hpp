@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>
+#include <gl/gl.hpp>
+#include <glm/glm.hpp>
+
+struct BasicVertex {
+  glm::vec2 position;
+};
+
+inline const std::array<BasicVertex, 3> fullscreenTriangle = {
+    BasicVertex{.position = {-1.0f, -1.0f}},
+    BasicVertex{.position = {3.0f, -1.0f}},
+    BasicVertex{.position = {-1.0f, 3.0f}},
+};
+
+/// <summary>
+/// Vertex buffer and VAO of the oversized triangle every fullscreen pass draws
+/// </summary>
+struct FullscreenTriangle {
+  gl::BasicBuffer vbo;
+  gl::Vao vao;
+
+  static FullscreenTriangle create() {
+    gl::BasicBuffer vbo(static_cast<GLuint>(fullscreenTriangle.size()) *
+                            sizeof(BasicVertex),
+                        fullscreenTriangle.data());
+    gl::Vao vao;
+    vao.bindVertexBuffer(0, vbo.id(), 0, sizeof(BasicVertex));
+    vao.attribFormat(0, 2, GL_FLOAT, false, 0, 0);
+    return FullscreenTriangle{.vbo = std::move(vbo), .vao = std::move(vao)};
+  }
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "drawing.hpp"
+#include "flatland_rc.hpp"
+#include "jfa.hpp"
+#include "logger.hpp"
+#include <cpu/image.hpp>
+#include <optional>
+
+/// <summary>
+/// Debug aid that runs the JFA and cascades from scratch next to the
+/// incrementally updated ones and reports how far apart they are. Reads
+/// both results back every frame, so it is slow. Its passes have a pool of
+/// their own, so their scratch slots can't overwrite what the checked passes
+/// keep between updates.
+/// </summary>
+class IncrementalCheck {
+  const gl::Vao& m_fullscreenVao;
+  const uint32_t& m_rayCount;
+  const uint32_t& m_maxSteps;
+
+  gl::Window::Size m_size{};
+  TextureFormats m_formats{};
+  // Declared before the passes, which hand their targets back to it
+  TexturePool m_pool;
+  std::optional<Jfa> m_jfa = std::nullopt;
+  std::optional<FlatlandRc> m_flatland = std::nullopt;
+
+public:
+  struct Result {
+    double distanceMaxError = 0.0;
+    std::optional<cpu::ImageDiff> cascades = std::nullopt;
+  };
+
+private:
+  Result m_last{};
+  Result m_worst{};
+
+  template <typename T>
+  static std::vector<T> readBack(const gl::Texture& texture, GLenum format,
+                                 const gl::Window::Size& size) {
+    std::vector<T> pixels(static_cast<size_t>(size.width) *
+                          static_cast<size_t>(size.height));
+    texture.getImage(0, format, GL_FLOAT,
+                     static_cast<GLsizei>(pixels.size() * sizeof(T)),
+                     pixels.data());
+    return pixels;
+  }
+
+public:
+  IncrementalCheck(const gl::Vao& fullscreenVao, const uint32_t& rayCount,
+                   const uint32_t& maxSteps)
+      : m_fullscreenVao(fullscreenVao), m_rayCount(rayCount),
+        m_maxSteps(maxSteps) {}
+
+  const Result& last() const { return m_last; }
+  /// Largest errors seen since the last reset
+  const Result& worst() const { return m_worst; }
+  void reset() { m_worst = {}; }
+
+  /// <summary>
+  /// Recomputes everything from <paramref name="drawing"/> and compares it
+  /// with the current results of <paramref name="jfa"/> and, if given,
+  /// <paramref name="flatland"/>, using the same texture formats.
+  /// </summary>
+  bool compare(const Drawing& drawing, Jfa& jfa, FlatlandRc* flatland,
+               const gl::Window::Size& size, const TextureFormats& formats) {
+    glm::vec2 fsize{static_cast<float>(size.width),
+                    static_cast<float>(size.height)};
+
+    if (!m_jfa.has_value() || m_size != size || m_formats != formats) {
+      // The passes hold references, so they are rebuilt in place
+      m_jfa.reset();
+      m_flatland.reset();
+      auto jfaOpt = Jfa::create(m_fullscreenVao, m_pool, size, formats);
+      auto flatlandOpt = FlatlandRc::create(
+          m_fullscreenVao, m_pool, m_rayCount, m_maxSteps, size, formats);
+      if (!jfaOpt.has_value() || !flatlandOpt.has_value()) {
+        Logger::error("Failed to create the incremental check passes");
+        return false;
+      }
+      m_jfa.emplace(std::move(*jfaOpt));
+      m_flatland.emplace(std::move(*flatlandOpt));
+      m_size = size;
+      m_formats = formats;
+    }
+
+    m_jfa->passes() = jfa.passes();
+    m_jfa->draw(drawing.texture(), size);
+
+    auto expected =
+        readBack<float>(m_jfa->distanceResult().tex, GL_RED, size);
+    auto actual = readBack<float>(jfa.distanceResult().tex, GL_RED, size);
+    m_last = Result{};
+    for (size_t i = 0; i < expected.size(); i++) {
+      m_last.distanceMaxError =
+          std::max(m_last.distanceMaxError,
+                   static_cast<double>(std::abs(expected[i] - actual[i])));
+    }
+
+    if (flatland != nullptr) {
+      m_flatland->preAveraged() = flatland->preAveraged();
+      m_flatland->setProbeSpacing(flatland->probeSpacing(), fsize);
+      if (m_flatland->maxCascades() != flatland->maxCascades()) {
+        m_flatland->updateMaxCascades(fsize);
+      }
+      m_flatland->draw(drawing.texture(), m_jfa->distanceResult().tex,
+                       fsize);
+      auto expectedImage =
+          readBack<glm::vec4>(m_flatland->result().tex, GL_RGBA, size);
+      auto actualImage =
+          readBack<glm::vec4>(flatland->result().tex, GL_RGBA, size);
+      m_last.cascades = cpu::ImageDiff::compute(expectedImage, actualImage);
+    }
+
+    m_worst.distanceMaxError =
+        std::max(m_worst.distanceMaxError, m_last.distanceMaxError);
+    if (m_last.cascades.has_value() &&
+        (!m_worst.cascades.has_value() ||
+         m_last.cascades->rmse > m_worst.cascades->rmse)) {
+      m_worst.cascades = m_last.cascades;
+    }
+    return true;
+  }
+};
@@ -4,7 +4,7 @@
 void Input::glfwKeyCallback(GLFWwindow* window, int key, int scancode,
                             int action, int mods) {
   Input* input = reinterpret_cast<Input*>(gl::Window::getUserPtr(window));
-  input->onKeyEvent(key, action);
+  input->onKeyEvent(key, action, glfwGetTime());
 
   (void)scancode;
   (void)mods;
@@ -13,27 +13,38 @@ void Input::glfwKeyCallback(GLFWwindow* window, int key, int scancode,
 void Input::glfwCursorPosCallback(GLFWwindow* window, double xpos,
                                   double ypos) {
   Input* input = reinterpret_cast<Input*>(gl::Window::getUserPtr(window));
-  input->onMouseMove(xpos, ypos);
+  input->onMouseMove(xpos, ypos, glfwGetTime());
 }
 
 void Input::glfwMouseButtonCallback(GLFWwindow* window, int button, int action,
                                     int mods) {
   Input* input = reinterpret_cast<Input*>(gl::Window::getUserPtr(window));
   (void)mods;
-  input->onMouseButton(button, action);
+  input->onMouseButton(button, action, glfwGetTime());
 }
 
-void Input::onKeyEvent(int key, int action) {
+void Input::onKeyEvent(int key, int action, double time) {
   if (m_imguiWantsKeyboard && action != GLFW_RELEASE) {
     return;
   }
+  if (!validKey(key)) {
+    return;
+  }
   KeyState state = action == GLFW_PRESS    ? KeyState::Pressed
                    : action == GLFW_REPEAT ? KeyState::PressedRepeat
                                            : KeyState::Released;
-  keyState[key] = state;
+  m_keys[key] = state;
+  if (state == KeyState::Released) {
+    m_released.set(key);
+  }
+  m_events.push({.type = InputEvent::Type::Key,
+                 .code = key,
+                 .action = action,
+                 .position = m_mouse.position,
+                 .time = time});
   Logger::debug("Key {} is now {}", key, state);
 }
-void Input::onMouseMove(double x, double y) {
+void Input::onMouseMove(double x, double y, double time) {
   if (m_imguiWantsMouse) {
     // If ImGui wants the mouse, don't update delta (still want position for
     // accurate tracking)
@@ -42,9 +53,12 @@ void Input::onMouseMove(double x, double y) {
   }
   m_mouse.delta += glm::vec2{x - m_mouse.position.x, y - m_mouse.position.y};
   m_mouse.position = {x, y};
+  m_events.push({.type = InputEvent::Type::CursorMove,
+                 .position = m_mouse.position,
+                 .time = time});
 }
 
-void Input::onMouseButton(int button, int action) {
+void Input::onMouseButton(int button, int action, double time) {
   if (m_imguiWantsMouse && action != GLFW_RELEASE) {
     return;
   }
@@ -59,23 +73,23 @@ void Input::onMouseButton(int button, int action) {
     m_mouse.onRelease(button);
     break;
   }
+  m_events.push({.type = InputEvent::Type::MouseButton,
+                 .code = button,
+                 .action = action,
+                 .position = m_mouse.position,
+                 .time = time});
 }
 
 void Input::frameEnd() {
   m_mouse.delta = {0, 0};
-  std::vector<int> keys;
-  keys.reserve(keyState.size());
-  for (auto [key, state] : keyState) {
+  m_events.endFrame();
+  // A flat pass over every key, cheaper than tracking which ones changed
+  for (auto& state : m_keys) {
     if (state == KeyState::Pressed) {
       state = KeyState::PressedRepeat;
-    } else if (state == KeyState::Released) {
-      keys.push_back(key);
     }
   }
-
-  for (auto& key : keys) {
-    keyState.erase(key);
-  }
+  m_released.reset();
 }
 
 auto fmt::formatter<KeyState>::format(KeyState ks, format_context& ctx) const
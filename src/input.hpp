@@ -1,9 +1,11 @@
 #pragma once
 
-#include <gl/window.hpp>
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <gl/gl.hpp>
 #include <glm/glm.hpp>
 #include <spdlog/fmt/bundled/format.h>
-#include <unordered_map>
 
 struct Mouse {
   glm::vec2 position{};
@@ -18,16 +20,98 @@ struct Mouse {
 
 enum class KeyState { Pressed, PressedRepeat, Released };
 
+struct InputEvent {
+  enum class Type : uint8_t { CursorMove, MouseButton, Key };
+
+  Type type = Type::CursorMove;
+  // GLFW key or mouse button, unused by cursor moves
+  int code = 0;
+  // GLFW_PRESS, GLFW_REPEAT or GLFW_RELEASE, unused by cursor moves
+  int action = 0;
+  // Cursor position when the event came in, in window pixels
+  glm::vec2 position{};
+  // Seconds since GLFW was initialized
+  double time = 0.0;
+};
+
+/// <summary>
+/// Fixed-capacity ring of the latest input events. The events of the
+/// current frame are those pushed since the last endFrame(); if a frame
+/// produces more than the ring holds, its oldest ones are dropped.
+/// </summary>
+class InputEventRing {
+public:
+  static constexpr size_t CAPACITY = 256;
+
+private:
+  std::array<InputEvent, CAPACITY> m_events{};
+  // Events pushed so far, the next one goes to m_head % CAPACITY
+  uint64_t m_head = 0;
+  uint64_t m_frameStart = 0;
+  uint64_t m_dropped = 0;
+
+public:
+  class Iterator {
+    const InputEventRing* m_ring;
+    uint64_t m_index;
+
+  public:
+    Iterator(const InputEventRing* ring, uint64_t index)
+        : m_ring(ring), m_index(index) {}
+
+    const InputEvent& operator*() const {
+      return m_ring->m_events[m_index % CAPACITY];
+    }
+    const InputEvent* operator->() const { return &**this; }
+    Iterator& operator++() {
+      m_index++;
+      return *this;
+    }
+    bool operator==(const Iterator&) const = default;
+  };
+
+  void push(const InputEvent& event) {
+    m_events[m_head % CAPACITY] = event;
+    m_head++;
+    if (m_head - m_frameStart > CAPACITY) {
+      m_frameStart++;
+      m_dropped++;
+    }
+  }
+  void endFrame() { m_frameStart = m_head; }
+
+  size_t size() const { return static_cast<size_t>(m_head - m_frameStart); }
+  bool empty() const { return m_head == m_frameStart; }
+  /// Events dropped because a frame overflowed the ring
+  uint64_t dropped() const { return m_dropped; }
+
+  Iterator begin() const { return {this, m_frameStart}; }
+  Iterator end() const { return {this, m_head}; }
+};
+
 class Input {
+public:
+  // Every GLFW key code fits, GLFW_KEY_UNKNOWN is ignored
+  static constexpr size_t KEY_COUNT = GLFW_KEY_LAST + 1;
+
+private:
   gl::Window& m_window;
   Mouse m_mouse{};
-  std::unordered_map<int, KeyState> keyState{};
+  InputEventRing m_events{};
+  std::array<KeyState, KEY_COUNT> m_keys{};
+  // Keys released during this frame, still reported by isKeyReleased()
+  std::bitset<KEY_COUNT> m_released{};
 
   bool m_imguiWantsKeyboard = false;
   bool m_imguiWantsMouse = false;
 
+  static bool validKey(int key) {
+    return key >= 0 && static_cast<size_t>(key) < KEY_COUNT;
+  }
+
 public:
   Input(gl::Window& window) noexcept : m_window(window) {
+    m_keys.fill(KeyState::Released);
     setupWindowCallbacks();
   }
   ~Input() = default;
@@ -36,12 +120,14 @@ public:
   Input& operator=(const Input&) = delete;
 
   Input(Input&& other) noexcept : m_window(other.m_window) {
+    m_keys.fill(KeyState::Released);
     m_window.setUserPtr(this);
   }
 
-  void onKeyEvent(int key, int action);
-  void onMouseMove(double x, double y);
-  void onMouseButton(int button, int action);
+  // time is when the event arrived, in glfwGetTime() seconds
+  void onKeyEvent(int key, int action, double time);
+  void onMouseMove(double x, double y, double time);
+  void onMouseButton(int button, int action, double time);
 
   void imGuiWantsKeyboard(bool wants) { m_imguiWantsKeyboard = wants; }
   void imGuiWantsMouse(bool wants) { m_imguiWantsMouse = wants; }
@@ -61,8 +147,7 @@ public:
   }
 
   KeyState getKeyState(int key) const {
-    auto it = keyState.find(key);
-    return it == keyState.end() ? KeyState::Released : it->second;
+    return validKey(key) ? m_keys[key] : KeyState::Released;
   }
   /// <summary>
   /// Returns if the key is currently held down (Pressed or PressedRepeat)
@@ -70,9 +155,8 @@ public:
   /// <param name="key"></param>
   /// <returns></returns>
   bool isKeyDown(int key) const {
-    auto it = keyState.find(key);
-    return it != keyState.end() && (it->second == KeyState::Pressed ||
-                                    it->second == KeyState::PressedRepeat);
+    auto state = getKeyState(key);
+    return state == KeyState::Pressed || state == KeyState::PressedRepeat;
   }
   /// <summary>
   /// Returns if the key is currently up (not pressed)
@@ -80,8 +164,7 @@ public:
   /// <param name="key"></param>
   /// <returns></returns>
   bool isKeyUp(int key) const {
-    auto it = keyState.find(key);
-    return it == keyState.end() || it->second == KeyState::Released;
+    return getKeyState(key) == KeyState::Released;
   }
   /// <summary>
   /// Returns if the key was pressed this frame (not held)
@@ -89,22 +172,23 @@ public:
   /// <param name="key"></param>
   /// <returns></returns>
   bool isKeyPressed(int key) const {
-    auto it = keyState.find(key);
-    return it != keyState.end() && it->second == KeyState::Pressed;
+    return getKeyState(key) == KeyState::Pressed;
   }
   /// <summary>
   /// Returns if the key was released this frame
   /// </summary>
   /// <param name="key"></param>
   /// <returns></returns>
-  bool isKeyReleased(int key) const {
-    auto it = keyState.find(key);
-    return it != keyState.end() && it->second == KeyState::Released;
-  }
+  bool isKeyReleased(int key) const { return validKey(key) && m_released[key]; }
 
   void frameEnd();
 
   const Mouse& mouse() const { return m_mouse; }
+  /// <summary>
+  /// Every cursor, button and key event of this frame, oldest first, that
+  /// ImGui did not take.
+  /// </summary>
+  const InputEventRing& events() const { return m_events; }
 };
 
 template <> struct fmt::formatter<KeyState> : formatter<string_view> {
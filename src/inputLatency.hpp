@@ -0,0 +1,64 @@
+#pragma once
+
+#include "input.hpp"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+/// <summary>
+/// Time from input events arriving to the swap of the frame that shows
+/// them, over the last frames that had any. Event times are taken in the
+/// GLFW callbacks, on whichever thread receives them.
+/// </summary>
+class InputLatency {
+public:
+  static constexpr size_t WINDOW = 240;
+
+private:
+  // Mean latency of each frame's events, in ms
+  std::array<double, WINDOW> m_frames{};
+  size_t m_count = 0;
+  size_t m_next = 0;
+
+public:
+  /// <summary>
+  /// Records the events of a frame swapped at <paramref name="swapTime"/>,
+  /// in glfwGetTime() seconds.
+  /// </summary>
+  void record(const InputEventRing& events, double swapTime) {
+    if (events.empty()) {
+      return;
+    }
+    double sum = 0.0;
+    for (const auto& event : events) {
+      sum += swapTime - event.time;
+    }
+    m_frames[m_next] = sum / static_cast<double>(events.size()) * 1000.0;
+    m_next = (m_next + 1) % WINDOW;
+    m_count = std::min(m_count + 1, WINDOW);
+  }
+
+  size_t frames() const { return m_count; }
+
+  double meanMs() const {
+    if (m_count == 0) {
+      return 0.0;
+    }
+    double sum = 0.0;
+    for (size_t i = 0; i < m_count; i++) {
+      sum += m_frames[i];
+    }
+    return sum / static_cast<double>(m_count);
+  }
+
+  double p95Ms() const {
+    if (m_count == 0) {
+      return 0.0;
+    }
+    auto sorted = m_frames;
+    auto end = sorted.begin() + static_cast<std::ptrdiff_t>(m_count);
+    auto p95 = sorted.begin() + static_cast<std::ptrdiff_t>(m_count * 95 / 100);
+    std::nth_element(sorted.begin(), p95, end);
+    return *p95;
+  }
+};
@@ -2,10 +2,10 @@
 #include "logger.hpp"
 
 std::optional<Jfa> Jfa::create(const gl::Vao& fullscreenVao,
-                               const gl::Window& window) {
+                               TexturePool& pool,
+                               const gl::Window::Size& size,
+                               const TextureFormats& formats) {
   {
-    auto size = window.size();
-
     auto toUvProgramOpt =
         gl::Program::fromFiles({{"toUv_vert.glsl", gl::Shader::VERTEX},
                                 {"toUv_frag.glsl", gl::Shader::FRAGMENT}});
@@ -34,53 +34,51 @@ std::optional<Jfa> Jfa::create(const gl::Vao& fullscreenVao,
     }
     auto& distanceProgram = distanceProgramOpt.value();
 
+    auto jumpFloodStepProgramOpt = gl::Program::fromFiles(
+        {{"jumpflood_step_comp.glsl", gl::Shader::COMPUTE}});
+    if (!jumpFloodStepProgramOpt.has_value()) {
+      Logger::error("Failed to load jumpflood step program: {}",
+                    jumpFloodStepProgramOpt.error());
+      return std::nullopt;
+    }
+    auto& jumpFloodStepProgram = jumpFloodStepProgramOpt.value();
+
+    auto jumpFloodFusedProgramOpt = gl::Program::fromFiles(
+        {{"jumpflood_fused_comp.glsl", gl::Shader::COMPUTE}});
+    if (!jumpFloodFusedProgramOpt.has_value()) {
+      Logger::error("Failed to load jumpflood fused program: {}",
+                    jumpFloodFusedProgramOpt.error());
+      return std::nullopt;
+    }
+    auto& jumpFloodFusedProgram = jumpFloodFusedProgramOpt.value();
+
+    auto reachOpt = MaxReduction::create();
+    if (!reachOpt.has_value()) {
+      return std::nullopt;
+    }
+
     uint32_t jfaPasses =
         static_cast<uint32_t>(ceil(log2(std::max(size.width, size.height))));
     uint32_t maxJfaPasses = jfaPasses;
 
-    std::vector<gl::StorageBuffer> ubos;
-    ubos.reserve(jfaPasses);
-    for (uint32_t i = 0; i < jfaPasses; i++) {
-      gl::StorageBuffer ubo(
-          sizeof(JfaParams), nullptr,
-          gl::Buffer::UsageBitFlag(gl::Buffer::Usage::DYNAMIC) |
-              gl::Buffer::Usage::WRITE | gl::Buffer::Usage::PERSISTENT |
-              gl::Buffer::Usage::COHERENT);
-      ubo.map(gl::Buffer::Mapping::WRITE | gl::Buffer::Mapping::PERSISTENT |
-              gl::Buffer::Mapping::COHERENT);
-      ubos.push_back(std::move(ubo));
-    }
-
     Programs programs{
         .toUv = std::move(toUvProgram),
         .jumpFlood = std::move(jumpFloodProgram),
         .distance = std::move(distanceProgram),
+        .jumpFloodStep = std::move(jumpFloodStepProgram),
+        .jumpFloodFused = std::move(jumpFloodFusedProgram),
     };
 
-    gl::Texture jfaResult{};
-    jfaResult.storage(1, GL_RGBA32F, {size.width, size.height});
-    gl::Framebuffer jfaResultFbo;
-    jfaResultFbo.attachTexture(GL_COLOR_ATTACHMENT0, jfaResult);
-
-    JfaResult result{
-        .texture = std::move(jfaResult),
-        .fbo = std::move(jfaResultFbo),
-    };
-
-    gl::Texture distanceResult{};
-    distanceResult.storage(1, GL_RGBA32F, {size.width, size.height});
-    gl::Framebuffer distanceResultFbo;
-    distanceResultFbo.attachTexture(GL_COLOR_ATTACHMENT0, distanceResult);
-
-    DistanceResult distanceRes{
-        .texture = std::move(distanceResult),
-        .fbo = std::move(distanceResultFbo),
-    };
+    GLenum seedFormat = formats.seedFormat().internalFormat;
+    GLenum distanceFormat = formats.distanceFormat().internalFormat;
 
-    FlipFlops flipFlops(GL_RGBA32F, size, 2);
+    FlipFlops flipFlops(pool, seedFormat, size, 2, true);
+    auto result = pool.acquire({seedFormat, size});
+    auto distanceResult = pool.acquire({distanceFormat, size});
 
-    return Jfa(fullscreenVao, std::move(programs), std::move(flipFlops),
-               std::move(ubos), std::move(result), std::move(distanceRes),
-               jfaPasses, maxJfaPasses, window);
+    return Jfa(fullscreenVao, std::move(programs), std::move(*reachOpt), pool,
+               std::move(flipFlops), std::move(result),
+               std::move(distanceResult), jfaPasses, maxJfaPasses, seedFormat,
+               distanceFormat, size);
   }
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #pragma once
 
 #include "flipFlops.hpp"
+#include "maxReduction.hpp"
+#include "rect.hpp"
+#include "stageCache.hpp"
+#include "textureFormats.hpp"
+#include <array>
+#include <cpu/jumpFlood.hpp>
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
 
@@ -11,52 +17,114 @@ class Jfa {
     gl::Program toUv;
     gl::Program jumpFlood;
     gl::Program distance;
+    gl::Program jumpFloodStep;
+    gl::Program jumpFloodFused;
   };
 
   Programs m_programs;
+  MaxReduction m_reach;
 
+  TexturePool& m_pool;
+
+  // Only hold seeds while the passes run, so they are shared with other
+  // passes through the pool
   FlipFlops m_flipFlops;
+  std::array<uint32_t, 2> m_scratchSlots{0, 1};
 
-  std::vector<gl::StorageBuffer> m_ubos;
+  TexturePool::Target m_result;
+  TexturePool::Target m_distanceResult;
 
-  struct JfaResult {
-    gl::Texture texture;
-    gl::Framebuffer fbo;
-  };
+  uint32_t m_jfaPasses;
+  uint32_t m_maxJfaPasses;
+
+  GLenum m_seedFormat;
+  GLenum m_distanceFormat;
+  gl::Window::Size m_size;
 
-  JfaResult m_result;
+  struct CacheInputs {
+    uint64_t sceneVersion;
+    uint32_t passes;
+    gl::Window::Size size;
+    bool cpu;
+    bool compute;
 
-  struct DistanceResult {
-    gl::Texture texture;
-    gl::Framebuffer fbo;
+    bool operator==(const CacheInputs&) const = default;
   };
 
-  DistanceResult m_distanceResult;
+  StageCache<CacheInputs> m_cache{};
 
-  uint32_t m_jfaPasses;
-  uint32_t m_maxJfaPasses;
+  struct DistanceInputs {
+    uint64_t seedsVersion;
+    gl::Window::Size size;
+
+    bool operator==(const DistanceInputs&) const = default;
+  };
 
-  Jfa(const gl::Vao& fullscreenVao, Programs&& programs, FlipFlops&& flipFlops,
-      std::vector<gl::StorageBuffer> ubos, JfaResult&& result,
-      DistanceResult&& distanceResult, uint32_t jfaPasses,
-      uint32_t maxJfaPasses, const gl::Window& window)
+  StageCache<DistanceInputs> m_distanceCache{};
+
+  bool m_incremental = true;
+  bool m_compute = false;
+  // Region the last recompute touched, none if it covered everything
+  std::optional<Rect> m_changed = std::nullopt;
+  // The same for the distance field, which may have skipped seed updates
+  std::optional<Rect> m_distanceChanged = std::nullopt;
+  // Largest distance in texels since the last full update, read back from
+  // m_reach without waiting. Strokes only add seeds, so distances only
+  // shrink and a new seed can't change texels further away than this until
+  // the next full update. Every update is a full one until it arrives
+  std::optional<int> m_maxDistance = std::nullopt;
+
+  // Staging for the CPU fallback
+  std::vector<float> m_cpuScene{};
+  std::vector<float> m_cpuResult{};
+  std::vector<float> m_cpuDistance{};
+  // Set while m_cpuResult holds the distances of the last CPU update
+  bool m_cpuDistancePending = false;
+
+  Jfa(const gl::Vao& fullscreenVao, Programs&& programs, MaxReduction&& reach,
+      TexturePool& pool, FlipFlops&& flipFlops, TexturePool::Target&& result,
+      TexturePool::Target&& distanceResult, uint32_t jfaPasses,
+      uint32_t maxJfaPasses, GLenum seedFormat, GLenum distanceFormat,
+      const gl::Window::Size& size)
       : m_fullscreenVao(fullscreenVao), m_programs(std::move(programs)),
-        m_flipFlops(std::move(flipFlops)), m_ubos(std::move(ubos)),
-        m_result(std::move(result)),
+        m_reach(std::move(reach)), m_pool(pool),
+        m_flipFlops(std::move(flipFlops)), m_result(std::move(result)),
         m_distanceResult(std::move(distanceResult)), m_jfaPasses(jfaPasses),
-        m_maxJfaPasses(maxJfaPasses) {
-    setupUbos(window.size());
+        m_maxJfaPasses(maxJfaPasses), m_seedFormat(seedFormat),
+        m_distanceFormat(distanceFormat), m_size(size) {}
+
+  /// Takes back what release() and releaseDistance() handed to the pool
+  void acquireSeeds() {
+    if (!m_result) {
+      m_result = m_pool.acquire({m_seedFormat, m_size});
+      m_cache.invalidate();
+    }
+    if (m_flipFlops.empty()) {
+      m_flipFlops = FlipFlops(m_pool, m_seedFormat, m_size, m_scratchSlots);
+    }
+  }
+  void acquireDistance() {
+    if (!m_distanceResult) {
+      m_distanceResult = m_pool.acquire({m_distanceFormat, m_size});
+      m_distanceCache.invalidate();
+    }
+  }
+
+  /// Offset in texels of pass <paramref name="pass"/> out of
+  /// <paramref name="passes"/>, halving from 2^(passes - 1) down to 1
+  static int32_t passOffset(uint32_t pass, uint32_t passes) {
+    return 1 << (passes - pass - 1);
   }
 
-  void setupUbos(const gl::Window::Size& size) {
+  /// Uploads and binds the uv offset of a fragment pass
+  static void bindPassParams(uint32_t pass, uint32_t passes,
+                             const gl::Window::Size& size) {
     glm::vec2 fsize{static_cast<float>(size.width),
                     static_cast<float>(size.height)};
-
-    for (size_t i = 0; i < m_ubos.size(); i++) {
-      auto* mapping = static_cast<JfaParams*>(m_ubos[i].getMapping());
-      mapping->offset =
-          glm::vec2(static_cast<float>(pow(2, m_jfaPasses - i - 1))) / fsize;
-    }
+    JfaParams params{
+        .offset = glm::vec2(static_cast<float>(passOffset(pass, passes))) /
+                  fsize};
+    gl::UploadRing::get().bindUniform(params, 0);
   }
 
 public:
@@ -64,66 +132,339 @@ public:
     glm::vec2 offset;
   };
 
+  /// <summary>
+  /// Parameters of the compute passes, in texels. Only the fused kernel
+  /// reads <c>fusedPasses</c>.
+  /// </summary>
+  struct JfaComputeParams {
+    glm::ivec2 size;
+    int32_t offset;
+    int32_t fusedPasses;
+  };
+
+  /// Trailing passes the fused compute kernel runs in shared memory
+  static constexpr uint32_t FUSED_PASSES = 3;
+  /// Workgroup sizes of jumpflood_step and jumpflood_fused
+  static constexpr GLuint STEP_GROUP_SIZE = 8;
+  static constexpr GLuint FUSED_TILE_SIZE = 16;
+
   uint32_t& passes() { return m_jfaPasses; }
   uint32_t maxPasses() const { return m_maxJfaPasses; }
 
-  const JfaResult& result() const { return m_result; }
-  const DistanceResult& distanceResult() const { return m_distanceResult; }
+  const TexFbo& result() const { return *m_result; }
+  const TexFbo& distanceResult() const { return *m_distanceResult; }
+
+  StageCache<CacheInputs>& cache() { return m_cache; }
+  /// Changes every time the seeds are recomputed
+  uint64_t version() const { return m_cache.version(); }
+  /// Changes every time the distance field is recomputed
+  uint64_t distanceVersion() const { return m_distanceCache.version(); }
+  bool& incremental() { return m_incremental; }
+  /// Runs the flood passes as compute dispatches instead of fragment passes
+  bool& compute() { return m_compute; }
+  /// The compute passes load and store the seeds as rgba32f images
+  bool computeSupported() const { return m_seedFormat == GL_RGBA32F; }
+  const std::optional<Rect>& changedRegion() const { return m_changed; }
+  const std::optional<Rect>& distanceChanged() const {
+    return m_distanceChanged;
+  }
+
+  /// Keys of the seed and distance textures
+  TexturePool::Key seedKey() const { return {m_seedFormat, m_size}; }
+  TexturePool::Key distanceKey() const { return {m_distanceFormat, m_size}; }
+
+  /// <summary>
+  /// Moves the flip flops to other transient pool slots, from the next
+  /// update on.
+  /// </summary>
+  void setScratchSlots(const std::array<uint32_t, 2>& slots) {
+    if (slots != m_scratchSlots) {
+      m_scratchSlots = slots;
+      m_flipFlops = FlipFlops{};
+    }
+  }
+
+  /// <summary>
+  /// Hands the seeds and flip flops back to the pool while nothing reads
+  /// them. The next update takes them again and floods everything.
+  /// </summary>
+  void release() {
+    m_flipFlops = FlipFlops{};
+    m_result.reset();
+  }
+
+  /// <summary>
+  /// Hands the distance field back to the pool while nothing reads it. The
+  /// next distance update takes it again and redraws it all.
+  /// </summary>
+  void releaseDistance() { m_distanceResult.reset(); }
 
   static std::optional<Jfa> create(const gl::Vao& fullscreenVao,
-                                   const gl::Window& window);
+                                   TexturePool& pool,
+                                   const gl::Window::Size& size,
+                                   const TextureFormats& formats = {});
+
+  /// <summary>
+  /// Switches to the seed and distance formats of
+  /// <paramref name="formats"/>. The textures are recreated empty, so the
+  /// next update is a full one.
+  /// </summary>
+  void setFormats(const TextureFormats& formats,
+                  const gl::Window::Size& size) {
+    GLenum seedFormat = formats.seedFormat().internalFormat;
+    GLenum distanceFormat = formats.distanceFormat().internalFormat;
+    if (seedFormat == m_seedFormat && distanceFormat == m_distanceFormat) {
+      return;
+    }
+    m_seedFormat = seedFormat;
+    m_distanceFormat = distanceFormat;
+    resize(size);
+  }
 
+  /// <summary>
+  /// Swaps the textures for ones of <paramref name="size"/> from the pool,
+  /// handing the old ones back first so a same sized one can be reused.
+  /// </summary>
   void resize(const gl::Window::Size& size) {
-    m_flipFlops = FlipFlops(GL_RGBA32F, size, 2);
-
-    m_result = JfaResult{};
-    m_result.texture.storage(1, GL_RGBA32F, {size.width, size.height});
-    m_result.fbo.attachTexture(GL_COLOR_ATTACHMENT0, m_result.texture);
+    m_flipFlops = FlipFlops{};
+    m_result.reset();
+    m_distanceResult.reset();
 
-    m_distanceResult = DistanceResult{};
-    m_distanceResult.texture.storage(1, GL_R32F, {size.width, size.height});
-    m_distanceResult.fbo.attachTexture(GL_COLOR_ATTACHMENT0,
-                                       m_distanceResult.texture);
+    m_size = size;
+    acquireSeeds();
+    acquireDistance();
+    m_cache.invalidate();
 
-    uint32_t maxJfaPasses =
+    m_maxJfaPasses =
         static_cast<uint32_t>(ceil(log2(std::max(size.width, size.height))));
 
-    if (maxJfaPasses > m_maxJfaPasses) {
-      // Add more UBOs
-      for (uint32_t i = m_maxJfaPasses; i < maxJfaPasses; i++) {
-        gl::StorageBuffer ubo(
-            sizeof(JfaParams), nullptr,
-            gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-                gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
-        ubo.map(gl::Buffer::Mapping::WRITE | gl::Buffer::Mapping::PERSISTENT |
-                gl::Buffer::Mapping::COHERENT);
-        m_ubos.push_back(std::move(ubo));
+    if (m_jfaPasses > m_maxJfaPasses) {
+      m_jfaPasses = m_maxJfaPasses;
+    }
+  }
+
+  /// <summary>
+  /// Refloods the seeds only if the scene, pass count or size changed since
+  /// the last call, otherwise the previous ones are kept. The distance field
+  /// follows with updateDistance().
+  /// </summary>
+  /// <param name="cpuJfa">Runs the CPU fallback instead if set</param>
+  /// <returns>Whether the seeds were recomputed</returns>
+  bool update(const gl::Texture& drawTexture, gl::Window::Size size,
+              uint64_t sceneVersion, const Rect& dirty = Rect{},
+              cpu::JumpFlood* cpuJfa = nullptr) {
+    acquireSeeds();
+    if (auto maxUv = m_reach.poll(); maxUv.has_value()) {
+      m_maxDistance = reachTexels(*maxUv, size);
+    }
+    auto previous = m_cache.inputs();
+    CacheInputs inputs{.sceneVersion = sceneVersion,
+                       .passes = m_jfaPasses,
+                       .size = size,
+                       .cpu = cpuJfa != nullptr,
+                       .compute = m_compute && computeSupported()};
+    if (!m_cache.needsUpdate(inputs)) {
+      m_changed = Rect{};
+      return false;
+    }
+
+    // Only the scene changed, and only inside the dirty rect
+    bool incremental = m_incremental && !dirty.empty() &&
+                       m_maxDistance.has_value() && previous.has_value() &&
+                       !previous->cpu && !inputs.cpu &&
+                       previous->passes == inputs.passes &&
+                       previous->size == size && m_jfaPasses == m_maxJfaPasses;
+    if (incremental) {
+      int reach = *m_maxDistance;
+      Rect region = dirty.expanded(reach).clamped(size);
+      if (!region.covers(size)) {
+        auto passes = std::min(
+            m_jfaPasses,
+            static_cast<uint32_t>(std::ceil(std::log2(reach + 1.0))));
+        drawIncremental(drawTexture, size, dirty.clamped(size), region,
+                        passes);
+        m_changed = region;
+        m_cpuDistancePending = false;
+        return true;
       }
-    } else if (maxJfaPasses < m_maxJfaPasses) {
-      // Remove extra UBOs
-      m_ubos.resize(maxJfaPasses);
     }
 
-    m_maxJfaPasses = maxJfaPasses;
+    if (cpuJfa != nullptr) {
+      drawCpu(drawTexture, size, *cpuJfa);
+    } else {
+      flood(drawTexture, size);
+      m_cpuDistancePending = false;
+    }
+    m_changed = std::nullopt;
+    m_maxDistance.reset();
+    m_reach.cancel();
+    return true;
+  }
 
-    if (m_jfaPasses > m_maxJfaPasses) {
-      m_jfaPasses = m_maxJfaPasses;
+  /// <summary>
+  /// Redraws the distance field if the seeds changed since it was last
+  /// drawn. Only the changed region is redrawn when it missed no update.
+  /// </summary>
+  /// <returns>Whether the distance field was recomputed</returns>
+  bool updateDistance(const gl::Window::Size& size) {
+    acquireDistance();
+    auto previous = m_distanceCache.inputs();
+    DistanceInputs inputs{.seedsVersion = m_cache.version(), .size = size};
+    if (!m_distanceCache.needsUpdate(inputs)) {
+      m_distanceChanged = Rect{};
+      return false;
     }
 
-    setupUbos(size);
+    if (m_cpuDistancePending) {
+      m_distanceResult->tex.subImage(0, 0, 0, size.width, size.height,
+                                     GL_RGBA, GL_FLOAT, m_cpuResult.data());
+      m_cpuDistancePending = false;
+      m_distanceChanged = std::nullopt;
+      return true;
+    }
+
+    bool incremental = previous.has_value() && previous->size == size &&
+                       previous->seedsVersion + 1 == inputs.seedsVersion &&
+                       m_changed.has_value() && !m_changed->empty();
+    drawDistance(incremental ? *m_changed : Rect{});
+    m_distanceChanged = incremental ? m_changed : std::nullopt;
+    if (!m_maxDistance.has_value() && !m_reach.pending()) {
+      m_reach.start(m_distanceResult->tex, size);
+    }
+    return true;
   }
 
-  void draw(const gl::Texture& drawTexture, gl::Window::Size size,
-            glm::vec2 fsize) {
-#pragma region ToUV
-    m_programs.toUv.bind();
+  /// <summary>
+  /// How far in texels a new seed can reach, from the largest distance of
+  /// the field in uv.
+  /// </summary>
+  static int reachTexels(float maxUv, const gl::Window::Size& size) {
+    // Distances are clamped to 1, which means no seed was found
+    int longestSide = std::max(size.width, size.height);
+    float maxTexels = maxUv * static_cast<float>(longestSide);
+    return maxUv >= 1.f ? longestSide
+                        : static_cast<int>(std::ceil(maxTexels)) + 1;
+  }
+
+  /// <summary>
+  /// Floods only <paramref name="region"/>, starting from the previous
+  /// result with the seeds inside <paramref name="dirty"/> added on top.
+  /// Texels outside keep their old nearest seed, which is still correct as
+  /// long as the region covers the reach of the new seeds.
+  /// </summary>
+  void drawIncremental(const gl::Texture& drawTexture,
+                       const gl::Window::Size& size, const Rect& dirty,
+                       const Rect& region, uint32_t passes) {
+    auto& profiler = gl::GpuProfiler::get();
+
+    {
+      // Passes read outside the region too, so both buffers need the old
+      // seeds there. Never further than the offsets add up to
+      auto timer = profiler.scope("JFA incremental copy");
+      Rect read = region.expanded((1 << passes) - 1).clamped(size);
+      for (size_t i = 0; i < 2; i++) {
+        m_result->fbo.blit(m_flipFlops[i].fbo.id(), read.x0, read.y0,
+                           read.x1, read.y1, read.x0, read.y0, read.x1,
+                           read.y1, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+      }
+    }
+
+    glEnable(GL_SCISSOR_TEST);
+    m_fullscreenVao.bind();
+    {
+      auto timer = profiler.scope("To UV");
+      dirty.scissor();
+      m_programs.toUv.bind();
+      drawTexture.bind(0);
+      m_flipFlops[0].fbo.bind();
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+
+    region.scissor();
+    m_programs.jumpFlood.bind();
+    // Only the last passes, offsets 2^(passes - 1) down to 1
+    uint32_t firstPass = m_jfaPasses - passes;
+    for (uint32_t i = 0; i < passes; i++) {
+      auto timer = profiler.scope("JFA pass", static_cast<int>(firstPass + i));
+      m_flipFlops[i % 2].tex.bind(0);
+      m_flipFlops[(i + 1) % 2].fbo.bind();
+      bindPassParams(i, passes, size);
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    glDisable(GL_SCISSOR_TEST);
+    gl::Framebuffer::unbind();
+
+    {
+      auto timer = profiler.scope("JFA copy");
+      m_flipFlops[passes % 2].fbo.blit(
+          m_result->fbo.id(), region.x0, region.y0, region.x1, region.y1,
+          region.x0, region.y0, region.x1, region.y1, GL_COLOR_BUFFER_BIT,
+          GL_NEAREST);
+    }
+  }
+
+  /// <summary>
+  /// Floods the seeds and draws the distance field from them, the whole
+  /// pipeline without any caching.
+  /// </summary>
+  void draw(const gl::Texture& drawTexture, gl::Window::Size size) {
+    acquireSeeds();
+    acquireDistance();
+    if (flood(drawTexture, size)) {
+      glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                      GL_FRAMEBUFFER_BARRIER_BIT);
+    }
+    drawDistance();
+    m_cpuDistancePending = false;
+    m_distanceCache.invalidate();
+  }
+
+  /// <summary>
+  /// Draws the distance field from the seeds, only inside
+  /// <paramref name="region"/> if it isn't empty.
+  /// </summary>
+  void drawDistance(const Rect& region = Rect{}) {
+    auto timer = gl::GpuProfiler::get().scope("Distance");
+    if (!region.empty()) {
+      glEnable(GL_SCISSOR_TEST);
+      region.scissor();
+    }
+    m_programs.distance.bind();
     m_fullscreenVao.bind();
-    drawTexture.bind(0);
-    m_flipFlops[0].fbo.bind();
+    m_result->tex.bind(0);
+    m_distanceResult->fbo.bind();
     glDrawArrays(GL_TRIANGLES, 0, 3);
+    gl::Framebuffer::unbind();
+    glDisable(GL_SCISSOR_TEST);
+  }
+
+  /// <summary>
+  /// Floods the seeds of the whole scene into the result.
+  /// </summary>
+  /// <returns>Whether the result was written with image stores, which
+  /// needs a barrier before it is read</returns>
+  bool flood(const gl::Texture& drawTexture, gl::Window::Size size) {
+    auto& profiler = gl::GpuProfiler::get();
+#pragma region ToUV
+    {
+      auto timer = profiler.scope("To UV");
+      // toUv leaves empty texels alone
+      constexpr glm::vec4 empty(0.f, 0.f, 0.f, 1.f);
+      glClearNamedFramebufferfv(m_flipFlops[0].fbo.id(), GL_COLOR, 0,
+                                &empty.r);
+      m_programs.toUv.bind();
+      m_fullscreenVao.bind();
+      drawTexture.bind(0);
+      m_flipFlops[0].fbo.bind();
+      glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
 #pragma endregion
 
 #pragma region JFA
+    if (m_compute && computeSupported() && m_jfaPasses != 0) {
+      floodCompute(size);
+      return true;
+    }
     if (m_jfaPasses != 0) {
       m_programs.jumpFlood.bind();
       m_fullscreenVao.bind();
@@ -131,12 +472,11 @@ public:
       const gl::Texture* inTex = &m_flipFlops[0].tex;
       const gl::Framebuffer* output = &m_flipFlops[1].fbo;
 
-      glm::vec2 oneOverResolution = {1.f / fsize.x, 1.f / fsize.y};
-
       for (uint32_t i = 0; i < m_jfaPasses; i++) {
+        auto timer = profiler.scope("JFA pass", static_cast<int>(i));
         inTex->bind(0);
         output->bind();
-        m_ubos[i].bindBase(gl::StorageBuffer::Target::UNIFORM, 0);
+        bindPassParams(i, m_jfaPasses, size);
 
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
@@ -151,35 +491,119 @@ public:
     }
     gl::Framebuffer::unbind();
 
-    if (m_jfaPasses % 2 == 1 || m_jfaPasses == 0) {
-      m_flipFlops[0].fbo.blit(m_result.fbo.id(), 0, 0, size.width, size.height,
-                              0, 0, size.width, size.height,
-                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
-    } else {
-      m_flipFlops[1].fbo.blit(m_result.fbo.id(), 0, 0, size.width, size.height,
-                              0, 0, size.width, size.height,
-                              GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    {
+      // Pass i writes flip flop (i + 1) % 2, on either path
+      auto timer = profiler.scope("JFA copy");
+      m_flipFlops[m_jfaPasses % 2].fbo.blit(
+          m_result->fbo.id(), 0, 0, size.width, size.height, 0, 0, size.width,
+          size.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
     }
 #pragma endregion
+    return false;
+  }
 
-#pragma region Distance
-    m_programs.distance.bind();
-    m_fullscreenVao.bind();
-    m_result.texture.bind(0);
-    m_distanceResult.fbo.bind();
-    glDrawArrays(GL_TRIANGLES, 0, 3);
-    gl::Framebuffer::unbind();
-#pragma endregion
+  /// <summary>
+  /// Flood passes as compute dispatches that ping-pong between the flip flops
+  /// with image load/store. The large offsets run one dispatch each, the last
+  /// <c>FUSED_PASSES</c> run in a single dispatch on shared memory tiles,
+  /// which stores straight into the result instead of a flip flop to copy.
+  /// Whoever reads the result next issues the barrier for it.
+  /// </summary>
+  void floodCompute(const gl::Window::Size& size) {
+    auto& profiler = gl::GpuProfiler::get();
+    uint32_t fused = std::min(m_jfaPasses, FUSED_PASSES);
+    uint32_t steps = m_jfaPasses - fused;
+
+    auto& ring = gl::UploadRing::get();
+    glm::ivec2 texels(size.width, size.height);
+
+    auto groups = [](GLsizei extent, GLuint groupSize) {
+      return (static_cast<GLuint>(extent) + groupSize - 1) / groupSize;
+    };
+
+    m_programs.jumpFloodStep.bind();
+    for (uint32_t i = 0; i < steps; i++) {
+      auto timer = profiler.scope("JFA pass", static_cast<int>(i));
+      m_flipFlops[i % 2].tex.bindImage(0, 0, GL_READ_ONLY, GL_RGBA32F);
+      m_flipFlops[(i + 1) % 2].tex.bindImage(1, 0, GL_WRITE_ONLY,
+                                             GL_RGBA32F);
+      ring.bindUniform(JfaComputeParams{.size = texels,
+                                        .offset = passOffset(i, m_jfaPasses),
+                                        .fusedPasses = 0},
+                       0);
+      glDispatchCompute(groups(size.width, STEP_GROUP_SIZE),
+                        groups(size.height, STEP_GROUP_SIZE), 1);
+      glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+
+    if (fused != 0) {
+      auto timer = profiler.scope("JFA fused");
+      m_programs.jumpFloodFused.bind();
+      m_flipFlops[steps % 2].tex.bindImage(0, 0, GL_READ_ONLY, GL_RGBA32F);
+      m_result->tex.bindImage(1, 0, GL_WRITE_ONLY, GL_RGBA32F);
+      ring.bindUniform(
+          JfaComputeParams{.size = texels,
+                           .offset = passOffset(steps, m_jfaPasses),
+                           .fusedPasses = static_cast<int32_t>(fused)},
+          0);
+      glDispatchCompute(groups(size.width, FUSED_TILE_SIZE),
+                        groups(size.height, FUSED_TILE_SIZE), 1);
+    }
+  }
+
+  /// <summary>
+  /// Runs the same passes on the CPU and uploads the seeds, as a fallback
+  /// for drivers where the fragment passes are slow. The distances are kept
+  /// for updateDistance(). Reading the scene back waits for the GPU to
+  /// finish drawing it.
+  /// </summary>
+  void drawCpu(const gl::Texture& drawTexture, gl::Window::Size size,
+               cpu::JumpFlood& cpuJfa) {
+    auto timer = gl::GpuProfiler::get().scope("CPU JFA");
+    size_t texels =
+        static_cast<size_t>(size.width) * static_cast<size_t>(size.height);
+
+    m_cpuScene.resize(texels * 4);
+    drawTexture.getImage(
+        0, GL_RGBA, GL_FLOAT,
+        static_cast<GLsizei>(m_cpuScene.size() * sizeof(float)),
+        m_cpuScene.data());
+
+    cpuJfa.seed(m_cpuScene, size.width, size.height);
+    cpuJfa.flood(m_jfaPasses);
+
+    m_cpuResult.resize(texels * 2);
+    cpuJfa.seeds(m_cpuResult);
+    m_result->tex.subImage(0, 0, 0, size.width, size.height, GL_RG,
+                              GL_FLOAT, m_cpuResult.data());
+
+    // Grey like the distance shader writes it
+    m_cpuDistance.resize(texels);
+    cpuJfa.distance(m_cpuDistance);
+    m_cpuResult.resize(texels * 4);
+    for (size_t i = 0; i < texels; i++) {
+      float dist = m_cpuDistance[i];
+      m_cpuResult[i * 4] = dist;
+      m_cpuResult[i * 4 + 1] = dist;
+      m_cpuResult[i * 4 + 2] = dist;
+      m_cpuResult[i * 4 + 3] = 1.f;
+    }
+    // Uploaded by the next distance update
+    m_cpuDistancePending = true;
   }
 
   void blitToMain(const gl::Window::Size& size) {
-    m_result.fbo.blit(0, 0, 0, size.width, size.height, 0, 0, size.width,
-                      size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    auto timer = gl::GpuProfiler::get().scope("JFA blit");
+    const auto& source = m_result->tex.size();
+    m_result->fbo.blit(0, 0, 0, source.width, source.height, 0, 0, size.width,
+                       size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
   }
 
   void blitDistanceToMain(const gl::Window::Size& size) {
-    m_distanceResult.fbo.blit(0, 0, 0, size.width, size.height, 0, 0,
-                              size.width, size.height, GL_COLOR_BUFFER_BIT,
-                              GL_LINEAR);
+    auto timer = gl::GpuProfiler::get().scope("Distance blit");
+    const auto& source = m_distanceResult->tex.size();
+    m_distanceResult->fbo.blit(0, 0, 0, source.width, source.height, 0, 0,
+                               size.width, size.height, GL_COLOR_BUFFER_BIT,
+                               GL_LINEAR);
   }
 };
@@ -1,25 +1,27 @@
 #include "input.hpp"
 #include "logger.hpp"
+#include <chrono>
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
 #include <imgui/imgui.h>
+#include <string_view>
+#include <thread>
 
 #include "drawing.hpp"
 #include "flatland_rc.hpp"
+#include "fullscreen.hpp"
+#include "incrementalCheck.hpp"
+#include "inputLatency.hpp"
 #include "jfa.hpp"
 #include "naive.hpp"
+#include "qualityGovernor.hpp"
+#include "renderGraph.hpp"
+#include "renderThread.hpp"
+#include "stageCache.hpp"
+#include "textureFormats.hpp"
+#include "texturePool.hpp"
 #include "triangle.hpp"
 
-struct BasicVertex {
-  glm::vec2 position;
-};
-
-std::array<BasicVertex, 3> fullscreenTriangle = {
-    BasicVertex{.position = {-1.0f, -1.0f}},
-    BasicVertex{.position = {3.0f, -1.0f}},
-    BasicVertex{.position = {-1.0f, 3.0f}},
-};
-
 constexpr int WINDOW_WIDTH = 1024;
 constexpr int WINDOW_HEIGHT = 1024;
 
@@ -49,8 +51,69 @@ template <> struct fmt::formatter<RenderMode> : formatter<std ::string_view> {
   }
 };
 
-int main() {
+/// <summary>
+/// Everything the render graph is declared from. It is only declared again
+/// when one of them changes, other frames execute the same one.
+/// </summary>
+struct GraphInputs {
+  RenderMode mode;
+  gl::Window::Size windowSize;
+  // Size the passes render at, the window size once it settled
+  gl::Window::Size size;
+  TexturePool::Key scene;
+  TexturePool::Key seeds;
+  TexturePool::Key distance;
+  TexturePool::Key cascades;
+  TexturePool::Key cascadeBuffer;
+  TexturePool::Key averaged;
+  // The JFA stores into the seeds as images
+  bool imageStores;
+  bool cpuJfa;
+  bool leanCascades;
+  uint32_t maxCascades;
+  uint32_t probeSpacing;
+  // The spaced out probes outlive the draw, for incremental updates
+  bool keptProbes;
+  bool accumulate;
+
+  bool operator==(const GraphInputs&) const = default;
+};
+
+/// <summary>
+/// Combo box over one of the format lists of <c>TextureFormats</c>
+/// </summary>
+template <typename E, size_t N>
+bool formatCombo(const char* label, E& value,
+                 const std::array<TextureFormats::Format, N>& formats) {
+  bool changed = false;
+  auto current = static_cast<size_t>(value);
+  if (ImGui::BeginCombo(label, formats[current].name.data())) {
+    for (size_t i = 0; i < N; i++) {
+      if (ImGui::Selectable(formats[i].name.data(), i == current)) {
+        value = static_cast<E>(i);
+        changed = i != current;
+      }
+    }
+    ImGui::EndCombo();
+  }
+  return changed;
+}
+
+int main(int argc, char** argv) {
   Logger::info("Starting application");
+
+  // Submits the frames from a thread of its own, to compare the input to
+  // present latency of both designs
+  bool threaded = false;
+  for (int i = 1; i < argc; i++) {
+    std::string_view arg = argv[i];
+    if (arg == "--threaded") {
+      threaded = true;
+    } else {
+      Logger::warn("Ignoring unknown argument {}", arg);
+    }
+  }
+
   auto& wm = gl::WindowManager::get();
 
   gl::Window window(WINDOW_WIDTH, WINDOW_HEIGHT, "Radiance Cascades FLOAT",
@@ -63,20 +126,24 @@ int main() {
   }
 
   Logger::info("Loaded OpenGL {}.{}\n", GLVersion.major, GLVersion.minor);
+  if (auto embedded = gl::EmbeddedShaders::count(); embedded != 0) {
+    Logger::info("Using {} shaders embedded in the executable", embedded);
+  }
 
   Input input(window);
 
-  gl::gui::Context gui(window);
+  // With a render thread ImGui is fed the events it forwards instead
+  gl::gui::Context gui(window, !threaded);
 
   glm::vec4 clearColor(0.0f, 0.0f, 0.0f, 0.0f);
   glClearColor(clearColor.x, clearColor.y, clearColor.z, clearColor.w);
 
-  gl::BasicBuffer fullscreenVbo(static_cast<GLuint>(fullscreenTriangle.size()) *
-                                    sizeof(BasicVertex),
-                                fullscreenTriangle.data());
-  gl::Vao fullscreenVao;
-  fullscreenVao.bindVertexBuffer(0, fullscreenVbo.id(), 0, sizeof(BasicVertex));
-  fullscreenVao.attribFormat(0, 2, GL_FLOAT, false, 0, 0);
+  // Startup is dominated by compiling programs, timed to see what the
+  // program cache saves
+  auto programsStart = std::chrono::steady_clock::now();
+
+  auto fullscreen = FullscreenTriangle::create();
+  const gl::Vao& fullscreenVao = fullscreen.vao;
 
   uint32_t rayCount = 4;
   uint32_t maxSteps = 32;
@@ -92,44 +159,326 @@ int main() {
   }
   auto& triangle = triOpt.value();
 
-  auto drawOpt = Drawing::create(fullscreenVao, oldWindowSize);
+  // Declared before the passes, which hand their textures back to it
+  TexturePool texturePool;
+
+  auto drawOpt = Drawing::create(texturePool, oldWindowSize);
   if (!drawOpt.has_value()) {
     Logger::error("Failed to create drawing");
     return -1;
   }
   auto& drawing = drawOpt.value();
 
-  auto jfaOpt = Jfa::create(fullscreenVao, window);
+  auto jfaOpt = Jfa::create(fullscreenVao, texturePool, oldWindowSize);
   if (!jfaOpt.has_value()) {
     Logger::error("Failed to create JFA");
     return -1;
   }
   auto& jfa = jfaOpt.value();
 
-  auto naiveOpt = NaiveRaymarch::create(fullscreenVao, rayCount, maxSteps);
+  auto naiveOpt =
+      NaiveRaymarch::create(fullscreenVao, texturePool, rayCount, maxSteps);
   if (!naiveOpt.has_value()) {
     Logger::error("Failed to create naive raymarch");
     return -1;
   }
   auto& naive = naiveOpt.value();
 
-  auto flatlandOpt =
-      FlatlandRc::create(fullscreenVao, rayCount, maxSteps, oldWindowSize);
+  auto flatlandOpt = FlatlandRc::create(fullscreenVao, texturePool, rayCount,
+                                        maxSteps, oldWindowSize);
   if (!flatlandOpt.has_value()) {
     Logger::error("Failed to create flatland radiance cascades");
     return -1;
   }
   auto& flatland = flatlandOpt.value();
 
+  cpu::ThreadPool threadPool;
+  cpu::JumpFlood cpuJfa(threadPool);
+  bool useCpuJfa = false;
+  bool cachePasses = true;
+  bool verifyIncremental = false;
+  TextureFormats formats{};
+  IncrementalCheck incrementalCheck(fullscreenVao, rayCount, maxSteps);
+
+  {
+    auto elapsed = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - programsStart);
+    const auto& cache = gl::ProgramCache::get().stats();
+    Logger::info("Created programs in {:.1f}ms, {} from the program cache, "
+                 "{} compiled",
+                 elapsed.count(), cache.hits, cache.misses);
+  }
+
+  // Passes are only resized once the window stopped changing size for this
+  // long, dragging its edge would reallocate every texture each frame
+  constexpr auto RESIZE_DEBOUNCE = std::chrono::milliseconds(200);
+  auto pendingSize = oldWindowSize;
+  auto resizeAt = std::chrono::steady_clock::now();
+
   RenderMode renderMode = RenderMode::RadianceCascades;
 
-  while (!window.shouldClose()) {
-    gl::Window::pollEvents();
-    if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0) {
-      gui.sleep(10);
-      continue;
+  constexpr const char* SCENE_PATH = "scene.rcs";
+  std::string sceneStatus;
+
+  QualityGovernor governor;
+  {
+    auto bounds = governor.bounds();
+    bounds.maxJfaPasses = jfa.maxPasses();
+    governor.setBounds(bounds);
+  }
+  auto applyQuality = [&](const QualityGovernor::Settings& settings) {
+    rayCount = settings.rayCount;
+    maxSteps = settings.maxSteps;
+    jfa.passes() = std::min(settings.jfaPasses, jfa.maxPasses());
+    flatland.setProbeSpacing(settings.probeSpacing, fsize);
+    flatland.updateMaxCascades(fsize);
+  };
+
+  auto& profiler = gl::GpuProfiler::get();
+  auto& uploadRing = gl::UploadRing::get();
+  auto& stateCache = gl::StateCache::get();
+
+  // Every mode declares the same passes and only presents something else,
+  // the graph culls whatever the shown result doesn't depend on. Execute
+  // callbacks run long after this returns, so they capture handles and
+  // inputs by value
+  RenderGraph graph;
+  StageCache<GraphInputs> graphCache;
+  using Access = RenderGraph::Access;
+  using Builder = RenderGraph::Builder;
+  auto graphInputs = [&](RenderMode mode, gl::Window::Size windowSize) {
+    return GraphInputs{
+        .mode = mode,
+        .windowSize = windowSize,
+        .size = oldWindowSize,
+        .scene = drawing.key(),
+        .seeds = jfa.seedKey(),
+        .distance = jfa.distanceKey(),
+        .cascades = flatland.resultKey(fsize),
+        .cascadeBuffer = flatland.cascadeKey(fsize),
+        .averaged = flatland.averagedKey(fsize),
+        .imageStores = !useCpuJfa && jfa.compute() && jfa.computeSupported() &&
+                       jfa.passes() != 0,
+        .cpuJfa = useCpuJfa,
+        .leanCascades = flatland.transientCascades(),
+        .maxCascades = flatland.maxCascades(),
+        .probeSpacing = flatland.probeSpacing(),
+        .keptProbes = flatland.probesKept(),
+        .accumulate = naive.accumulate()};
+  };
+  auto buildGraph = [&](const GraphInputs& in) {
+    graph.reset();
+    auto size = in.size;
+    auto windowSize = in.windowSize;
+    auto screen = graph.import("Screen", {0, windowSize});
+    graph.output(screen);
+    // The canvas can't be redrawn, it is held whether it is shown or not
+    auto scene = graph.import("Scene", in.scene);
+    graph.retain(scene);
+    auto seeds = graph.import("Seeds", in.seeds);
+    auto distance = graph.import("Distance", in.distance);
+    auto cascades = graph.import("Cascades", in.cascades);
+    // One per cascade, unless lean storage makes them transient
+    auto cascadeBuffers = graph.import("Cascade buffers", in.cascadeBuffer,
+                                       in.leanCascades ? 0u : in.maxCascades);
+    auto history =
+        graph.import("History", NaiveRaymarch::historyKey(size), 2);
+    // Incremental updates keep the spaced out probes outside the region they
+    // redraw, so those can't share a slot
+    std::optional<RenderGraph::Handle> keptProbes;
+    if (in.probeSpacing > 1 && in.keptProbes) {
+      keptProbes = graph.import("Probes", in.cascadeBuffer);
+    }
+
+    graph.addPass("Drawing", [&](Builder& pass) {
+      pass.write(scene);
+      return [&drawing, &input, &fsize] { drawing.draw(input, fsize); };
+    });
+
+    graph.addPass(
+        "JFA",
+        [&](Builder& pass) {
+          pass.read(scene);
+          // Incremental updates start from the previous seeds
+          pass.read(seeds, Access::Transfer);
+          pass.write(seeds,
+                     in.imageStores ? Access::Image : Access::Attachment);
+          std::array<RenderGraph::Handle, 2> flipFlops{
+              pass.create("JFA flip flop 0", in.seeds),
+              pass.create("JFA flip flop 1", in.seeds)};
+          return [&graph, &jfa, &drawing, &cpuJfa, &useCpuJfa, &cachePasses,
+                  flipFlops, size] {
+            jfa.setScratchSlots(
+                {graph.slot(flipFlops[0]), graph.slot(flipFlops[1])});
+            if (!cachePasses) {
+              jfa.cache().invalidate();
+            }
+            jfa.update(drawing.texture(), size, drawing.version(),
+                       drawing.takeDirty(), useCpuJfa ? &cpuJfa : nullptr);
+          };
+        },
+        [&jfa] { jfa.release(); });
+
+    graph.addPass(
+        "Distance",
+        [&](Builder& pass) {
+          pass.read(seeds);
+          pass.write(distance,
+                     in.cpuJfa ? Access::Transfer : Access::Attachment);
+          return [&jfa, size] { jfa.updateDistance(size); };
+        },
+        [&jfa] { jfa.releaseDistance(); });
+
+    graph.addPass(
+        "Cascades",
+        [&](Builder& pass) {
+          pass.read(scene);
+          pass.read(distance);
+          pass.write(cascades);
+          uint32_t leanBuffers =
+              in.leanCascades ? std::min<uint32_t>(2, in.maxCascades) : 0;
+          constexpr std::array<const char*, 2> BUFFER_NAMES{
+              "Cascade buffer 0", "Cascade buffer 1"};
+          std::array<RenderGraph::Handle, 2> buffers{};
+          for (uint32_t i = 0; i < leanBuffers; i++) {
+            buffers[i] = pass.create(BUFFER_NAMES[i], in.cascadeBuffer);
+          }
+          if (!in.leanCascades) {
+            pass.write(cascadeBuffers);
+          }
+          auto averaged = pass.create("Averaged cascade", in.averaged);
+          std::optional<RenderGraph::Handle> probes;
+          if (keptProbes.has_value()) {
+            pass.read(*keptProbes);
+            pass.write(*keptProbes);
+          } else if (in.probeSpacing > 1) {
+            probes = pass.create("Probes", in.cascadeBuffer);
+          }
+          return [&graph, &flatland, &drawing, &jfa, &cachePasses, &fsize,
+                  buffers, leanBuffers, averaged, probes] {
+            FlatlandRc::ScratchSlots slots{};
+            for (uint32_t i = 0; i < leanBuffers; i++) {
+              slots.cascades[i] = graph.slot(buffers[i]);
+            }
+            slots.averaged = graph.slot(averaged);
+            if (probes.has_value()) {
+              slots.probes = graph.slot(*probes);
+            }
+            flatland.setScratchSlots(slots, fsize);
+            if (!cachePasses) {
+              flatland.cache().invalidate();
+            }
+            flatland.update(drawing.texture(), jfa.distanceResult().tex,
+                            fsize, drawing.version(), jfa.distanceVersion(),
+                            jfa.distanceChanged());
+          };
+        },
+        [&flatland] { flatland.release(); });
+
+    graph.addPass(
+        "Naive accumulate",
+        [&](Builder& pass) {
+          pass.read(scene);
+          pass.read(distance);
+          pass.read(history);
+          pass.write(history);
+          return [&naive, &drawing, &jfa, &fsize] {
+            naive.drawAccumulated(drawing.texture(), jfa.distanceResult().tex,
+                                  fsize, drawing.version(),
+                                  jfa.distanceVersion());
+          };
+        },
+        [&naive] { naive.releaseHistory(); });
+
+    switch (in.mode) {
+    case RenderMode::Triangle: {
+      graph.addPass("Triangle", [&](Builder& pass) {
+        pass.write(screen);
+        return [&triangle] { triangle.draw(); };
+      });
+      break;
+    }
+    case RenderMode::JFA: {
+      graph.addPass("JFA blit", [&](Builder& pass) {
+        pass.read(seeds, Access::Transfer);
+        pass.write(screen, Access::Transfer);
+        return [&jfa, windowSize] { jfa.blitToMain(windowSize); };
+      });
+      break;
+    }
+    case RenderMode::Distance: {
+      graph.addPass("Distance blit", [&](Builder& pass) {
+        pass.read(distance, Access::Transfer);
+        pass.write(screen, Access::Transfer);
+        return [&jfa, windowSize] { jfa.blitDistanceToMain(windowSize); };
+      });
+      break;
+    }
+    case RenderMode::Naive: {
+      if (in.accumulate) {
+        graph.addPass("Naive blit", [&](Builder& pass) {
+          pass.read(history, Access::Transfer);
+          pass.write(screen, Access::Transfer);
+          return [&naive, windowSize] { naive.blitToScreen(windowSize); };
+        });
+      } else {
+        graph.addPass("Naive", [&](Builder& pass) {
+          pass.read(scene);
+          pass.read(distance);
+          pass.write(screen);
+          return [&naive, &drawing, &jfa, &fsize] {
+            naive.draw(drawing.texture(), jfa.distanceResult().tex, fsize);
+          };
+        });
+      }
+      break;
+    }
+    case RenderMode::RadianceCascades: {
+      graph.addPass("Cascade blit", [&](Builder& pass) {
+        pass.read(cascades, Access::Transfer);
+        if (!in.leanCascades) {
+          pass.read(cascadeBuffers, Access::Transfer);
+        }
+        pass.write(screen, Access::Transfer);
+        return [&flatland, windowSize] { flatland.blitToScreen(windowSize); };
+      });
+      break;
+    }
+    }
+  };
+
+  // What culling and aliasing save in each mode, with the settings at
+  // startup. Only planned, nothing runs
+  for (auto mode : {RenderMode::Triangle, RenderMode::JFA, RenderMode::Distance,
+                    RenderMode::Naive, RenderMode::RadianceCascades}) {
+    buildGraph(graphInputs(mode, oldWindowSize));
+    graph.compile();
+    const auto& stats = graph.stats();
+    constexpr double MB = 1024.0 * 1024.0;
+    Logger::info("{} graph: {} of {} passes, peak VRAM {:.1f} MB ({:.1f} MB "
+                 "without culling or aliasing)",
+                 mode, stats.passes - stats.culled, stats.passes,
+                 static_cast<double>(stats.peakBytes) / MB,
+                 static_cast<double>(stats.unaliasedBytes) / MB);
+  }
+
+  InputLatency latency;
+  // Created once the rest set their callbacks, it takes them over
+  std::optional<RenderThread> renderThread;
+
+  // Everything after starting the GUI frame, on whichever thread owns the
+  // context
+  auto renderFrame = [&](const gl::Window::Size& windowSize) {
+    profiler.beginFrame();
+    uploadRing.beginFrame();
+    stateCache.beginFrame();
+    if (auto saved = drawing.pollSave(); saved.has_value()) {
+      sceneStatus = *saved ? fmt::format("Saved {}", SCENE_PATH)
+                           : fmt::format("Failed to save {}", SCENE_PATH);
+    }
+    if (auto settings = governor.update(profiler); settings.has_value()) {
+      applyQuality(*settings);
     }
-    gui.newFrame();
     input.imGuiWantsMouse(gui.io().WantCaptureMouse);
     input.imGuiWantsKeyboard(gui.io().WantCaptureKeyboard);
 
@@ -159,10 +508,16 @@ int main() {
         ImGui::Text("Brush Settings");
         ImGui::ColorEdit3("Brush Color", &drawing.brushColor().r);
         ImGui::SliderFloat("Brush Radius", &drawing.brushRadius(), 1.f, 20.f);
+        ImGui::TextDisabled("(%zu segments in the last stroke batch)",
+                            drawing.lastSegments());
 
         ImGui::Separator();
         ImGui::Text("Raymarch Settings");
         ImGui::SliderInt("JFA Passes", (int*)&jfa.passes(), 0, jfa.maxPasses());
+        ImGui::Checkbox("CPU JFA", &useCpuJfa);
+        ImGui::BeginDisabled(useCpuJfa || !jfa.computeSupported());
+        ImGui::Checkbox("Compute JFA", &jfa.compute());
+        ImGui::EndDisabled();
 
         if (renderMode != RenderMode::JFA &&
             renderMode != RenderMode::Distance) {
@@ -171,70 +526,441 @@ int main() {
             flatland.updateMaxCascades(fsize);
           }
           ImGui::SliderInt("Max Steps", (int*)&maxSteps, 1, 64);
-
-          if (renderMode != RenderMode::Naive) {
+          ImGui::BeginDisabled(!flatland.canSpecialize() ||
+                               !naive.canSpecialize());
+          if (ImGui::Checkbox("Specialized shaders",
+                              &flatland.specialized())) {
+            naive.specialized() = flatland.specialized();
+          }
+          ImGui::EndDisabled();
+          ImGui::SameLine();
+          ImGui::TextDisabled("(SPIR-V, rays and steps are constants)");
+          if (ImGui::Checkbox("Compiled variants", &flatland.variants())) {
+            naive.variants() = flatland.variants();
+          }
+          ImGui::SameLine();
+          ImGui::TextDisabled(flatland.hasVariant() ? "(one matches)"
+                                                    : "(none match)");
+
+          if (renderMode == RenderMode::Naive) {
+            ImGui::Checkbox("Accumulate", &naive.accumulate());
+            ImGui::SameLine();
+            ImGui::TextDisabled("(new noise each frame, blended over time)");
+            if (naive.accumulate()) {
+              ImGui::SliderInt("Target rays", (int*)&naive.targetRays(), 4,
+                               1024);
+              ImGui::Text("Accumulated %u of %u frames",
+                          naive.accumulatedFrames(),
+                          naive.convergenceFrames());
+            }
+          } else {
             ImGui::SliderInt("Cascade", (int*)&flatland.cascadeIndex(), 0,
                              flatland.maxCascades() - 1);
+            ImGui::Checkbox("Pre-averaged merge", &flatland.preAveraged());
+            ImGui::SameLine();
+            ImGui::TextDisabled("(one upper sample per ray group)");
+
+            ImGui::Text("Probe spacing");
+            for (uint32_t spacing : FlatlandRc::PROBE_SPACINGS) {
+              ImGui::SameLine();
+              auto label = fmt::format("{} px", spacing);
+              if (ImGui::RadioButton(label.c_str(),
+                                     flatland.probeSpacing() == spacing)) {
+                flatland.setProbeSpacing(spacing, fsize);
+              }
+            }
           }
         }
 
         if (ImGui::Button("Clear Drawing")) {
-          glClearNamedFramebufferiv(drawing.fbo().id(), GL_COLOR, 0,
-                                    (GLint*)&clearColor);
+          drawing.clear(clearColor);
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(drawing.saving());
+        if (ImGui::Button("Save Scene")) {
+          drawing.save(SCENE_PATH);
+          sceneStatus = "Saving...";
+        }
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (ImGui::Button("Load Scene")) {
+          auto start = std::chrono::steady_clock::now();
+          auto scene = SceneFile::open(SCENE_PATH);
+          if (scene.has_value() && drawing.load(*scene)) {
+            std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+            sceneStatus = fmt::format(
+                "Loaded {}x{}, {} KB, {} of {} tiles RLE, {:.1f} ms",
+                scene->size().width, scene->size().height,
+                scene->fileBytes() / 1024, scene->rleTiles(), scene->tiles(),
+                elapsed.count());
+          } else {
+            sceneStatus = fmt::format("Failed to load {}", SCENE_PATH);
+          }
+        }
+        if (!sceneStatus.empty()) {
+          ImGui::TextDisabled("%s", sceneStatus.c_str());
         }
       }
-    }
-#pragma endregion
 
-    if (renderMode == RenderMode::Triangle) {
-      triangle.draw();
-    } else {
-      auto size = window.size();
+      ImGui::Separator();
+      if (ImGui::CollapsingHeader("Caching")) {
+        ImGui::Checkbox("Cache passes", &cachePasses);
+        ImGui::SameLine();
+        if (ImGui::Button("Reset stats")) {
+          jfa.cache().resetStats();
+          flatland.cache().resetStats();
+        }
+        ImGui::Text("JFA hits: %.1f%%", jfa.cache().hitRate() * 100.0);
+        ImGui::Text("Cascade hits: %.1f%%",
+                    flatland.cache().hitRate() * 100.0);
+
+        if (ImGui::Checkbox("Incremental JFA", &jfa.incremental())) {
+          jfa.cache().invalidate();
+        }
+        if (ImGui::Checkbox("Incremental cascades",
+                            &flatland.incremental())) {
+          flatland.cache().invalidate();
+        }
+        ImGui::Checkbox("Verify against full update", &verifyIncremental);
+        if (verifyIncremental) {
+          ImGui::SameLine();
+          if (ImGui::Button("Reset")) {
+            incrementalCheck.reset();
+          }
+          const auto& last = incrementalCheck.last();
+          const auto& worst = incrementalCheck.worst();
+          ImGui::Text("Distance max error: %.6f (worst %.6f)",
+                      last.distanceMaxError, worst.distanceMaxError);
+          if (last.cascades.has_value() && worst.cascades.has_value()) {
+            ImGui::Text("Cascade RMSE: %.6f (worst %.6f)",
+                        last.cascades->rmse, worst.cascades->rmse);
+            ImGui::Text("Cascade max error: %.6f", last.cascades->maxAbs);
+          }
+        }
+      }
 
-      // Handle window resize
-      if (size != oldWindowSize) {
-        Logger::info("Window resize: {}x{}", size.width, size.height);
-        oldWindowSize = size;
-        fsize = {static_cast<float>(oldWindowSize.width),
-                 static_cast<float>(oldWindowSize.height)};
+      if (ImGui::CollapsingHeader("Quality Governor")) {
+        bool enabled = governor.enabled();
+        if (ImGui::Checkbox("Hold frame budget", &enabled)) {
+          governor.setEnabled(enabled);
+          if (enabled) {
+            applyQuality(governor.settings());
+          }
+        }
+        if (!profiler.enabled()) {
+          ImGui::SameLine();
+          ImGui::TextDisabled("(needs GPU profiling)");
+        }
+        float budget = static_cast<float>(governor.budgetMs());
+        if (ImGui::SliderFloat("Budget (ms)", &budget, 1.f, 33.f, "%.1f")) {
+          governor.budgetMs() = budget;
+        }
 
-        drawing.resize(size);
-        jfa.resize(size);
+        auto bounds = governor.bounds();
+        bool changed = false;
+        changed |= ImGui::SliderInt("Min rays", (int*)&bounds.minRayCount, 4,
+                                    64);
+        changed |= ImGui::SliderInt("Max rays", (int*)&bounds.maxRayCount, 4,
+                                    64);
+        changed |= ImGui::SliderInt("Min steps", (int*)&bounds.minSteps, 1, 64);
+        changed |= ImGui::SliderInt("Max steps", (int*)&bounds.maxSteps, 1, 64);
+        changed |= ImGui::SliderInt("Min JFA passes",
+                                    (int*)&bounds.minJfaPasses, 0,
+                                    jfa.maxPasses());
+        changed |= ImGui::SliderInt("Max JFA passes",
+                                    (int*)&bounds.maxJfaPasses, 0,
+                                    jfa.maxPasses());
+        changed |= ImGui::SliderInt("Max probe spacing",
+                                    (int*)&bounds.maxProbeSpacing, 1,
+                                    FlatlandRc::PROBE_SPACINGS.back());
+        if (changed) {
+          const auto& settings = governor.setBounds(bounds);
+          if (governor.enabled()) {
+            applyQuality(settings);
+          }
+        }
+
+        ImGui::Text("Level %zu of %zu, p90 %.2f ms", governor.level() + 1,
+                    governor.levels(), governor.lastP90());
+        ImGui::Text("Calm windows to raise: %u",
+                    governor.requiredCalmWindows());
       }
 
-      drawing.draw(input, fsize);
+      if (ImGui::CollapsingHeader("Memory")) {
+        ImGui::Checkbox("Lean cascade storage", &flatland.lean());
+        ImGui::SameLine();
+        ImGui::TextDisabled("(two buffers while cascade 0 is shown)");
+
+        auto bytes = [&](uint32_t buffers) {
+          return static_cast<double>(
+                     formats
+                         .footprint(oldWindowSize, 0, flatland.maxCascades(),
+                                    buffers, 0, 0, flatland.probeSpacing())
+                         .vramBytes) /
+                 (1024.0 * 1024.0);
+        };
+        double current = bytes(flatland.cascadeBuffers());
+        double full = bytes(flatland.maxCascades());
+        ImGui::Text("Cascade buffers: %u", flatland.cascadeBuffers());
+        ImGui::Text("VRAM: %.1f MB (%.1f MB with every cascade kept)",
+                    current, full);
+
+        auto pool = texturePool.stats();
+        ImGui::Text("Texture pool: %zu targets, %.1f MB", pool.targets,
+                    static_cast<double>(pool.bytes) / (1024.0 * 1024.0));
+        ImGui::Text("Created %llu, reused %llu, evicted %llu",
+                    static_cast<unsigned long long>(pool.created),
+                    static_cast<unsigned long long>(pool.reused),
+                    static_cast<unsigned long long>(pool.evicted));
+      }
 
-      jfa.draw(drawing.texture(), size, fsize);
+      if (ImGui::CollapsingHeader("Render Graph")) {
+        const auto& stats = graph.stats();
+        graph.forEachPass([](std::string_view name, bool live) {
+          ImGui::BulletText("%.*s", static_cast<int>(name.size()),
+                            name.data());
+          if (!live) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(culled)");
+          }
+        });
+        constexpr double MB = 1024.0 * 1024.0;
+        ImGui::Text("%u of %u passes, %u textures, %u transient",
+                    stats.passes - stats.culled, stats.passes,
+                    stats.textures, stats.transients);
+        ImGui::Text("Peak VRAM: %.1f MB (%.1f MB without culling or "
+                    "aliasing)",
+                    static_cast<double>(stats.peakBytes) / MB,
+                    static_cast<double>(stats.unaliasedBytes) / MB);
+        ImGui::Text("Barriers: %u", stats.barriers);
+      }
 
-      switch (renderMode) {
-      case RenderMode::JFA: {
-        jfa.blitToMain(size);
-        break;
+      if (ImGui::CollapsingHeader("Texture Formats")) {
+        bool changed = false;
+        changed |= formatCombo("Scene", formats.scene, TextureFormats::SCENES);
+        changed |= formatCombo("Seeds", formats.seed, TextureFormats::SEEDS);
+        changed |= formatCombo("Distance", formats.distance,
+                               TextureFormats::DISTANCES);
+        changed |= formatCombo("Cascades", formats.cascade,
+                               TextureFormats::CASCADES);
+        if (changed) {
+          drawing.setFormats(formats);
+          jfa.setFormats(formats, oldWindowSize);
+          flatland.setFormats(formats, fsize);
+        }
+        if (!jfa.computeSupported()) {
+          ImGui::TextDisabled("Compute JFA needs RGBA32F seeds");
+        }
+
+        auto footprint = formats.footprint(
+            oldWindowSize, jfa.passes(), flatland.maxCascades(),
+            flatland.cascadeBuffers(), rayCount, maxSteps,
+            flatland.probeSpacing());
+        auto baseline = TextureFormats{}.footprint(
+            oldWindowSize, jfa.passes(), flatland.maxCascades(),
+            flatland.cascadeBuffers(), rayCount, maxSteps,
+            flatland.probeSpacing());
+        constexpr double MB = 1024.0 * 1024.0;
+        ImGui::Text("VRAM: %.1f MB (saves %.1f MB)",
+                    static_cast<double>(footprint.vramBytes) / MB,
+                    static_cast<double>(baseline.vramBytes -
+                                        footprint.vramBytes) /
+                        MB);
+        ImGui::Text("Texel traffic per update: %.0f MB (saves %.0f MB)",
+                    static_cast<double>(footprint.trafficBytes) / MB,
+                    static_cast<double>(baseline.trafficBytes -
+                                        footprint.trafficBytes) /
+                        MB);
       }
-      case RenderMode::Distance: {
-        jfa.blitDistanceToMain(size);
-        break;
+
+      if (ImGui::CollapsingHeader("Latency")) {
+        ImGui::Text("%s", threaded ? "Rendering on a separate thread"
+                                   : "Rendering on the main thread");
+        ImGui::SameLine();
+        ImGui::TextDisabled("(--threaded)");
+        ImGui::Text("Input to swap: %.2f ms mean, %.2f ms p95",
+                    latency.meanMs(), latency.p95Ms());
+        if (renderThread.has_value()) {
+          ImGui::Text("Dropped window events: %llu",
+                      static_cast<unsigned long long>(renderThread->dropped()));
+        }
       }
-      case RenderMode::Naive: {
-        naive.draw(drawing.texture(), jfa.distanceResult().texture, fsize);
-        break;
+
+      if (ImGui::CollapsingHeader("GPU Timings")) {
+        ImGui::Checkbox("Profile", &profiler.enabled());
+        ImGui::SameLine();
+        if (ImGui::Button("Dump CSV")) {
+          profiler.dumpCsv("gpu_timings.csv");
+        }
+
+        if (ImGui::BeginTable("GPU Timings", 3,
+                              ImGuiTableFlags_Borders |
+                                  ImGuiTableFlags_RowBg)) {
+          ImGui::TableSetupColumn("Pass");
+          ImGui::TableSetupColumn("Last (ms)");
+          ImGui::TableSetupColumn("Avg (ms)");
+          ImGui::TableHeadersRow();
+          for (const auto& timing : profiler.timings()) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%*s%s", static_cast<int>(timing.depth * 2), "",
+                        timing.label.c_str());
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.lastMs);
+            ImGui::TableNextColumn();
+            ImGui::Text("%.3f", timing.avgMs);
+          }
+          ImGui::EndTable();
+        }
+        ImGui::Text("Dropped frames: %llu",
+                    static_cast<unsigned long long>(profiler.droppedFrames()));
+        ImGui::Text("Uniform uploads: %u / %u bytes, %llu stalls",
+                    uploadRing.used(), uploadRing.regionSize(),
+                    static_cast<unsigned long long>(uploadRing.stalls()));
+        ImGui::Checkbox("Skip redundant binds", &stateCache.enabled());
+        ImGui::Text("Binds: %llu issued, %llu skipped",
+                    static_cast<unsigned long long>(
+                        stateCache.lastFrame().issued),
+                    static_cast<unsigned long long>(
+                        stateCache.lastFrame().elided));
       }
-      case RenderMode::RadianceCascades: {
-        flatland.draw(drawing.texture(), jfa.distanceResult().texture, fsize);
-        flatland.blitToScreen(size);
-        break;
+    }
+#pragma endregion
+
+    {
+      auto frameTimer = profiler.scope("Frame");
+      if (renderMode != RenderMode::Triangle) {
+        // Handle window resize
+        auto now = std::chrono::steady_clock::now();
+        if (windowSize != pendingSize) {
+          pendingSize = windowSize;
+          resizeAt = now + RESIZE_DEBOUNCE;
+        }
+        if (pendingSize != oldWindowSize && now >= resizeAt) {
+          Logger::info("Window resize: {}x{}", pendingSize.width,
+                       pendingSize.height);
+          oldWindowSize = pendingSize;
+          fsize = {static_cast<float>(oldWindowSize.width),
+                   static_cast<float>(oldWindowSize.height)};
+
+          drawing.resize(oldWindowSize);
+          jfa.resize(oldWindowSize);
+          flatland.resize(oldWindowSize);
+        }
+
+        // Until then the passes keep their old size, and the results are
+        // stretched over the window
+        glViewport(0, 0, oldWindowSize.width, oldWindowSize.height);
       }
-      case RenderMode::Triangle: {
-        std::unreachable();
-        break;
+
+      if (auto inputs = graphInputs(renderMode, windowSize);
+          graphCache.needsUpdate(inputs)) {
+        buildGraph(inputs);
+        graph.compile();
       }
+      graph.execute();
+
+      // The check compares the distance field, which only exists while
+      // something reads it
+      if (verifyIncremental && graph.live("Distance")) {
+        incrementalCheck.compare(drawing, jfa,
+                                 graph.live("Cascades") ? &flatland : nullptr,
+                                 oldWindowSize, formats);
       }
     }
 
-    input.frameEnd();
-    gui.endFrame();
+    {
+      auto timer = profiler.scope("ImGui");
+      gui.endFrame();
+    }
+    stateCache.endFrame();
+    uploadRing.endFrame();
+    profiler.endFrame();
     window.swapBuffers();
+    latency.record(input.events(), glfwGetTime());
+    input.frameEnd();
+  };
+
+  if (threaded) {
+    Logger::info("Rendering on a separate thread");
+    auto windowSize = window.size();
+    auto framebufferSize = window.framebufferSize();
+    renderThread.emplace(window);
+    renderThread->start([&] {
+      bool iconified = false;
+      double lastFrame = glfwGetTime();
+      WindowEvent event;
+      while (renderThread->running()) {
+        while (renderThread->pop(event)) {
+          switch (event.type) {
+          case WindowEvent::Type::CursorMove:
+            gui.addMousePos(event.value.x, event.value.y);
+            input.onMouseMove(event.value.x, event.value.y, event.time);
+            break;
+          case WindowEvent::Type::MouseButton:
+            gui.addMouseButton(event.code, event.action == GLFW_PRESS);
+            input.onMouseButton(event.code, event.action, event.time);
+            break;
+          case WindowEvent::Type::Key:
+            gui.addKey(event.code, event.mods, event.action != GLFW_RELEASE);
+            input.onKeyEvent(event.code, event.action, event.time);
+            break;
+          case WindowEvent::Type::Char:
+            gui.addChar(static_cast<unsigned int>(event.code));
+            break;
+          case WindowEvent::Type::Scroll:
+            gui.addScroll(event.value.x, event.value.y);
+            break;
+          case WindowEvent::Type::Resize:
+            windowSize = {static_cast<int>(event.value.x),
+                          static_cast<int>(event.value.y)};
+            framebufferSize = event.framebuffer;
+            break;
+          case WindowEvent::Type::Iconify:
+            iconified = event.code != 0;
+            break;
+          case WindowEvent::Type::Focus:
+            gui.addFocus(event.code != 0);
+            break;
+          }
+        }
+        if (iconified) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(10));
+          continue;
+        }
+
+        double now = glfwGetTime();
+        gui.newFrame(windowSize, framebufferSize,
+                     static_cast<float>(now - lastFrame));
+        lastFrame = now;
+        renderFrame(windowSize);
+      }
+    });
+
+    // Never blocks on the GPU, events are forwarded as soon as they arrive
+    while (!window.shouldClose()) {
+      gl::Window::waitEvents();
+    }
+    renderThread->stop();
+  } else {
+    while (!window.shouldClose()) {
+      gl::Window::pollEvents();
+      if (glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0) {
+        gui.sleep(10);
+        continue;
+      }
+      gui.newFrame();
+      renderFrame(window.size());
+    }
   }
 
+  Logger::info("Input to swap latency ({}): {:.2f} ms mean, {:.2f} ms p95 "
+               "over the last {} frames with input",
+               threaded ? "render thread" : "single thread", latency.meanMs(),
+               latency.p95Ms(), latency.frames());
+
+  // A save still in flight is finished before the context goes away
+  drawing.pollSave(true);
   return 0;
 }
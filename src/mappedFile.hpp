@@ -0,0 +1,147 @@
+#pragma once
+
+#include "logger.hpp"
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Read-only memory mapping of a whole file, unmapped when destroyed. Pages
+/// are only read from disk once touched.
+/// </summary>
+class MappedFile {
+  const std::byte* m_data = nullptr;
+  size_t m_size = 0;
+#ifdef _WIN32
+  HANDLE m_file = INVALID_HANDLE_VALUE;
+  HANDLE m_mapping = nullptr;
+#endif
+
+  MappedFile() = default;
+
+  void close() {
+#ifdef _WIN32
+    if (m_data != nullptr) {
+      UnmapViewOfFile(m_data);
+    }
+    if (m_mapping != nullptr) {
+      CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+      CloseHandle(m_file);
+    }
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != nullptr) {
+      munmap(const_cast<std::byte*>(m_data), m_size);
+    }
+#endif
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+public:
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&& other) noexcept
+      : m_data(std::exchange(other.m_data, nullptr)),
+        m_size(std::exchange(other.m_size, 0))
+#ifdef _WIN32
+        ,
+        m_file(std::exchange(other.m_file, INVALID_HANDLE_VALUE)),
+        m_mapping(std::exchange(other.m_mapping, nullptr))
+#endif
+  {
+  }
+  MappedFile& operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      close();
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+      m_file = std::exchange(other.m_file, INVALID_HANDLE_VALUE);
+      m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+    return *this;
+  }
+
+  static std::optional<MappedFile> open(std::string_view path) {
+    MappedFile file;
+    std::string pathStr(path);
+#ifdef _WIN32
+    file.m_file = CreateFileA(pathStr.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING,
+                              FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER size{};
+    if (file.m_file == INVALID_HANDLE_VALUE ||
+        !GetFileSizeEx(file.m_file, &size)) {
+      Logger::error("Failed to open {}", path);
+      return std::nullopt;
+    }
+    file.m_size = static_cast<size_t>(size.QuadPart);
+    if (file.m_size == 0) {
+      return file;
+    }
+    file.m_mapping = CreateFileMappingA(file.m_file, nullptr, PAGE_READONLY,
+                                        0, 0, nullptr);
+    if (file.m_mapping != nullptr) {
+      file.m_data = static_cast<const std::byte*>(
+          MapViewOfFile(file.m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (file.m_data == nullptr) {
+      Logger::error("Failed to map {}", path);
+      return std::nullopt;
+    }
+#else
+    int fd = ::open(pathStr.c_str(), O_RDONLY);
+    struct stat info{};
+    if (fd < 0 || fstat(fd, &info) != 0) {
+      Logger::error("Failed to open {}", path);
+      if (fd >= 0) {
+        ::close(fd);
+      }
+      return std::nullopt;
+    }
+    file.m_size = static_cast<size_t>(info.st_size);
+    if (file.m_size == 0) {
+      ::close(fd);
+      return file;
+    }
+    void* data = mmap(nullptr, file.m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps the file open
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      Logger::error("Failed to map {}", path);
+      file.m_size = 0;
+      return std::nullopt;
+    }
+    // Tiles are read front to back
+    madvise(data, file.m_size, MADV_SEQUENTIAL);
+    file.m_data = static_cast<const std::byte*>(data);
+#endif
+    return file;
+  }
+
+  std::span<const std::byte> bytes() const { return {m_data, m_size}; }
+  size_t size() const { return m_size; }
+};
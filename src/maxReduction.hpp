@@ -0,0 +1,117 @@
+#pragma once
+
+#include "logger.hpp"
+#include <cstdint>
+#include <cstring>
+#include <gl/gl.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <utility>
+
+/// <summary>
+/// Largest value of the first channel of a texture, reduced on the GPU into
+/// a persistently mapped buffer. The result is only read once a fence says
+/// the dispatch is done, so asking for it never waits on the GPU.
+/// </summary>
+class MaxReduction {
+  gl::Program m_program;
+  gl::StorageBuffer m_buffer;
+  const uint32_t* m_mapping = nullptr;
+  GLsync m_fence = nullptr;
+
+  explicit MaxReduction(gl::Program&& program)
+      : m_program(std::move(program)),
+        m_buffer(sizeof(uint32_t), nullptr,
+                 gl::Buffer::UsageBitFlag(gl::Buffer::Usage::READ) |
+                     gl::Buffer::Usage::PERSISTENT |
+                     gl::Buffer::Usage::COHERENT) {
+    m_mapping = static_cast<const uint32_t*>(m_buffer.map(
+        gl::Buffer::Mapping::READ | gl::Buffer::Mapping::PERSISTENT |
+        gl::Buffer::Mapping::COHERENT));
+  }
+
+public:
+  struct Params {
+    glm::ivec2 size;
+  };
+
+  /// Workgroup size of distance_max
+  static constexpr GLuint GROUP_SIZE = 16;
+
+  ~MaxReduction() { cancel(); }
+
+  MaxReduction(const MaxReduction&) = delete;
+  MaxReduction& operator=(const MaxReduction&) = delete;
+  MaxReduction(MaxReduction&& other) noexcept
+      : m_program(std::move(other.m_program)),
+        m_buffer(std::move(other.m_buffer)),
+        m_mapping(std::exchange(other.m_mapping, nullptr)),
+        m_fence(std::exchange(other.m_fence, nullptr)) {}
+  MaxReduction& operator=(MaxReduction&&) = delete;
+
+  static std::optional<MaxReduction> create() {
+    auto programOpt = gl::Program::fromFiles(
+        {{"distance_max_comp.glsl", gl::Shader::COMPUTE}});
+    if (!programOpt.has_value()) {
+      Logger::error("Failed to load distance max program: {}",
+                    programOpt.error());
+      return std::nullopt;
+    }
+    return MaxReduction(std::move(programOpt.value()));
+  }
+
+  bool pending() const { return m_fence != nullptr; }
+
+  /// <summary>
+  /// Queues the reduction of <paramref name="texture"/>, replacing one still
+  /// pending. Values must not be negative.
+  /// </summary>
+  void start(const gl::Texture& texture, const gl::Window::Size& size) {
+    cancel();
+    constexpr uint32_t zero = 0;
+    glClearNamedBufferSubData(m_buffer.id(), GL_R32UI, 0, sizeof(uint32_t),
+                              GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    m_program.bind();
+    texture.bind(0);
+    m_buffer.bindBase(gl::StorageBuffer::Target::STORAGE, 0);
+    gl::UploadRing::get().bindUniform(
+        Params{.size = {size.width, size.height}}, 0);
+    auto groups = [](GLsizei extent) {
+      return (static_cast<GLuint>(extent) + GROUP_SIZE - 1) / GROUP_SIZE;
+    };
+    glDispatchCompute(groups(size.width), groups(size.height), 1);
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
+
+  /// <summary>
+  /// The result once the GPU is done with it, handed out once. Empty while
+  /// pending or if nothing was started.
+  /// </summary>
+  std::optional<float> poll() {
+    if (!pending()) {
+      return std::nullopt;
+    }
+    GLenum status = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return std::nullopt;
+    }
+    glDeleteSync(m_fence);
+    m_fence = nullptr;
+    if (status == GL_WAIT_FAILED) {
+      Logger::error("Waiting for the distance max reduction failed");
+      return std::nullopt;
+    }
+    float value = 0.f;
+    std::memcpy(&value, m_mapping, sizeof(value));
+    return value;
+  }
+
+  /// Forgets a pending reduction, its result is never read
+  void cancel() {
+    if (m_fence != nullptr) {
+      glDeleteSync(m_fence);
+      m_fence = nullptr;
+    }
+  }
+};
@@ -1,5 +1,10 @@
 #pragma once
 
+#include "flipFlops.hpp"
+#include "shaderVariants.hpp"
+#include "texturePool.hpp"
+#include <algorithm>
+#include <array>
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
 #include <optional>
@@ -7,29 +12,126 @@
 class NaiveRaymarch {
   const gl::Vao& m_fullscreenVao;
   gl::Program m_program;
-  gl::StorageBuffer m_paramsUbo;
-  void* m_paramsMapping;
+  // SPIR-V build of the program, empty if it can't be loaded
+  std::optional<gl::SpecializedPrograms> m_specializedPrograms;
+  // Draw with the program specialized for the current ray count and steps
+  bool m_specialized = false;
+  // Programs compiled for common ray counts and steps
+  ShaderVariants m_variantPrograms{"naive"};
+  bool m_variants = true;
+
+  TexturePool& m_pool;
 
   const uint32_t& m_rayCount;
   const uint32_t& m_maxSteps;
 
+  /// Everything that makes the accumulated image stale when it changes
+  struct AccumulationInputs {
+    uint64_t sceneVersion;
+    uint64_t distanceVersion;
+    uint32_t rayCount;
+    uint32_t maxSteps;
+    glm::vec2 size;
+
+    bool operator==(const AccumulationInputs&) const = default;
+  };
+
+  bool m_accumulate = false;
+  // Rays per pixel the accumulation converges to, spread over as many frames
+  // as the ray count needs
+  uint32_t m_targetRays = 128;
+  // Frames in the history since the last reset
+  uint32_t m_accumulated = 0;
+  // Seeds the noise, never reset so frames keep tracing new directions
+  uint32_t m_frame = 0;
+  std::optional<AccumulationInputs> m_accumulationInputs = std::nullopt;
+  // Read from one and written to the other, allocated once accumulating
+  FlipFlops m_history{};
+  gl::Window::Size m_historySize{0, 0};
+  uint32_t m_historyIndex = 0;
+
+  static constexpr GLenum HISTORY_FORMAT = GL_RGBA16F;
+
   NaiveRaymarch(const gl::Vao& fullscreenVao, gl::Program&& naiveProgram,
-                gl::StorageBuffer&& paramsUbo, void* paramsMapping,
-                const uint32_t& rayCount, const uint32_t& maxSteps)
+                std::optional<gl::SpecializedPrograms>&& specializedPrograms,
+                TexturePool& pool, const uint32_t& rayCount,
+                const uint32_t& maxSteps)
       : m_fullscreenVao(fullscreenVao), m_program(std::move(naiveProgram)),
-        m_paramsUbo(std::move(paramsUbo)), m_paramsMapping(paramsMapping),
+        m_specializedPrograms(std::move(specializedPrograms)), m_pool(pool),
         m_rayCount(rayCount), m_maxSteps(maxSteps) {}
 
+  void drawPass(const gl::Texture& drawTexture, const gl::Texture& jfaTexture,
+                glm::vec2 fsize, uint32_t frame, float blend) {
+    drawTexture.bind(0);
+    jfaTexture.bind(1);
+    m_fullscreenVao.bind();
+    drawProgram().bind();
+
+    NaiveParams nparams{
+        .resolution = {fsize.x, fsize.y},
+        .rayCount = m_rayCount,
+        .maxSteps = m_maxSteps,
+        .frame = frame,
+        .blend = blend,
+    };
+
+    gl::UploadRing::get().bindUniform(nparams, 0);
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  const gl::Program& drawProgram() {
+    if (!m_specialized || !m_specializedPrograms.has_value()) {
+      const gl::Program* variant =
+          m_variants ? m_variantPrograms.get(m_rayCount, m_maxSteps) : nullptr;
+      return variant != nullptr ? *variant : m_program;
+    }
+    std::array<gl::Specialization, 2> values{{
+        {SPEC_RAY_COUNT, m_rayCount},
+        {SPEC_MAX_STEPS, m_maxSteps},
+    }};
+    const gl::Program* program = m_specializedPrograms->get(values);
+    return program != nullptr ? *program : m_program;
+  }
+
 public:
+  /// constant_id of each specialization constant in naive.slang
+  enum SpecConstant : GLuint {
+    SPEC_RAY_COUNT = 0,
+    SPEC_MAX_STEPS = 1,
+  };
+
   struct NaiveParams {
     glm::vec2 resolution;
     uint32_t rayCount;
     uint32_t maxSteps;
+    uint32_t frame;
+    // Weight of the new frame against the history, 1 ignores the history
+    float blend;
   };
 
   const gl::Program& program() const { return m_program; }
+  bool& specialized() { return m_specialized; }
+  bool& variants() { return m_variants; }
+  bool canSpecialize() const { return m_specializedPrograms.has_value(); }
+
+  bool& accumulate() { return m_accumulate; }
+  uint32_t& targetRays() { return m_targetRays; }
+  uint32_t accumulatedFrames() const { return m_accumulated; }
+  /// Frames averaged with equal weight before the history decays
+  uint32_t convergenceFrames() const {
+    return std::max<uint32_t>(
+        1, (m_targetRays + m_rayCount - 1) / std::max<uint32_t>(m_rayCount, 1));
+  }
+  /// Starts the accumulation over on the next frame
+  void resetHistory() { m_accumulationInputs.reset(); }
+  /// Key of the two history buffers at <paramref name="size"/>
+  static TexturePool::Key historyKey(const gl::Window::Size& size) {
+    return {HISTORY_FORMAT, size};
+  }
 
   static std::optional<NaiveRaymarch> create(const gl::Vao& fullscreenVao,
+                                             TexturePool& pool,
                                              const uint32_t& rayCount,
                                              const uint32_t& maxSteps) {
     auto naiveProgramOpt =
@@ -42,35 +144,78 @@ public:
     }
     auto& naiveProgram = naiveProgramOpt.value();
 
-    gl::StorageBuffer paramsUbo(
-        sizeof(NaiveParams), nullptr,
-        gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-            gl::Buffer::Usage::PERSISTENT | gl::Buffer::Usage::COHERENT);
+    auto specializedPrograms = gl::SpecializedPrograms::fromFile(
+        "naive_specialized.spv",
+        {{"vert", gl::Shader::VERTEX}, {"frag", gl::Shader::FRAGMENT}});
 
-    auto paramsMapping = paramsUbo.map(gl::Buffer::Mapping::WRITE |
-                                       gl::Buffer::Mapping::PERSISTENT |
-                                       gl::Buffer::Mapping::COHERENT);
     return NaiveRaymarch(fullscreenVao, std::move(naiveProgram),
-                         std::move(paramsUbo), paramsMapping, rayCount,
+                         std::move(specializedPrograms), pool, rayCount,
                          maxSteps);
   }
 
   void draw(const gl::Texture& drawTexture, const gl::Texture& jfaTexture,
             glm::vec2 fsize) {
-    drawTexture.bind(0);
-    jfaTexture.bind(1);
-    m_fullscreenVao.bind();
-    m_program.bind();
+    auto timer = gl::GpuProfiler::get().scope("Naive");
+    drawPass(drawTexture, jfaTexture, fsize, 0, 1.f);
+  }
 
-    NaiveParams nparams{
-        .resolution = {fsize.x, fsize.y},
-        .rayCount = m_rayCount,
-        .maxSteps = m_maxSteps,
-    };
+  /// <summary>
+  /// Draws a frame with fresh noise into the history and blends it with
+  /// the frames before. They are averaged evenly until the target ray count
+  /// is reached, then decay exponentially. Any change to the scene, distance
+  /// field, ray count, steps or size starts over.
+  /// </summary>
+  void drawAccumulated(const gl::Texture& drawTexture,
+                       const gl::Texture& jfaTexture, glm::vec2 fsize,
+                       uint64_t sceneVersion, uint64_t distanceVersion) {
+    auto timer = gl::GpuProfiler::get().scope("Naive accumulate");
+    gl::Window::Size size{static_cast<int>(fsize.x),
+                          static_cast<int>(fsize.y)};
+    if (size != m_historySize) {
+      m_history = FlipFlops(m_pool, HISTORY_FORMAT, size, 2);
+      m_historySize = size;
+      m_accumulationInputs.reset();
+    }
 
-    memcpy(m_paramsMapping, &nparams, sizeof(NaiveParams));
-    m_paramsUbo.bindBase(gl::StorageBuffer::Target::UNIFORM, 0);
+    AccumulationInputs inputs{.sceneVersion = sceneVersion,
+                              .distanceVersion = distanceVersion,
+                              .rayCount = m_rayCount,
+                              .maxSteps = m_maxSteps,
+                              .size = fsize};
+    if (m_accumulationInputs != inputs) {
+      m_accumulationInputs = inputs;
+      m_accumulated = 0;
+    }
 
-    glDrawArrays(GL_TRIANGLES, 0, 3);
+    // 1 / (n + 1) averages the first frames evenly, after that each frame
+    // keeps the same share
+    uint32_t frames = std::min(m_accumulated, convergenceFrames() - 1);
+    float blend = 1.f / static_cast<float>(frames + 1);
+
+    const TexFbo& previous = m_history[m_historyIndex];
+    m_historyIndex = 1 - m_historyIndex;
+    previous.tex.bind(2);
+    m_history[m_historyIndex].fbo.bind();
+    drawPass(drawTexture, jfaTexture, fsize, m_frame++, blend);
+    gl::Framebuffer::unbind();
+
+    m_accumulated = std::min(m_accumulated + 1, convergenceFrames());
+  }
+
+  /// Shows the accumulated image
+  void blitToScreen(const gl::Window::Size& size) const {
+    auto timer = gl::GpuProfiler::get().scope("Naive blit");
+    m_history[m_historyIndex].fbo.blit(
+        0, 0, 0, m_historySize.width, m_historySize.height, 0, 0, size.width,
+        size.height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  }
+
+  /// Frees the history while not accumulating
+  void releaseHistory() {
+    if (m_historySize.width != 0) {
+      m_history = FlipFlops{};
+      m_historySize = {0, 0};
+      m_accumulationInputs.reset();
+    }
   }
 };
\ No newline at end of file
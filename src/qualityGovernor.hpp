@@ -0,0 +1,251 @@
+#pragma once
+
+#include "logger.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <gl/gl.hpp>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// Holds the GPU frame time under a budget by trading quality for speed.
+/// The settings form a ladder from the best the bounds allow down to the
+/// cheapest, each rung lowering one of steps, rays, cascade 0 resolution or
+/// JFA passes in turn. Every window of frames the 90th percentile frame time
+/// moves it down a rung when over budget, and up one after several windows
+/// well under it.
+///
+/// Stepping down is immediate, stepping up is slow: a rung that had to be
+/// left again right after reaching it needs twice as many calm windows the
+/// next time, so the governor settles instead of oscillating around the
+/// budget. The percentile rather than the mean keeps frames skipped by the
+/// pass caches from hiding the ones that redraw.
+/// </summary>
+class QualityGovernor {
+public:
+  struct Settings {
+    uint32_t rayCount;
+    uint32_t maxSteps;
+    uint32_t jfaPasses;
+    uint32_t probeSpacing;
+
+    bool operator==(const Settings&) const = default;
+  };
+
+  /// Range each setting is kept in, best quality at the max
+  struct Bounds {
+    uint32_t minRayCount = 4;
+    uint32_t maxRayCount = 64;
+    uint32_t minSteps = 8;
+    uint32_t maxSteps = 64;
+    uint32_t minJfaPasses = 1;
+    uint32_t maxJfaPasses = 16;
+    // 1 keeps cascade 0 at full resolution
+    uint32_t maxProbeSpacing = 2;
+  };
+
+  /// Frames measured per decision
+  static constexpr size_t WINDOW = 30;
+  /// Frames ignored after a change, still in flight with the old settings
+  static constexpr uint32_t SETTLE_FRAMES =
+      static_cast<uint32_t>(gl::GpuProfiler::BUFFERED_FRAMES) + 2;
+  /// Share of the budget under which quality may go up
+  static constexpr double RAISE_BELOW = 0.7;
+  static constexpr uint32_t MIN_CALM_WINDOWS = 3;
+  static constexpr uint32_t MAX_CALM_WINDOWS = 48;
+
+private:
+  bool m_enabled = false;
+  double m_budgetMs = 8.0;
+  Bounds m_bounds{};
+
+  std::vector<Settings> m_ladder{};
+  size_t m_level = 0;
+
+  std::vector<double> m_samples{};
+  uint64_t m_lastFrame = 0;
+  uint32_t m_settle = 0;
+  uint32_t m_calmWindows = 0;
+  uint32_t m_requiredCalm = MIN_CALM_WINDOWS;
+  // Rung last reached by going up, to spot it failing
+  std::optional<size_t> m_raisedTo = std::nullopt;
+  double m_lastP90 = 0.0;
+
+  /// One rung cheaper than <paramref name="settings"/>, lowering the
+  /// setting after <paramref name="last"/> that still can be
+  static std::optional<Settings> lower(const Settings& settings,
+                                       const Bounds& bounds, uint32_t& last) {
+    for (uint32_t i = 1; i <= 4; i++) {
+      Settings next = settings;
+      switch ((last + i) % 4) {
+      case 0:
+        next.maxSteps = std::max(bounds.minSteps, settings.maxSteps / 2);
+        break;
+      case 1:
+        // Powers of four keep the cascades' probe grids square
+        if (settings.rayCount / 4 >= bounds.minRayCount) {
+          next.rayCount = settings.rayCount / 4;
+        }
+        break;
+      case 2:
+        // Stays one of FlatlandRc::PROBE_SPACINGS
+        if (settings.probeSpacing * 2 <= bounds.maxProbeSpacing) {
+          next.probeSpacing = settings.probeSpacing * 2;
+        }
+        break;
+      case 3:
+        next.jfaPasses = settings.jfaPasses > bounds.minJfaPasses
+                             ? settings.jfaPasses - 1
+                             : settings.jfaPasses;
+        break;
+      }
+      if (next != settings) {
+        last = (last + i) % 4;
+        return next;
+      }
+    }
+    return std::nullopt;
+  }
+
+  void rebuildLadder() {
+    // The first rung is the best of every range
+    Settings settings{.rayCount = m_bounds.maxRayCount,
+                      .maxSteps = m_bounds.maxSteps,
+                      .jfaPasses = m_bounds.maxJfaPasses,
+                      .probeSpacing = 1};
+    m_ladder.assign(1, settings);
+    uint32_t last = 3;
+    while (auto next = lower(m_ladder.back(), m_bounds, last)) {
+      m_ladder.push_back(*next);
+    }
+  }
+
+  void restartWindow() {
+    m_samples.clear();
+    m_settle = SETTLE_FRAMES;
+  }
+
+  void log(const char* decision, size_t from) const {
+    const auto& settings = m_ladder[m_level];
+    Logger::info("Quality governor: {}, p90 {:.2f} ms of {:.2f} ms, level {} "
+                 "-> {} (rays {}, steps {}, jfa passes {}, probe spacing {})",
+                 decision, m_lastP90, m_budgetMs, from, m_level,
+                 settings.rayCount, settings.maxSteps, settings.jfaPasses,
+                 settings.probeSpacing);
+  }
+
+public:
+  QualityGovernor() { rebuildLadder(); }
+
+  bool enabled() const { return m_enabled; }
+  void setEnabled(bool enabled) {
+    if (enabled != m_enabled) {
+      m_enabled = enabled;
+      restartWindow();
+      Logger::info("Quality governor {}", enabled ? "enabled" : "disabled");
+    }
+  }
+
+  double& budgetMs() { return m_budgetMs; }
+  const Bounds& bounds() const { return m_bounds; }
+
+  /// <summary>
+  /// Replaces the bounds, staying on the rung closest in position to the
+  /// current one. Returns the settings to apply.
+  /// </summary>
+  const Settings& setBounds(const Bounds& bounds) {
+    double position = m_ladder.size() > 1
+                          ? static_cast<double>(m_level) /
+                                static_cast<double>(m_ladder.size() - 1)
+                          : 0.0;
+    m_bounds = bounds;
+    m_bounds.maxRayCount = std::max(m_bounds.maxRayCount, m_bounds.minRayCount);
+    m_bounds.maxSteps = std::max(m_bounds.maxSteps, m_bounds.minSteps);
+    m_bounds.maxJfaPasses =
+        std::max(m_bounds.maxJfaPasses, m_bounds.minJfaPasses);
+    m_bounds.maxProbeSpacing = std::max<uint32_t>(m_bounds.maxProbeSpacing, 1);
+    rebuildLadder();
+    m_level = static_cast<size_t>(
+        position * static_cast<double>(m_ladder.size() - 1) + 0.5);
+    m_raisedTo.reset();
+    m_requiredCalm = MIN_CALM_WINDOWS;
+    restartWindow();
+    return m_ladder[m_level];
+  }
+
+  size_t level() const { return m_level; }
+  size_t levels() const { return m_ladder.size(); }
+  const Settings& settings() const { return m_ladder[m_level]; }
+  double lastP90() const { return m_lastP90; }
+  uint32_t requiredCalmWindows() const { return m_requiredCalm; }
+
+  /// <summary>
+  /// Records the GPU time of the frame timed as <paramref name="timing"/>,
+  /// if a new one was resolved. Returns the settings to switch to when the
+  /// governor changed them.
+  /// </summary>
+  std::optional<Settings> update(const gl::GpuProfiler& profiler,
+                                 std::string_view timing = "Frame") {
+    if (!m_enabled) {
+      return std::nullopt;
+    }
+    auto found = std::ranges::find_if(
+        profiler.timings(), [&](const gl::GpuProfiler::Timing& t) {
+          return t.name == timing && t.index == -1;
+        });
+    if (found == profiler.timings().end() || found->lastFrame == m_lastFrame) {
+      return std::nullopt;
+    }
+    m_lastFrame = found->lastFrame;
+    if (m_settle > 0) {
+      m_settle--;
+      return std::nullopt;
+    }
+    m_samples.push_back(found->lastMs);
+    if (m_samples.size() < WINDOW) {
+      return std::nullopt;
+    }
+
+    auto p90 = m_samples.begin() + (m_samples.size() * 9) / 10;
+    std::nth_element(m_samples.begin(), p90, m_samples.end());
+    m_lastP90 = *p90;
+    m_samples.clear();
+
+    size_t from = m_level;
+    if (m_lastP90 > m_budgetMs) {
+      m_calmWindows = 0;
+      if (m_level + 1 >= m_ladder.size()) {
+        log("over budget at the lowest quality", from);
+        return std::nullopt;
+      }
+      // Far over budget skips a rung
+      size_t rungs = m_lastP90 > m_budgetMs * 1.5 ? 2 : 1;
+      m_level = std::min(m_level + rungs, m_ladder.size() - 1);
+      if (m_raisedTo == from) {
+        // Going up didn't hold, wait longer before trying again
+        m_requiredCalm = std::min(m_requiredCalm * 2, MAX_CALM_WINDOWS);
+      }
+      m_raisedTo.reset();
+      log("over budget, lowering quality", from);
+    } else if (m_lastP90 < m_budgetMs * RAISE_BELOW && m_level > 0) {
+      if (++m_calmWindows < m_requiredCalm) {
+        return std::nullopt;
+      }
+      m_calmWindows = 0;
+      m_level--;
+      m_raisedTo = m_level;
+      log("under budget, raising quality", from);
+    } else {
+      // Within the band, this rung holds
+      m_calmWindows = 0;
+      if (m_raisedTo == m_level) {
+        m_raisedTo.reset();
+        m_requiredCalm = std::max(m_requiredCalm / 2, MIN_CALM_WINDOWS);
+      }
+      return std::nullopt;
+    }
+    restartWindow();
+    return m_ladder[m_level];
+  }
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <gl/window.hpp>
+#include <glad/glad.h>
+
+/// <summary>
+/// Texel rectangle [x0, x1) x [y0, y1), rows bottom to top like GL.
+/// </summary>
+struct Rect {
+  int x0 = 0;
+  int y0 = 0;
+  int x1 = 0;
+  int y1 = 0;
+
+  static Rect full(const gl::Window::Size& size) {
+    return {0, 0, size.width, size.height};
+  }
+
+  int width() const { return std::max(x1 - x0, 0); }
+  int height() const { return std::max(y1 - y0, 0); }
+  bool empty() const { return width() == 0 || height() == 0; }
+  int64_t area() const { return static_cast<int64_t>(width()) * height(); }
+
+  bool covers(const gl::Window::Size& size) const {
+    return x0 <= 0 && y0 <= 0 && x1 >= size.width && y1 >= size.height;
+  }
+
+  Rect expanded(int by) const { return {x0 - by, y0 - by, x1 + by, y1 + by}; }
+
+  /// Smallest rectangle covering this one at 1 / factor the resolution
+  Rect downscaled(int factor) const {
+    auto down = [factor](int value) {
+      return value >= 0 ? value / factor : -((-value + factor - 1) / factor);
+    };
+    auto up = [factor](int value) {
+      return value >= 0 ? (value + factor - 1) / factor : -(-value / factor);
+    };
+    return {down(x0), down(y0), up(x1), up(y1)};
+  }
+
+  Rect clamped(const gl::Window::Size& size) const {
+    return {std::clamp(x0, 0, size.width), std::clamp(y0, 0, size.height),
+            std::clamp(x1, 0, size.width), std::clamp(y1, 0, size.height)};
+  }
+
+  Rect united(const Rect& other) const {
+    if (empty()) {
+      return other;
+    }
+    if (other.empty()) {
+      return *this;
+    }
+    return {std::min(x0, other.x0), std::min(y0, other.y0),
+            std::max(x1, other.x1), std::max(y1, other.y1)};
+  }
+
+  /// Limits draws to this rectangle, the scissor test has to be enabled
+  void scissor() const { glScissor(x0, y0, width(), height()); }
+
+  bool operator==(const Rect&) const = default;
+};
@@ -0,0 +1,376 @@
+#pragma once
+
+#include "texturePool.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <gl/gl.hpp>
+#include <limits>
+#include <string_view>
+#include <vector>
+
+/// <summary>
+/// The passes of a frame and the textures they read and write, declared
+/// before any of them runs. Passes whose results nothing presented depends
+/// on are culled and hand their textures back to the pool. Transient
+/// textures, which only live within the frame, get pool slots so those whose
+/// lifetimes don't overlap share memory. Memory barriers are only issued
+/// between image stores and whatever touches the texture next.
+///
+/// The graph is only declared again when what it depends on changes, every
+/// other frame just executes it. Names aren't copied, they have to outlive
+/// the graph, like literals.
+/// </summary>
+class RenderGraph {
+public:
+  using Handle = uint32_t;
+  using Execute = std::function<void()>;
+  using Release = std::function<void()>;
+
+  /// How a pass touches a texture, which decides the barrier it needs
+  enum class Access : uint8_t {
+    // Sampled in a shader
+    Sample,
+    // Loaded or stored as an image
+    Image,
+    // Drawn to as a framebuffer attachment
+    Attachment,
+    // Blitted, uploaded or read back
+    Transfer,
+  };
+
+  struct Stats {
+    uint32_t passes = 0;
+    uint32_t culled = 0;
+    uint32_t transients = 0;
+    // Textures the live passes hold, shared slots counted once
+    uint32_t textures = 0;
+    // Every declared texture in memory of its own, as without the graph
+    uint64_t unaliasedBytes = 0;
+    // Every texture the live passes hold at once
+    uint64_t peakBytes = 0;
+    // Issued by the last execute()
+    uint32_t barriers = 0;
+  };
+
+private:
+  static constexpr uint32_t NONE = std::numeric_limits<uint32_t>::max();
+
+  struct Use {
+    Handle resource;
+    Access access;
+    bool write;
+  };
+
+  struct Resource {
+    std::string_view name;
+    TexturePool::Key key;
+    // Textures behind the handle, like the two of a flip flop
+    uint32_t count = 1;
+    bool imported = false;
+    bool output = false;
+    bool retained = false;
+
+    // Set by compile()
+    bool needed = false;
+    uint32_t firstPass = NONE;
+    uint32_t lastPass = NONE;
+    uint32_t slot = 0;
+
+    // Barrier bits the next access may still need
+    GLbitfield pending = 0;
+  };
+
+  struct Pass {
+    std::string_view name;
+    std::vector<Use> uses{};
+    Execute execute{};
+    Release release{};
+    bool live = false;
+  };
+
+  std::vector<Resource> m_resources{};
+  std::vector<Pass> m_passes{};
+  Stats m_stats{};
+  // Scratch of compile(), kept so recompiling doesn't allocate
+  std::vector<Handle> m_order{};
+  std::vector<const Resource*> m_held{};
+
+  /// Memory of a resource, none for the default framebuffer
+  static uint64_t bytes(const Resource& resource) {
+    return resource.key.format == 0
+               ? 0
+               : TexturePool::bytes(resource.key) * resource.count;
+  }
+
+  /// Barrier bit that makes image stores visible to an access
+  static GLbitfield barrierBit(Access access) {
+    switch (access) {
+    case Access::Sample:
+      return GL_TEXTURE_FETCH_BARRIER_BIT;
+    case Access::Image:
+      return GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+    case Access::Attachment:
+      return GL_FRAMEBUFFER_BARRIER_BIT;
+    case Access::Transfer:
+      return GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+    }
+    return GL_ALL_BARRIER_BITS;
+  }
+
+  static constexpr GLbitfield IMAGE_STORE_BITS =
+      GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT |
+      GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_UPDATE_BARRIER_BIT;
+
+  /// Issues the bits and clears them from every resource
+  void barrier(GLbitfield bits) {
+    glMemoryBarrier(bits);
+    m_stats.barriers++;
+    for (auto& resource : m_resources) {
+      resource.pending &= ~bits;
+    }
+  }
+
+  Handle add(Resource&& resource) {
+    m_resources.push_back(std::move(resource));
+    return static_cast<Handle>(m_resources.size() - 1);
+  }
+
+  /// <summary>
+  /// Gives each transient the lowest slot of its key that no other
+  /// transient of the key is live in at the same time.
+  /// </summary>
+  void assignSlots() {
+    auto& order = m_order;
+    order.clear();
+    for (Handle i = 0; i < m_resources.size(); i++) {
+      const auto& resource = m_resources[i];
+      if (!resource.imported && resource.firstPass != NONE) {
+        order.push_back(i);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(), [&](Handle a, Handle b) {
+      return m_resources[a].firstPass < m_resources[b].firstPass;
+    });
+
+    for (size_t i = 0; i < order.size(); i++) {
+      auto& resource = m_resources[order[i]];
+      for (uint32_t slot = 0;; slot++) {
+        bool taken = false;
+        for (size_t j = 0; j < i; j++) {
+          const auto& other = m_resources[order[j]];
+          taken |= other.key == resource.key && other.slot == slot &&
+                   other.lastPass >= resource.firstPass;
+        }
+        if (!taken) {
+          resource.slot = slot;
+          break;
+        }
+      }
+    }
+  }
+
+public:
+  /// <summary>
+  /// Declares what a pass reads and writes, handed to its setup
+  /// </summary>
+  class Builder {
+    RenderGraph& m_graph;
+    size_t m_pass;
+
+  public:
+    Builder(RenderGraph& graph, size_t pass) : m_graph(graph), m_pass(pass) {}
+
+    /// <summary>
+    /// A texture only this frame uses, written before it is read. Its pool
+    /// slot is known once the graph is compiled.
+    /// </summary>
+    Handle create(std::string_view name, const TexturePool::Key& key) {
+      Handle handle = m_graph.add({.name = name, .key = key});
+      return write(handle);
+    }
+
+    Handle read(Handle resource, Access access = Access::Sample) {
+      m_graph.m_passes[m_pass].uses.push_back({resource, access, false});
+      return resource;
+    }
+
+    Handle write(Handle resource, Access access = Access::Attachment) {
+      m_graph.m_passes[m_pass].uses.push_back({resource, access, true});
+      return resource;
+    }
+  };
+
+  /// <summary>
+  /// Drops the passes and resources before the graph is declared again.
+  /// </summary>
+  void reset() {
+    m_resources.clear();
+    m_passes.clear();
+    m_stats = {};
+  }
+
+  /// <summary>
+  /// A texture that outlives the frame, owned by a pass. A format of 0 is
+  /// the default framebuffer, which takes no memory of ours.
+  /// </summary>
+  Handle import(std::string_view name, const TexturePool::Key& key,
+                uint32_t count = 1) {
+    return add({.name = name,
+                .key = key,
+                .count = count,
+                .imported = true});
+  }
+
+  /// Marks what the frame presents, the passes it depends on are kept
+  void output(Handle resource) { m_resources[resource].output = true; }
+  /// <summary>
+  /// Counts an imported texture as held even if no live pass uses it, like
+  /// the canvas that can't be redrawn.
+  /// </summary>
+  void retain(Handle resource) { m_resources[resource].retained = true; }
+
+  /// <summary>
+  /// Adds a pass. <paramref name="setup"/> declares its textures on the
+  /// builder and returns what runs it. <paramref name="release"/> runs
+  /// instead while the pass is culled, to hand its textures back.
+  /// </summary>
+  template <typename Setup>
+  void addPass(std::string_view name, Setup&& setup, Release release = {}) {
+    m_passes.push_back(
+        Pass{.name = name, .release = std::move(release)});
+    Builder builder(*this, m_passes.size() - 1);
+    Execute execute = setup(builder);
+    m_passes.back().execute = std::move(execute);
+  }
+
+  /// <summary>
+  /// Culls the passes nothing presented depends on, working back from the
+  /// outputs, then assigns the slots of the transients and sums up the
+  /// memory.
+  /// </summary>
+  void compile() {
+    for (auto& resource : m_resources) {
+      resource.needed = resource.output;
+      resource.firstPass = NONE;
+      resource.lastPass = NONE;
+      resource.slot = 0;
+      resource.pending = 0;
+    }
+
+    for (size_t i = m_passes.size(); i-- > 0;) {
+      auto& pass = m_passes[i];
+      pass.live = std::any_of(
+          pass.uses.begin(), pass.uses.end(), [&](const Use& use) {
+            return use.write && m_resources[use.resource].needed;
+          });
+      if (!pass.live) {
+        continue;
+      }
+      for (const auto& use : pass.uses) {
+        auto& resource = m_resources[use.resource];
+        resource.needed |= !use.write;
+        resource.firstPass = static_cast<uint32_t>(i);
+        if (resource.lastPass == NONE) {
+          resource.lastPass = static_cast<uint32_t>(i);
+        }
+      }
+    }
+    assignSlots();
+
+    m_stats = {.passes = static_cast<uint32_t>(m_passes.size())};
+    for (const auto& pass : m_passes) {
+      m_stats.culled += pass.live ? 0 : 1;
+    }
+    // Transients sharing a key and slot are one texture
+    auto& held = m_held;
+    held.clear();
+    for (const auto& resource : m_resources) {
+      m_stats.unaliasedBytes += bytes(resource);
+      m_stats.transients += resource.imported ? 0 : 1;
+      bool used = resource.firstPass != NONE ||
+                  (resource.imported && resource.retained);
+      if (!used || bytes(resource) == 0) {
+        continue;
+      }
+      bool shared =
+          !resource.imported &&
+          std::any_of(held.begin(), held.end(), [&](const Resource* other) {
+            return !other->imported && other->key == resource.key &&
+                   other->slot == resource.slot;
+          });
+      if (!shared) {
+        held.push_back(&resource);
+        m_stats.textures += resource.count;
+        m_stats.peakBytes += bytes(resource);
+      }
+    }
+  }
+
+  /// <summary>
+  /// Runs the live passes in the order they were added, with a barrier
+  /// before any that touches a texture stored to as an image since. Culled
+  /// passes release instead. Stores still pending at the end are made
+  /// visible, since the next frame's graph doesn't know about them.
+  /// </summary>
+  void execute() {
+    m_stats.barriers = 0;
+    for (auto& pass : m_passes) {
+      if (!pass.live) {
+        if (pass.release) {
+          pass.release();
+        }
+        continue;
+      }
+
+      // Everything else the stores owe goes into the same barrier, a
+      // second one later would cost more than the extra bits
+      GLbitfield bits = 0;
+      for (const auto& use : pass.uses) {
+        const auto& resource = m_resources[use.resource];
+        if ((resource.pending & barrierBit(use.access)) != 0) {
+          bits |= resource.pending;
+        }
+      }
+      if (bits != 0) {
+        barrier(bits);
+      }
+
+      pass.execute();
+
+      for (const auto& use : pass.uses) {
+        if (use.write && use.access == Access::Image) {
+          m_resources[use.resource].pending = IMAGE_STORE_BITS;
+        }
+      }
+    }
+
+    GLbitfield pending = 0;
+    for (const auto& resource : m_resources) {
+      pending |= resource.pending;
+    }
+    if (pending != 0) {
+      barrier(pending);
+    }
+  }
+
+  /// Pool slot of a transient, once compiled
+  uint32_t slot(Handle resource) const { return m_resources[resource].slot; }
+
+  /// Whether the pass called <paramref name="name"/> runs, once compiled
+  bool live(std::string_view name) const {
+    return std::any_of(m_passes.begin(), m_passes.end(), [&](const Pass& p) {
+      return p.live && p.name == name;
+    });
+  }
+
+  /// Calls <paramref name="visit"/> with the name of each pass and whether
+  /// it runs
+  template <typename F> void forEachPass(F&& visit) const {
+    for (const auto& pass : m_passes) {
+      visit(pass.name, pass.live);
+    }
+  }
+
+  const Stats& stats() const { return m_stats; }
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "spscQueue.hpp"
+#include <atomic>
+#include <cstdint>
+#include <gl/gl.hpp>
+#include <glm/glm.hpp>
+#include <thread>
+#include <utility>
+
+/// <summary>
+/// A GLFW callback, recorded on the main thread to be replayed on the render
+/// thread
+/// </summary>
+struct WindowEvent {
+  enum class Type : uint8_t {
+    CursorMove,
+    MouseButton,
+    Key,
+    Char,
+    Scroll,
+    Resize,
+    Iconify,
+    Focus
+  };
+
+  Type type = Type::CursorMove;
+  // Key or mouse button, the codepoint of Char, the flag of Iconify and Focus
+  int code = 0;
+  // GLFW_PRESS, GLFW_REPEAT or GLFW_RELEASE
+  int action = 0;
+  int mods = 0;
+  // Cursor position, scroll offset, or the window size of Resize
+  glm::dvec2 value{};
+  // Framebuffer size of Resize
+  gl::Window::Size framebuffer{};
+  // glfwGetTime() when the callback ran
+  double time = 0.0;
+};
+
+/// <summary>
+/// Runs the frame loop on a thread of its own, which owns the GL context and
+/// blocks in swapBuffers in its place. The main thread only waits for GLFW
+/// events, which have to be handled there, and forwards them through a
+/// lock-free queue; input is never held up by GPU back-pressure.
+/// </summary>
+class RenderThread {
+public:
+  static constexpr size_t QUEUE_SIZE = 1024;
+
+private:
+  gl::Window& m_window;
+  SpscQueue<WindowEvent, QUEUE_SIZE> m_events{};
+  // Events lost to a full queue, the render thread is too far behind
+  std::atomic<uint64_t> m_dropped = 0;
+  std::atomic<bool> m_running = false;
+  std::thread m_thread{};
+
+  static RenderThread& from(GLFWwindow* window) {
+    return *reinterpret_cast<RenderThread*>(gl::Window::getUserPtr(window));
+  }
+
+  void forward(const WindowEvent& event) {
+    if (!m_events.push(event)) {
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  static void keyCallback(GLFWwindow* window, int key, int scancode,
+                          int action, int mods) {
+    (void)scancode;
+    from(window).forward({.type = WindowEvent::Type::Key,
+                          .code = key,
+                          .action = action,
+                          .mods = mods,
+                          .time = glfwGetTime()});
+  }
+  static void charCallback(GLFWwindow* window, unsigned int codepoint) {
+    from(window).forward({.type = WindowEvent::Type::Char,
+                          .code = static_cast<int>(codepoint),
+                          .time = glfwGetTime()});
+  }
+  static void cursorPosCallback(GLFWwindow* window, double x, double y) {
+    from(window).forward({.type = WindowEvent::Type::CursorMove,
+                          .value = {x, y},
+                          .time = glfwGetTime()});
+  }
+  static void mouseButtonCallback(GLFWwindow* window, int button, int action,
+                                  int mods) {
+    from(window).forward({.type = WindowEvent::Type::MouseButton,
+                          .code = button,
+                          .action = action,
+                          .mods = mods,
+                          .time = glfwGetTime()});
+  }
+  static void scrollCallback(GLFWwindow* window, double x, double y) {
+    from(window).forward({.type = WindowEvent::Type::Scroll,
+                          .value = {x, y},
+                          .time = glfwGetTime()});
+  }
+  static void sizeCallback(GLFWwindow* window, int width, int height) {
+    (void)width;
+    (void)height;
+    auto& thread = from(window);
+    // Both sizes, whichever of the two changed
+    auto size = thread.m_window.size();
+    thread.forward({.type = WindowEvent::Type::Resize,
+                    .value = {static_cast<double>(size.width),
+                              static_cast<double>(size.height)},
+                    .framebuffer = thread.m_window.framebufferSize(),
+                    .time = glfwGetTime()});
+  }
+  static void iconifyCallback(GLFWwindow* window, int iconified) {
+    from(window).forward({.type = WindowEvent::Type::Iconify,
+                          .code = iconified,
+                          .time = glfwGetTime()});
+  }
+  static void focusCallback(GLFWwindow* window, int focused) {
+    from(window).forward({.type = WindowEvent::Type::Focus,
+                          .code = focused,
+                          .time = glfwGetTime()});
+  }
+
+public:
+  /// <summary>
+  /// Takes over the GLFW callbacks of <paramref name="window"/>, call on the
+  /// main thread after everything else that sets them.
+  /// </summary>
+  explicit RenderThread(gl::Window& window) : m_window(window) {
+    m_window.setUserPtr(this);
+    m_window.setKeyCallback(keyCallback);
+    m_window.setCharCallback(charCallback);
+    m_window.setCursorPosCallback(cursorPosCallback);
+    m_window.setMouseButtonCallback(mouseButtonCallback);
+    m_window.setScrollCallback(scrollCallback);
+    m_window.setWindowSizeCallback(sizeCallback);
+    m_window.setFramebufferSizeCallback(sizeCallback);
+    m_window.setIconifyCallback(iconifyCallback);
+    m_window.setFocusCallback(focusCallback);
+  }
+  ~RenderThread() { stop(); }
+
+  RenderThread(const RenderThread&) = delete;
+  RenderThread& operator=(const RenderThread&) = delete;
+  RenderThread(RenderThread&&) = delete;
+  RenderThread& operator=(RenderThread&&) = delete;
+
+  /// <summary>
+  /// Hands the context over to a new thread running
+  /// <paramref name="loop"/>, which should return once running() is false.
+  /// </summary>
+  template <typename F> void start(F&& loop) {
+    gl::Window::releaseCurrent();
+    m_running.store(true, std::memory_order_release);
+    m_thread = std::thread([this, loop = std::forward<F>(loop)]() mutable {
+      m_window.makeCurrent();
+      loop();
+      gl::Window::releaseCurrent();
+    });
+  }
+
+  /// <summary>
+  /// Waits for the render thread to finish its frame and takes the context
+  /// back to the calling thread.
+  /// </summary>
+  void stop() {
+    if (!m_thread.joinable()) {
+      return;
+    }
+    m_running.store(false, std::memory_order_release);
+    m_thread.join();
+    m_window.makeCurrent();
+  }
+
+  bool running() const { return m_running.load(std::memory_order_acquire); }
+
+  /// Render thread side, the next forwarded event if there is one
+  bool pop(WindowEvent& event) { return m_events.pop(event); }
+  uint64_t dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+};
@@ -0,0 +1,407 @@
+#include "sceneFile.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <system_error>
+
+namespace {
+  /// Appends runs of equal texels, uint32 count then the texel
+  void encodeRle(std::span<const std::byte> texels, size_t texelBytes,
+                 std::vector<std::byte>& out) {
+    size_t count = texels.size() / texelBytes;
+    size_t i = 0;
+    while (i < count) {
+      const std::byte* texel = &texels[i * texelBytes];
+      size_t run = 1;
+      while (i + run < count &&
+             std::memcmp(texel, &texels[(i + run) * texelBytes], texelBytes) ==
+                 0) {
+        run++;
+      }
+      auto length = static_cast<uint32_t>(run);
+      auto* lengthBytes = reinterpret_cast<const std::byte*>(&length);
+      out.insert(out.end(), lengthBytes, lengthBytes + sizeof(length));
+      out.insert(out.end(), texel, texel + texelBytes);
+      i += run;
+    }
+  }
+
+  bool decodeRle(std::span<const std::byte> data, size_t texelBytes,
+                 std::span<std::byte> out) {
+    size_t written = 0;
+    size_t read = 0;
+    while (read < data.size()) {
+      if (read + sizeof(uint32_t) + texelBytes > data.size()) {
+        return false;
+      }
+      uint32_t run = 0;
+      std::memcpy(&run, &data[read], sizeof(run));
+      const std::byte* texel = &data[read + sizeof(run)];
+      read += sizeof(run) + texelBytes;
+      if (written + static_cast<size_t>(run) * texelBytes > out.size()) {
+        return false;
+      }
+      for (uint32_t i = 0; i < run; i++) {
+        std::memcpy(&out[written], texel, texelBytes);
+        written += texelBytes;
+      }
+    }
+    return written == out.size();
+  }
+
+  size_t tileCount(uint32_t width, uint32_t height, uint32_t tileSize) {
+    size_t columns = (width + tileSize - 1) / tileSize;
+    size_t rows = (height + tileSize - 1) / tileSize;
+    return columns * rows;
+  }
+} // namespace
+
+std::optional<SceneFile> SceneFile::open(std::string_view path) {
+  auto file = MappedFile::open(path);
+  if (!file.has_value()) {
+    return std::nullopt;
+  }
+
+  auto bytes = file->bytes();
+  Header header{};
+  if (bytes.size() < sizeof(Header)) {
+    Logger::error("Scene file {} is truncated", path);
+    return std::nullopt;
+  }
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  if (header.magic != MAGIC) {
+    Logger::error("{} is not a scene file", path);
+    return std::nullopt;
+  }
+  if (header.version != VERSION) {
+    Logger::error("Scene file {} has version {}, expected {}", path,
+                  header.version, VERSION);
+    return std::nullopt;
+  }
+  // write() only emits TILE_SIZE, and the staging of upload() is sized from
+  // it. Larger textures couldn't be loaded anyway
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  auto maxExtent = static_cast<uint32_t>(std::max(maxSize, 0));
+  if (header.width == 0 || header.height == 0 || header.width > maxExtent ||
+      header.height > maxExtent || header.tileSize != TILE_SIZE ||
+      (header.texel != Texel::RGBA32F && header.texel != Texel::RGBA8) ||
+      header.tiles != tileCount(header.width, header.height, header.tileSize)) {
+    Logger::error("Scene file {} has an invalid header", path);
+    return std::nullopt;
+  }
+  size_t tableEnd =
+      sizeof(Header) + static_cast<size_t>(header.tiles) * sizeof(TileEntry);
+  if (bytes.size() < tableEnd) {
+    Logger::error("Scene file {} is truncated", path);
+    return std::nullopt;
+  }
+
+  SceneFile scene(std::move(*file), header);
+  for (size_t i = 0; i < scene.tiles(); i++) {
+    auto tileEntry = scene.entry(i);
+    // Written so that an offset near the top of the range can't wrap
+    if (tileEntry.offset < tableEnd || tileEntry.offset > bytes.size() ||
+        tileEntry.size > bytes.size() - tileEntry.offset ||
+        (tileEntry.encoding != Encoding::Raw &&
+         tileEntry.encoding != Encoding::Rle)) {
+      Logger::error("Scene file {} has an invalid tile {}", path, i);
+      return std::nullopt;
+    }
+  }
+  return scene;
+}
+
+SceneFile::TileEntry SceneFile::entry(size_t tile) const {
+  // Copied out, the mapping makes no promise about alignment
+  TileEntry tileEntry{};
+  std::memcpy(&tileEntry,
+              m_file.bytes().data() + sizeof(Header) + tile * sizeof(TileEntry),
+              sizeof(TileEntry));
+  return tileEntry;
+}
+
+size_t SceneFile::rleTiles() const {
+  size_t count = 0;
+  for (size_t i = 0; i < tiles(); i++) {
+    count += entry(i).encoding == Encoding::Rle ? 1 : 0;
+  }
+  return count;
+}
+
+SceneFile::Tile SceneFile::tile(size_t index) const {
+  auto columns = (m_header.width + m_header.tileSize - 1) / m_header.tileSize;
+  auto tileSize = static_cast<int>(m_header.tileSize);
+  int x = static_cast<int>(index % columns) * tileSize;
+  int y = static_cast<int>(index / columns) * tileSize;
+  return {x, y, std::min(tileSize, static_cast<int>(m_header.width) - x),
+          std::min(tileSize, static_cast<int>(m_header.height) - y)};
+}
+
+bool SceneFile::decodeTile(size_t index, std::span<std::byte> out) const {
+  auto tileEntry = entry(index);
+  auto bounds = tile(index);
+  size_t bytes = static_cast<size_t>(bounds.width) *
+                 static_cast<size_t>(bounds.height) * texelBytes(texel());
+  if (out.size() < bytes) {
+    return false;
+  }
+  auto data = m_file.bytes().subspan(tileEntry.offset, tileEntry.size);
+  if (tileEntry.encoding == Encoding::Raw) {
+    if (data.size() != bytes) {
+      return false;
+    }
+    std::memcpy(out.data(), data.data(), bytes);
+    return true;
+  }
+  return decodeRle(data, texelBytes(texel()), out.first(bytes));
+}
+
+bool SceneFile::upload(const gl::Texture& texture) const {
+  auto timer = gl::GpuProfiler::get().scope("Scene upload");
+  constexpr size_t BATCHES = 4;
+  constexpr size_t TILES_PER_BATCH = 16;
+  constexpr size_t SLOTS = BATCHES * TILES_PER_BATCH;
+
+  size_t tileBytes = static_cast<size_t>(m_header.tileSize) *
+                     m_header.tileSize * texelBytes(texel());
+  gl::BasicBuffer staging(static_cast<GLuint>(tileBytes * SLOTS), nullptr,
+                          gl::Buffer::UsageBitFlag(gl::Buffer::Usage::WRITE) |
+                              gl::Buffer::Usage::PERSISTENT |
+                              gl::Buffer::Usage::COHERENT);
+  auto* mapping = static_cast<std::byte*>(
+      staging.map(gl::Buffer::Mapping::WRITE | gl::Buffer::Mapping::PERSISTENT |
+                  gl::Buffer::Mapping::COHERENT));
+  // Slices of the ring, fenced once their tiles are queued
+  std::array<GLsync, BATCHES> fences{};
+
+  staging.bind(gl::BasicBuffer::Target::PIXEL_UNPACK);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  bool ok = true;
+  for (size_t i = 0; i < tiles() && ok; i++) {
+    size_t slot = i % SLOTS;
+    GLsync& fence = fences[slot / TILES_PER_BATCH];
+    if (slot % TILES_PER_BATCH == 0 && fence != nullptr) {
+      // The GPU has to be done reading the slice from the last lap
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                       GL_TIMEOUT_IGNORED);
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+
+    auto bounds = tile(i);
+    ok = decodeTile(i, {mapping + slot * tileBytes, tileBytes});
+    if (!ok) {
+      Logger::error("Scene tile {} is corrupt", i);
+      break;
+    }
+    // With an unpack buffer bound the pointer is an offset into it
+    texture.subImage(0, bounds.x, bounds.y, bounds.width, bounds.height,
+                     GL_RGBA, texelType(texel()),
+                     reinterpret_cast<const void*>(slot * tileBytes));
+
+    if (slot % TILES_PER_BATCH == TILES_PER_BATCH - 1) {
+      fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+  }
+
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  gl::Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+  // The buffer is only freed once the queued uploads have read it
+  for (auto fence : fences) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+    }
+  }
+  return ok;
+}
+
+std::optional<std::vector<glm::vec4>> SceneFile::decode() const {
+  auto [width, height] = size();
+  std::vector<glm::vec4> pixels(static_cast<size_t>(width) *
+                                static_cast<size_t>(height));
+  size_t texel = texelBytes(this->texel());
+  std::vector<std::byte> tileTexels(static_cast<size_t>(m_header.tileSize) *
+                                    m_header.tileSize * texel);
+
+  for (size_t i = 0; i < tiles(); i++) {
+    if (!decodeTile(i, tileTexels)) {
+      Logger::error("Scene tile {} is corrupt", i);
+      return std::nullopt;
+    }
+    auto bounds = tile(i);
+    for (int y = 0; y < bounds.height; y++) {
+      for (int x = 0; x < bounds.width; x++) {
+        const std::byte* src =
+            &tileTexels[(static_cast<size_t>(y) * bounds.width + x) * texel];
+        auto& dst = pixels[static_cast<size_t>(bounds.y + y) * width +
+                           static_cast<size_t>(bounds.x + x)];
+        if (this->texel() == Texel::RGBA8) {
+          const auto* rgba = reinterpret_cast<const uint8_t*>(src);
+          dst = glm::vec4(rgba[0], rgba[1], rgba[2], rgba[3]) / 255.f;
+        } else {
+          std::memcpy(&dst, src, sizeof(dst));
+        }
+      }
+    }
+  }
+  return pixels;
+}
+
+bool SceneFile::write(std::string_view path, const gl::Window::Size& size,
+                      Texel texel, std::span<const std::byte> pixels) {
+  size_t texelSize = texelBytes(texel);
+  if (size.width <= 0 || size.height <= 0 ||
+      pixels.size() < static_cast<size_t>(size.width) * size.height *
+                          texelSize) {
+    Logger::error("Scene to save to {} has no pixels", path);
+    return false;
+  }
+
+  Header header{.magic = MAGIC,
+                .version = VERSION,
+                .width = static_cast<uint32_t>(size.width),
+                .height = static_cast<uint32_t>(size.height),
+                .tileSize = TILE_SIZE,
+                .texel = texel,
+                .tiles = 0,
+                .reserved = 0};
+  header.tiles = static_cast<uint32_t>(
+      tileCount(header.width, header.height, header.tileSize));
+
+  std::vector<TileEntry> entries(header.tiles);
+  std::vector<std::byte> data;
+  std::vector<std::byte> raw;
+  std::vector<std::byte> rle;
+  uint64_t offset =
+      sizeof(Header) + static_cast<uint64_t>(header.tiles) * sizeof(TileEntry);
+  size_t columns = (header.width + TILE_SIZE - 1) / TILE_SIZE;
+
+  for (size_t i = 0; i < entries.size(); i++) {
+    int x = static_cast<int>((i % columns) * TILE_SIZE);
+    int y = static_cast<int>((i / columns) * TILE_SIZE);
+    int width = std::min(static_cast<int>(TILE_SIZE), size.width - x);
+    int height = std::min(static_cast<int>(TILE_SIZE), size.height - y);
+
+    raw.clear();
+    for (int row = 0; row < height; row++) {
+      const std::byte* src =
+          &pixels[(static_cast<size_t>(y + row) * size.width + x) * texelSize];
+      raw.insert(raw.end(), src, src + width * texelSize);
+    }
+    rle.clear();
+    encodeRle(raw, texelSize, rle);
+
+    bool useRle = rle.size() < raw.size();
+    const auto& tileData = useRle ? rle : raw;
+    entries[i] = {.offset = offset,
+                  .size = static_cast<uint32_t>(tileData.size()),
+                  .encoding = useRle ? Encoding::Rle : Encoding::Raw};
+    data.insert(data.end(), tileData.begin(), tileData.end());
+    offset += tileData.size();
+  }
+
+  std::filesystem::path filePath{std::string(path)};
+  auto tempPath = filePath;
+  tempPath += ".tmp";
+  {
+    std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(entries.data()),
+               static_cast<std::streamsize>(entries.size() *
+                                            sizeof(TileEntry)));
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      Logger::error("Failed to write scene file {}", tempPath.string());
+      file.close();
+      std::error_code error;
+      std::filesystem::remove(tempPath, error);
+      return false;
+    }
+  }
+  std::error_code error;
+  std::filesystem::rename(tempPath, filePath, error);
+  if (error) {
+    Logger::error("Failed to save scene file {}: {}", path, error.message());
+    std::filesystem::remove(tempPath, error);
+    return false;
+  }
+  return true;
+}
+
+bool SceneReadback::start(const gl::Texture& texture, GLenum internalFormat,
+                          std::string path) {
+  if (pending()) {
+    return false;
+  }
+  const auto& size = texture.size();
+  m_size = {size.width, size.height};
+  m_texel = SceneFile::texelFor(internalFormat);
+  m_path = std::move(path);
+
+  size_t bytes = static_cast<size_t>(size.width) *
+                 static_cast<size_t>(size.height) *
+                 SceneFile::texelBytes(m_texel);
+  if (!m_buffer.has_value() || m_bufferSize != bytes) {
+    m_buffer.reset();
+    m_buffer.emplace(static_cast<GLuint>(bytes), nullptr,
+                     gl::Buffer::UsageBitFlag(gl::Buffer::Usage::READ) |
+                         gl::Buffer::Usage::PERSISTENT |
+                         gl::Buffer::Usage::COHERENT);
+    m_mapping = static_cast<const std::byte*>(m_buffer->map(
+        gl::Buffer::Mapping::READ | gl::Buffer::Mapping::PERSISTENT |
+        gl::Buffer::Mapping::COHERENT));
+    m_bufferSize = bytes;
+  }
+
+  m_buffer->bind(gl::BasicBuffer::Target::PIXEL_PACK);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  texture.getImage(0, GL_RGBA, SceneFile::texelType(m_texel),
+                   static_cast<GLsizei>(bytes), nullptr);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  gl::Buffer::unbind(GL_PIXEL_PACK_BUFFER);
+  m_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  return true;
+}
+
+std::optional<bool> SceneReadback::poll(bool wait) {
+  if (m_fence != nullptr) {
+    GLenum status = glClientWaitSync(m_fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                     wait ? GL_TIMEOUT_IGNORED : 0);
+    if (status == GL_TIMEOUT_EXPIRED) {
+      return std::nullopt;
+    }
+    glDeleteSync(m_fence);
+    m_fence = nullptr;
+    if (status == GL_WAIT_FAILED) {
+      Logger::error("Waiting for the readback of {} failed", m_path);
+      return false;
+    }
+
+    // Encoding a large canvas takes longer than a frame. The mapping stays
+    // valid, start() refuses another save until this one is collected
+    m_write = std::async(
+        std::launch::async,
+        [path = m_path, size = m_size, texel = m_texel,
+         texels = std::span<const std::byte>(m_mapping, m_bufferSize)] {
+          return SceneFile::write(path, size, texel, texels);
+        });
+  }
+
+  if (!m_write.valid() ||
+      (!wait && m_write.wait_for(std::chrono::seconds(0)) !=
+                    std::future_status::ready)) {
+    return std::nullopt;
+  }
+  bool written = m_write.get();
+  if (written) {
+    Logger::info("Saved scene {} ({}x{})", m_path, m_size.width,
+                 m_size.height);
+  }
+  return written;
+}
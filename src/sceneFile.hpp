@@ -0,0 +1,185 @@
+#pragma once
+
+#include "mappedFile.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <gl/gl.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Binary scene file holding a canvas in square tiles, each stored raw or
+/// run-length encoded, whichever is smaller. Mostly empty canvases shrink
+/// to a few runs per tile.
+///
+/// Layout, little endian: a 32 byte Header, a TileEntry per tile, then the
+/// tile data. Tiles go left to right, bottom to top like texture rows, and
+/// hold their rows bottom to top without padding; the ones on the right and
+/// top edge are narrower. An RLE tile is a list of runs, each a uint32
+/// count followed by one texel.
+///
+/// Files are read through a memory mapping, so loading decodes straight from
+/// the page cache into the upload buffer.
+/// </summary>
+class SceneFile {
+public:
+  static constexpr std::array<char, 4> MAGIC{'R', 'C', 'S', 'F'};
+  static constexpr uint32_t VERSION = 1;
+  static constexpr uint32_t TILE_SIZE = 64;
+
+  enum class Texel : uint32_t { RGBA32F = 0, RGBA8 = 1 };
+  enum class Encoding : uint32_t { Raw = 0, Rle = 1 };
+
+  struct Header {
+    std::array<char, 4> magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    Texel texel;
+    uint32_t tiles;
+    uint32_t reserved;
+  };
+  static_assert(sizeof(Header) == 32);
+
+  struct TileEntry {
+    // From the start of the file
+    uint64_t offset;
+    uint32_t size;
+    Encoding encoding;
+  };
+  static_assert(sizeof(TileEntry) == 16);
+
+  struct Tile {
+    int x;
+    int y;
+    int width;
+    int height;
+  };
+
+  static constexpr size_t texelBytes(Texel texel) {
+    return texel == Texel::RGBA8 ? 4 : 16;
+  }
+  static constexpr GLenum texelType(Texel texel) {
+    return texel == Texel::RGBA8 ? GL_UNSIGNED_BYTE : GL_FLOAT;
+  }
+  /// The texel a canvas of <paramref name="internalFormat"/> is saved as
+  static constexpr Texel texelFor(GLenum internalFormat) {
+    return internalFormat == GL_RGBA8 ? Texel::RGBA8 : Texel::RGBA32F;
+  }
+
+private:
+  MappedFile m_file;
+  Header m_header;
+
+  SceneFile(MappedFile&& file, const Header& header)
+      : m_file(std::move(file)), m_header(header) {}
+
+  TileEntry entry(size_t tile) const;
+
+public:
+  /// <summary>
+  /// Maps the file at <paramref name="path"/> and checks its header and
+  /// tile table.
+  /// </summary>
+  static std::optional<SceneFile> open(std::string_view path);
+
+  /// <summary>
+  /// Writes a scene of <paramref name="size"/> from
+  /// <paramref name="pixels"/>, whole rows bottom to top. Goes through a
+  /// temporary file, so a failed save leaves the old one intact.
+  /// </summary>
+  static bool write(std::string_view path, const gl::Window::Size& size,
+                    Texel texel, std::span<const std::byte> pixels);
+
+  gl::Window::Size size() const {
+    return {static_cast<int>(m_header.width),
+            static_cast<int>(m_header.height)};
+  }
+  Texel texel() const { return m_header.texel; }
+  size_t tiles() const { return m_header.tiles; }
+  size_t rleTiles() const;
+  size_t fileBytes() const { return m_file.size(); }
+
+  Tile tile(size_t index) const;
+
+  /// <summary>
+  /// Decodes tile <paramref name="index"/> into <paramref name="out"/>,
+  /// which has to hold its texels. False if the data is corrupt.
+  /// </summary>
+  bool decodeTile(size_t index, std::span<std::byte> out) const;
+
+  /// <summary>
+  /// Streams every tile into <paramref name="texture"/>, which has to be at
+  /// least size(), through a small ring of pixel unpack buffer slices. Tiles
+  /// are decoded from the mapping right into the buffer.
+  /// </summary>
+  bool upload(const gl::Texture& texture) const;
+
+  /// <summary>
+  /// Decodes the whole scene on the CPU, rows bottom to top.
+  /// </summary>
+  std::optional<std::vector<glm::vec4>> decode() const;
+};
+
+/// <summary>
+/// Saves a texture without stalling: the texture is copied into a pixel pack
+/// buffer, and once a later poll() finds the copy done the file is encoded
+/// and written from the mapping on a thread of its own.
+/// </summary>
+class SceneReadback {
+  std::optional<gl::BasicBuffer> m_buffer = std::nullopt;
+  const std::byte* m_mapping = nullptr;
+  size_t m_bufferSize = 0;
+  GLsync m_fence = nullptr;
+  std::string m_path{};
+  gl::Window::Size m_size{};
+  SceneFile::Texel m_texel = SceneFile::Texel::RGBA32F;
+  // Writing the file from the mapping. Declared after the buffer, so it is
+  // waited for before the buffer goes away
+  std::future<bool> m_write{};
+
+public:
+  SceneReadback() = default;
+  ~SceneReadback() {
+    if (m_fence != nullptr) {
+      glDeleteSync(m_fence);
+    }
+  }
+
+  SceneReadback(const SceneReadback&) = delete;
+  SceneReadback& operator=(const SceneReadback&) = delete;
+  SceneReadback(SceneReadback&& other) noexcept
+      : m_buffer(std::move(other.m_buffer)),
+        m_mapping(std::exchange(other.m_mapping, nullptr)),
+        m_bufferSize(std::exchange(other.m_bufferSize, 0)),
+        m_fence(std::exchange(other.m_fence, nullptr)),
+        m_path(std::move(other.m_path)), m_size(other.m_size),
+        m_texel(other.m_texel), m_write(std::move(other.m_write)) {}
+  SceneReadback& operator=(SceneReadback&&) = delete;
+
+  /// Whether the copy or the write of a save is still running
+  bool pending() const { return m_fence != nullptr || m_write.valid(); }
+  const std::string& path() const { return m_path; }
+
+  /// <summary>
+  /// Queues the copy of <paramref name="texture"/>, stored as
+  /// <paramref name="internalFormat"/>. False if a save is still pending.
+  /// </summary>
+  bool start(const gl::Texture& texture, GLenum internalFormat,
+             std::string path);
+
+  /// <summary>
+  /// Starts writing the file once the copy is done, and reports when the
+  /// write finished. <paramref name="wait"/> waits for both. Empty while
+  /// pending, otherwise whether the file was written.
+  /// </summary>
+  std::optional<bool> poll(bool wait = false);
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "logger.hpp"
+#include <array>
+#include <cstdint>
+#include <gl/gl.hpp>
+#include <optional>
+#include <string>
+#include <utility>
+
+/// <summary>
+/// Builds of a raymarching shader compiled with the ray count and step budget
+/// as constants, so the compiler unrolls the loops and folds the interval
+/// math. Each is loaded the first time its inputs are drawn with; other
+/// inputs fall back to the generic program.
+/// </summary>
+class ShaderVariants {
+public:
+  // Keep in sync with VARIANT_RAY_COUNTS and VARIANT_MAX_STEPS in
+  // src/shaders/CMakeLists.txt
+  static constexpr std::array<uint32_t, 3> RAY_COUNTS{4, 16, 64};
+  static constexpr std::array<uint32_t, 3> MAX_STEPS{16, 32, 64};
+  static constexpr size_t COUNT = RAY_COUNTS.size() * MAX_STEPS.size();
+
+  /// <summary>
+  /// Slot of the variant compiled for <paramref name="rayCount"/> and
+  /// <paramref name="maxSteps"/>, if there is one.
+  /// </summary>
+  static constexpr std::optional<size_t> index(uint32_t rayCount,
+                                               uint32_t maxSteps) {
+    for (size_t r = 0; r < RAY_COUNTS.size(); r++) {
+      for (size_t s = 0; s < MAX_STEPS.size(); s++) {
+        if (RAY_COUNTS[r] == rayCount && MAX_STEPS[s] == maxSteps) {
+          return r * MAX_STEPS.size() + s;
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+private:
+  std::string m_source;
+  std::array<std::optional<gl::Program>, COUNT> m_programs{};
+  // Variants that failed to load, so they aren't retried every frame
+  std::array<bool, COUNT> m_failed{};
+
+public:
+  /// <param name="source">Shader the variants were built from, without
+  /// extension</param>
+  explicit ShaderVariants(std::string source) : m_source(std::move(source)) {}
+
+  /// <summary>
+  /// The variant for these inputs, or null if none was built or it failed
+  /// to load.
+  /// </summary>
+  const gl::Program* get(uint32_t rayCount, uint32_t maxSteps) {
+    auto slot = index(rayCount, maxSteps);
+    if (!slot.has_value()) {
+      return nullptr;
+    }
+    auto& program = m_programs[*slot];
+    if (!program.has_value() && !m_failed[*slot]) {
+      auto name = fmt::format("{}_r{}_s{}", m_source, rayCount, maxSteps);
+      auto vert = name + "_vert.glsl";
+      auto frag = name + "_frag.glsl";
+      auto programOpt = gl::Program::fromFiles(
+          {{vert, gl::Shader::VERTEX}, {frag, gl::Shader::FRAGMENT}});
+      if (programOpt.has_value()) {
+        program = std::move(programOpt.value());
+      } else {
+        Logger::error("Failed to load shader variant {}: {}", name,
+                      programOpt.error());
+        m_failed[*slot] = true;
+      }
+    }
+    return program.has_value() ? &*program : nullptr;
+  }
+
+  /// Variants loaded so far
+  size_t loaded() const {
+    size_t count = 0;
+    for (const auto& program : m_programs) {
+      count += program.has_value() ? 1 : 0;
+    }
+    return count;
+  }
+};
+
+static_assert(ShaderVariants::index(4, 32) == 1);
+static_assert(!ShaderVariants::index(5, 32).has_value());
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+
+/// <summary>
+/// Bounded lock-free queue between exactly one producer and one consumer
+/// thread. Each side only writes its own index, so neither push nor pop ever
+/// waits; push fails instead when the queue is full.
+/// </summary>
+template <typename T, size_t N> class SpscQueue {
+  static_assert(std::has_single_bit(N), "Capacity must be a power of two");
+
+  // Apart, so the two threads don't keep stealing one cache line
+  static constexpr size_t CACHE_LINE = 64;
+
+  std::array<T, N> m_items{};
+  // Next slot to pop, only written by the consumer
+  alignas(CACHE_LINE) std::atomic<size_t> m_head = 0;
+  // Next slot to push, only written by the producer
+  alignas(CACHE_LINE) std::atomic<size_t> m_tail = 0;
+
+public:
+  static constexpr size_t CAPACITY = N;
+
+  /// Producer side, false if the queue is full
+  bool push(const T& item) {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (tail - m_head.load(std::memory_order_acquire) == N) {
+      return false;
+    }
+    m_items[tail % N] = item;
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// Consumer side, false if the queue is empty
+  bool pop(T& item) {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head == m_tail.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = m_items[head % N];
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+/// <summary>
+/// Remembers the inputs a pass last ran with, so it can be skipped while they
+/// stay the same. The version is bumped on every recompute, letting the next
+/// stage use it as one of its own inputs.
+/// </summary>
+template <typename Inputs> class StageCache {
+  std::optional<Inputs> m_inputs = std::nullopt;
+  uint64_t m_version = 0;
+  uint64_t m_hits = 0;
+  uint64_t m_misses = 0;
+
+public:
+  /// <summary>
+  /// Returns whether the stage has to run for <paramref name="inputs"/>,
+  /// counting the call as a hit or miss.
+  /// </summary>
+  bool needsUpdate(const Inputs& inputs) {
+    if (m_inputs == inputs) {
+      m_hits++;
+      return false;
+    }
+    m_inputs = inputs;
+    m_misses++;
+    m_version++;
+    return true;
+  }
+
+  /// Inputs of the last recompute, none if it never ran or was invalidated
+  const std::optional<Inputs>& inputs() const { return m_inputs; }
+
+  /// Forces the next update to recompute, e.g. after the output was lost
+  void invalidate() { m_inputs.reset(); }
+
+  uint64_t version() const { return m_version; }
+  uint64_t hits() const { return m_hits; }
+  uint64_t misses() const { return m_misses; }
+  double hitRate() const {
+    uint64_t total = m_hits + m_misses;
+    return total == 0 ? 0.0
+                      : static_cast<double>(m_hits) /
+                            static_cast<double>(total);
+  }
+  void resetStats() {
+    m_hits = 0;
+    m_misses = 0;
+  }
+};
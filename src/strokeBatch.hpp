@@ -0,0 +1,136 @@
+#pragma once
+
+#include "logger.hpp"
+#include "rect.hpp"
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <gl/gl.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/// <summary>
+/// Collects the brush segments of a frame and rasterizes them in a single
+/// instanced draw, each as a quad around its capsule. Fill cost follows the
+/// brush area rather than the canvas, so every cursor sample between two
+/// frames can become a segment of its own instead of being skipped.
+/// </summary>
+class StrokeBatch {
+public:
+  /// Per instance data, matches StrokeVIn in draw.slang
+  struct Segment {
+    // Pixels, rows bottom to top
+    glm::vec2 from;
+    glm::vec2 to;
+    // Radius in w
+    glm::vec4 color;
+
+    bool operator==(const Segment&) const = default;
+  };
+  static_assert(sizeof(Segment) == 32);
+
+  struct Params {
+    glm::vec2 resolution;
+  };
+
+private:
+  // Two triangles, x along the segment and y across it
+  static constexpr std::array<glm::vec2, 6> CORNERS{
+      glm::vec2{0.f, 0.f}, glm::vec2{1.f, 0.f}, glm::vec2{1.f, 1.f},
+      glm::vec2{0.f, 0.f}, glm::vec2{1.f, 1.f}, glm::vec2{0.f, 1.f}};
+  static constexpr GLuint CORNER_BINDING = 0;
+  static constexpr GLuint SEGMENT_BINDING = 1;
+
+  gl::Program m_program;
+  gl::BasicBuffer m_corners;
+  gl::Vao m_vao;
+
+  std::vector<Segment> m_segments{};
+  Rect m_bounds{};
+  size_t m_lastCount = 0;
+
+  StrokeBatch(gl::Program&& program, gl::BasicBuffer&& corners, gl::Vao&& vao)
+      : m_program(std::move(program)), m_corners(std::move(corners)),
+        m_vao(std::move(vao)) {}
+
+public:
+  static std::optional<StrokeBatch> create() {
+    auto programOpt =
+        gl::Program::fromFiles({{"draw_vert.glsl", gl::Shader::VERTEX},
+                                {"draw_frag.glsl", gl::Shader::FRAGMENT}});
+    if (!programOpt.has_value()) {
+      Logger::error("Failed to load draw program: {}", programOpt.error());
+      return std::nullopt;
+    }
+
+    gl::BasicBuffer corners(
+        static_cast<GLuint>(CORNERS.size() * sizeof(glm::vec2)),
+        CORNERS.data());
+    gl::Vao vao;
+    vao.bindVertexBuffer(CORNER_BINDING, corners.id(), 0, sizeof(glm::vec2));
+    vao.attribFormat(0, 2, GL_FLOAT, false, 0, CORNER_BINDING);
+    // The segment buffer is bound per flush, it lives in the upload ring
+    vao.attribFormat(1, 2, GL_FLOAT, false, offsetof(Segment, from),
+                     SEGMENT_BINDING);
+    vao.attribFormat(2, 2, GL_FLOAT, false, offsetof(Segment, to),
+                     SEGMENT_BINDING);
+    vao.attribFormat(3, 4, GL_FLOAT, false, offsetof(Segment, color),
+                     SEGMENT_BINDING);
+    vao.bindingDivisor(SEGMENT_BINDING, 1);
+
+    return StrokeBatch(std::move(programOpt.value()), std::move(corners),
+                       std::move(vao));
+  }
+
+  bool empty() const { return m_segments.empty(); }
+  /// Segments drawn by the last flush that drew any
+  size_t lastCount() const { return m_lastCount; }
+
+  void add(const Segment& segment) {
+    m_segments.push_back(segment);
+
+    glm::vec2 low = glm::min(segment.from, segment.to) - segment.color.w;
+    glm::vec2 high = glm::max(segment.from, segment.to) + segment.color.w;
+    Rect bounds{static_cast<int>(std::floor(low.x)) - 1,
+                static_cast<int>(std::floor(low.y)) - 1,
+                static_cast<int>(std::ceil(high.x)) + 1,
+                static_cast<int>(std::ceil(high.y)) + 1};
+    m_bounds = m_bounds.united(bounds);
+  }
+
+  /// <summary>
+  /// Draws every segment added since the last flush into
+  /// <paramref name="target"/> of <paramref name="size"/>, then clears them.
+  /// Returns the bounds of what was drawn.
+  /// </summary>
+  Rect flush(const gl::Framebuffer& target, const gl::Window::Size& size) {
+    if (m_segments.empty()) {
+      return {};
+    }
+    m_lastCount = m_segments.size();
+
+    auto& uploadRing = gl::UploadRing::get();
+    auto bytes = static_cast<GLuint>(m_segments.size() * sizeof(Segment));
+    auto segments = uploadRing.allocate(bytes);
+    std::memcpy(segments.data, m_segments.data(), bytes);
+    m_vao.bindVertexBuffer(SEGMENT_BINDING, segments.buffer, segments.offset,
+                           sizeof(Segment));
+
+    uploadRing.bindUniform(
+        Params{.resolution = {static_cast<float>(size.width),
+                              static_cast<float>(size.height)}},
+        0);
+    target.bind();
+    m_program.bind();
+    m_vao.bind();
+    glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(CORNERS.size()),
+                          static_cast<GLsizei>(m_segments.size()));
+    gl::Framebuffer::unbind();
+
+    m_segments.clear();
+    return std::exchange(m_bounds, Rect{}).clamped(size);
+  }
+};
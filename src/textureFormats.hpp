@@ -0,0 +1,145 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <gl/gl.hpp>
+#include <optional>
+#include <string_view>
+
+/// <summary>
+/// Internal formats of the intermediate textures of the lighting pipeline.
+/// Defaults to the 32-bit float formats, the compact ones trade precision
+/// for VRAM and bandwidth.
+/// </summary>
+struct TextureFormats {
+  struct Format {
+    GLenum internalFormat;
+    std::string_view name;
+    uint32_t bytes;
+  };
+
+  // Only RG holds the nearest seed in uv. RG16F is off by up to a texel at
+  // 2048 and above, RG16 is exact to 1/65535 but clamps the "not found"
+  // marker to 0, which the distance pass reads as no seed as well
+  enum class Seed { RGBA32F, RG32F, RG16F, RG16 };
+  static constexpr std::array<Format, 4> SEEDS{{
+      {GL_RGBA32F, "RGBA32F", 16},
+      {GL_RG32F, "RG32F", 8},
+      {GL_RG16F, "RG16F", 4},
+      {GL_RG16, "RG16", 4},
+  }};
+
+  // Distance in uv, which raymarching steps by. Half floats round it by up
+  // to 1/2048
+  enum class Distance { R32F, R16F };
+  static constexpr std::array<Format, 2> DISTANCES{{
+      {GL_R32F, "R32F", 4},
+      {GL_R16F, "R16F", 2},
+  }};
+
+  // Cascades never read their alpha back, so it can be dropped
+  enum class Cascade { RGBA32F, RGBA16F, R11G11B10F };
+  static constexpr std::array<Format, 3> CASCADES{{
+      {GL_RGBA32F, "RGBA32F", 16},
+      {GL_RGBA16F, "RGBA16F", 8},
+      {GL_R11F_G11F_B10F, "R11G11B10F", 4},
+  }};
+
+  // The canvas only holds brush colours, alpha marks drawn texels
+  enum class Scene { RGBA32F, RGBA16F, RGBA8 };
+  static constexpr std::array<Format, 3> SCENES{{
+      {GL_RGBA32F, "RGBA32F", 16},
+      {GL_RGBA16F, "RGBA16F", 8},
+      {GL_RGBA8, "RGBA8", 4},
+  }};
+
+  Seed seed = Seed::RGBA32F;
+  Distance distance = Distance::R32F;
+  Cascade cascade = Cascade::RGBA32F;
+  Scene scene = Scene::RGBA32F;
+
+  bool operator==(const TextureFormats&) const = default;
+
+  const Format& seedFormat() const {
+    return SEEDS[static_cast<size_t>(seed)];
+  }
+  const Format& distanceFormat() const {
+    return DISTANCES[static_cast<size_t>(distance)];
+  }
+  const Format& cascadeFormat() const {
+    return CASCADES[static_cast<size_t>(cascade)];
+  }
+  const Format& sceneFormat() const {
+    return SCENES[static_cast<size_t>(scene)];
+  }
+
+  /// <summary>
+  /// Looks a format up by name, e.g. "RG16F"
+  /// </summary>
+  template <typename E, size_t N>
+  static std::optional<E> find(const std::array<Format, N>& formats,
+                               std::string_view name) {
+    for (size_t i = 0; i < N; i++) {
+      if (formats[i].name == name) {
+        return static_cast<E>(i);
+      }
+    }
+    return std::nullopt;
+  }
+
+  /// <summary>
+  /// Texture memory and texel traffic of the pipeline. Traffic counts every
+  /// fetch and write of one full update without cache hits, so it is an
+  /// upper bound, but it scales with the formats like the real thing.
+  /// </summary>
+  struct Footprint {
+    uint64_t vramBytes = 0;
+    uint64_t trafficBytes = 0;
+  };
+
+  /// <param name="cascadeBuffers">Textures the cascades above 0 are kept
+  /// in, one per cascade or two when ping-ponging</param>
+  /// <param name="probeSpacing">Pixels between cascade 0 probes, the
+  /// cascades shrink by its square</param>
+  Footprint footprint(const gl::Window::Size& size, uint32_t jfaPasses,
+                      uint32_t cascades, uint32_t cascadeBuffers,
+                      uint32_t rayCount, uint32_t maxSteps,
+                      uint32_t probeSpacing = 1) const {
+    uint64_t texels = static_cast<uint64_t>(size.width) *
+                      static_cast<uint64_t>(size.height);
+    uint64_t probes = texels / (static_cast<uint64_t>(probeSpacing) *
+                                static_cast<uint64_t>(probeSpacing));
+    uint64_t sceneBytes = sceneFormat().bytes;
+    uint64_t seedBytes = seedFormat().bytes;
+    uint64_t distanceBytes = distanceFormat().bytes;
+    uint64_t cascadeBytes = cascadeFormat().bytes;
+
+    Footprint footprint{};
+    // Canvas, two flip flops and the result, distance, cascade 0 plus the
+    // cascade buffers, and the probes cascade 0 is upsampled from
+    uint64_t cascadeTextures = cascades == 0 ? 0 : cascadeBuffers;
+    if (cascades != 0 && probeSpacing > 1) {
+      cascadeTextures++;
+    }
+    footprint.vramBytes =
+        texels * (sceneBytes + 3 * seedBytes + distanceBytes +
+                  (cascades == 0 ? 0 : cascadeBytes)) +
+        probes * cascadeTextures * cascadeBytes;
+
+    // To UV, 9 taps and a write per pass, the copy, the distance pass
+    uint64_t jfa = sceneBytes + seedBytes +
+                   jfaPasses * 10ull * seedBytes + 2 * seedBytes +
+                   seedBytes + distanceBytes;
+    // Every ray marches up to maxSteps distance samples, then samples the
+    // scene and the upper cascade
+    uint64_t perRay = maxSteps * distanceBytes + sceneBytes + cascadeBytes;
+    uint64_t rc = cascades * (rayCount * perRay + cascadeBytes);
+    // Four probes with their scene and distance, the pixel's and a write
+    uint64_t upsample =
+        cascades != 0 && probeSpacing > 1
+            ? 5 * (sceneBytes + distanceBytes + cascadeBytes)
+            : 0;
+    footprint.trafficBytes = texels * (jfa + upsample) + probes * rc;
+    return footprint;
+  }
+};
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "textureFormats.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <gl/gl.hpp>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct TexFbo {
+  gl::Texture tex;
+  gl::Framebuffer fbo;
+};
+
+/// <summary>
+/// Recycles render targets by format and size, so passes that are recreated
+/// or resized get back the textures they released instead of allocating new
+/// ones in the driver.
+///
+/// Targets are either exclusive, kept by one pass until it lets go of them,
+/// or transient. Transient targets with the same key and slot are handed to
+/// every pass that asks, so passes whose lifetimes don't overlap alias the
+/// same memory. Their contents only last until another pass draws to them.
+/// A pass that needs several at once asks for different slots.
+///
+/// The pool has to outlive every target it hands out.
+/// </summary>
+class TexturePool {
+public:
+  struct Key {
+    GLenum format;
+    gl::Window::Size size;
+
+    bool operator==(const Key&) const = default;
+  };
+
+  struct Stats {
+    uint64_t created = 0;
+    uint64_t reused = 0;
+    uint64_t evicted = 0;
+    size_t targets = 0;
+    // Bytes of every target the pool holds, used or not
+    uint64_t bytes = 0;
+  };
+
+  /// Bytes of a target of <paramref name="key"/>
+  static uint64_t bytes(const Key& key) {
+    uint32_t texel = 16;
+    auto find = [&](const auto& formats) {
+      for (const auto& format : formats) {
+        if (format.internalFormat == key.format) {
+          texel = format.bytes;
+        }
+      }
+    };
+    find(TextureFormats::SEEDS);
+    find(TextureFormats::DISTANCES);
+    find(TextureFormats::CASCADES);
+    find(TextureFormats::SCENES);
+    return static_cast<uint64_t>(key.size.width) *
+           static_cast<uint64_t>(key.size.height) * texel;
+  }
+
+private:
+  struct Entry {
+    Key key;
+    std::unique_ptr<TexFbo> target;
+    uint32_t users = 0;
+    // Set while shared as a transient target
+    std::optional<uint32_t> slot = std::nullopt;
+    // Release counter of when it was last freed, the oldest go first
+    uint64_t released = 0;
+  };
+
+  std::vector<Entry> m_entries{};
+  uint64_t m_releases = 0;
+  // Unused targets are only kept up to this many bytes
+  uint64_t m_budget = 256ull * 1024 * 1024;
+  Stats m_stats{};
+
+  Entry& create(const Key& key) {
+    auto target = std::make_unique<TexFbo>();
+    target->tex.storage(1, key.format, {key.size.width, key.size.height});
+    target->fbo.attachTexture(GL_COLOR_ATTACHMENT0, target->tex);
+    m_stats.created++;
+    m_stats.bytes += bytes(key);
+    return m_entries.emplace_back(
+        Entry{.key = key, .target = std::move(target)});
+  }
+
+  Entry* findFree(const Key& key) {
+    Entry* found = nullptr;
+    for (auto& entry : m_entries) {
+      // The most recently released is the most likely to be in cache
+      if (entry.users == 0 && entry.key == key &&
+          (found == nullptr || entry.released > found->released)) {
+        found = &entry;
+      }
+    }
+    if (found != nullptr) {
+      m_stats.reused++;
+    }
+    return found;
+  }
+
+  void release(const TexFbo* target) {
+    auto entry = std::find_if(
+        m_entries.begin(), m_entries.end(),
+        [&](const Entry& entry) { return entry.target.get() == target; });
+    if (entry == m_entries.end() || --entry->users != 0) {
+      return;
+    }
+    entry->slot.reset();
+    entry->released = ++m_releases;
+    trim();
+  }
+
+  /// Drops the least recently released targets over the budget
+  void trim() {
+    uint64_t unused = 0;
+    for (const auto& entry : m_entries) {
+      unused += entry.users == 0 ? bytes(entry.key) : 0;
+    }
+    while (unused > m_budget) {
+      auto oldest = m_entries.end();
+      for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        if (it->users == 0 &&
+            (oldest == m_entries.end() || it->released < oldest->released)) {
+          oldest = it;
+        }
+      }
+      uint64_t size = bytes(oldest->key);
+      unused -= size;
+      m_stats.bytes -= size;
+      m_stats.evicted++;
+      m_entries.erase(oldest);
+    }
+  }
+
+public:
+  /// <summary>
+  /// Target borrowed from the pool, handed back when destroyed
+  /// </summary>
+  class Target {
+    TexturePool* m_pool = nullptr;
+    const TexFbo* m_target = nullptr;
+
+  public:
+    Target() = default;
+    Target(TexturePool* pool, const TexFbo* target)
+        : m_pool(pool), m_target(target) {}
+    ~Target() { reset(); }
+
+    Target(const Target&) = delete;
+    Target& operator=(const Target&) = delete;
+
+    Target(Target&& other) noexcept
+        : m_pool(std::exchange(other.m_pool, nullptr)),
+          m_target(std::exchange(other.m_target, nullptr)) {}
+    Target& operator=(Target&& other) noexcept {
+      if (this != &other) {
+        reset();
+        m_pool = std::exchange(other.m_pool, nullptr);
+        m_target = std::exchange(other.m_target, nullptr);
+      }
+      return *this;
+    }
+
+    void reset() {
+      if (m_pool != nullptr) {
+        m_pool->release(m_target);
+      }
+      m_pool = nullptr;
+      m_target = nullptr;
+    }
+
+    explicit operator bool() const { return m_target != nullptr; }
+    const TexFbo& operator*() const { return *m_target; }
+    const TexFbo* operator->() const { return m_target; }
+  };
+
+  TexturePool() = default;
+  // Targets point back at the pool
+  TexturePool(const TexturePool&) = delete;
+  TexturePool& operator=(const TexturePool&) = delete;
+
+  /// <summary>
+  /// A target only the caller uses, for results that have to survive
+  /// between frames.
+  /// </summary>
+  Target acquire(const Key& key) {
+    Entry* entry = findFree(key);
+    if (entry == nullptr) {
+      entry = &create(key);
+    }
+    entry->users = 1;
+    return Target(this, entry->target.get());
+  }
+
+  /// <summary>
+  /// A target shared with every other pass asking for the same key and
+  /// <paramref name="slot"/>, for intermediates that are written before they
+  /// are read each time a pass runs.
+  /// </summary>
+  Target transient(const Key& key, uint32_t slot) {
+    for (auto& entry : m_entries) {
+      if (entry.users != 0 && entry.key == key && entry.slot == slot) {
+        entry.users++;
+        m_stats.reused++;
+        return Target(this, entry.target.get());
+      }
+    }
+    Entry* entry = findFree(key);
+    if (entry == nullptr) {
+      entry = &create(key);
+    }
+    entry->users = 1;
+    entry->slot = slot;
+    return Target(this, entry->target.get());
+  }
+
+  Stats stats() const {
+    Stats stats = m_stats;
+    stats.targets = m_entries.size();
+    return stats;
+  }
+
+  void setBudget(uint64_t bytes) {
+    m_budget = bytes;
+    trim();
+  }
+};